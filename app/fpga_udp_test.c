@@ -36,13 +36,16 @@ static void print_ip(const char *label, uint32_t ip_addr) {
   printf("%s: %s\n", label, inet_ntoa(addr));
 }
 
-// 缓存回调函数 - 用户获取缓存数据的接口
-void user_cache_callback(const uint8_t *cache_data, uint32_t total_packets, 
-  uint64_t total_bytes, const uint32_t *packet_lengths) {
+// 缓存视图回调 - 用户获取缓存数据的接口，按索引直接定位每个包
+void user_cache_callback(const net_cache_view_t *view) {
+  uint32_t total_packets = view->packet_count;
+  uint64_t total_bytes = view->total_bytes;
+
   printf("\n=== 缓存数据统计 ===\n");
   printf("总包数: %u\n", total_packets);
   printf("总字节数: %lu\n", total_bytes);
   printf("平均包大小: %.2f 字节\n", total_packets > 0 ? (float)total_bytes / total_packets : 0);
+  printf("固定步长: %u 字节\n", view->stride);
   
   // 统计信息
   uint32_t fpga_packets = 0;
@@ -51,19 +54,16 @@ void user_cache_callback(const uint8_t *cache_data, uint32_t total_packets,
   uint64_t fpga_payload_bytes = 0;
   
   // 遍历缓存中的所有包，查找FPGA包
-  uint32_t offset = 0;
   for (uint32_t i = 0; i < total_packets; i++) {
-  const uint8_t *packet_data = cache_data + offset;
-  int packet_len = packet_lengths[i];
+  const uint8_t *packet_data = net_cache_packet(view, i);
+  int packet_len = view->packet_lengths[i];
   
   // 解析以太网头
   struct ethhdr *eth = (struct ethhdr*)packet_data;
   
   // 仅处理 IP 包
-  if (ntohs(eth->h_proto) != ETH_P_IP) {
-    offset += packet_len;
+  if (ntohs(eth->h_proto) != ETH_P_IP)
     continue;
-  }
   
   ip_packets++;
   
@@ -71,10 +71,8 @@ void user_cache_callback(const uint8_t *cache_data, uint32_t total_packets,
   struct iphdr *ip = (struct iphdr*)(packet_data + sizeof(struct ethhdr));
   
   // 仅处理 UDP 协议
-  if (ip->protocol != IPPROTO_UDP) {
-    offset += packet_len;
+  if (ip->protocol != IPPROTO_UDP)
     continue;
-  }
   
   udp_packets++;
   
@@ -116,8 +114,6 @@ void user_cache_callback(const uint8_t *cache_data, uint32_t total_packets,
       printf("========================\n");
     }
   }
-
-  offset += packet_len;
 }
 
   printf("\n=== 详细统计 ===\n");
@@ -203,7 +199,7 @@ static void signal_handler(int sig) {
   printf("监听已停止，程序退出。\n");
 }
 
-int main() {
+int main(int argc, char *argv[]) {
   S_udp_header_params params = {
     .dst_mac_high = 0xb07b,
     .dst_mac_low  = 0x2500c019,
@@ -224,9 +220,24 @@ int main() {
   fpga_initialize_udp_header(&params);
   printf("[主程序] FPGA UDP头初始化完成。\n");
 
-  // 使用带缓存的监听
-  if (net_listener_start_with_cache("eth0", user_packet_printer, 
-                                  user_cache_callback, DEFAULT_CACHE_SIZE) < 0) {
+  // 使用带缓存的监听，内核中只放行 FPGA UDP 帧
+  net_listener_config_t cfg;
+  net_listener_config_init(&cfg);
+  cfg.udp_filter_enable = true;
+  cfg.udp_filter = params;
+  cfg.cache_view_cb = user_cache_callback;
+  // 指定文件路径时流式写盘，采集时长只受磁盘容量限制（"-" 表示不写盘）
+  if (argc > 1 && strcmp(argv[1], "-") != 0) {
+    cfg.stream_path = argv[1];
+    printf("[主程序] 流式写盘到 %s\n", cfg.stream_path);
+  }
+  // 指定共享内存名时同时导出帧，供显示、归档等进程读取
+  if (argc > 2) {
+    cfg.shm_name = argv[2];
+    printf("[主程序] 帧导出到共享内存 %s\n", cfg.shm_name);
+  }
+  if (net_listener_start_with_config("eth0", user_packet_printer, 
+                                  NULL, DEFAULT_CACHE_SIZE, &cfg) < 0) {
       printf("[主程序] 网络监听启动失败。\n");
       return -1;
   }
@@ -240,6 +251,19 @@ int main() {
   while (net_listener_is_running()) {
       sleep(5);
       cache_stats_t stats = net_listener_get_cache_stats();
+      if (cfg.shm_name) {
+        net_shm_stats_t sh = net_listener_get_shm_stats();
+        printf("[共享内存] 帧数: %llu, 环满丢弃: %llu, 消费者: %u, 最大落后: %u 帧\n",
+               (unsigned long long)sh.frames, (unsigned long long)sh.dropped_frames,
+               sh.consumers, sh.max_lag);
+      }
+      if (cfg.stream_path) {
+        net_stream_stats_t ss = net_listener_get_stream_stats();
+        printf("[写盘统计] 帧数: %llu, 已写: %.1f MB, 吞吐: %.1f MB/s, 在途块: %u, 丢弃: %llu\n",
+               (unsigned long long)ss.frames, ss.bytes_written / (1024.0 * 1024.0),
+               ss.throughput_mb_s, ss.inflight_blocks, (unsigned long long)ss.dropped_frames);
+        continue;
+      }
       printf("[缓存统计] 包数: %u, 字节: %lu, 使用率: %.1f%%, 丢弃: %u\n",
              stats.total_packets, stats.total_bytes,
              stats.cache_size > 0 ? (float)stats.cache_used / stats.cache_size * 100 : 0,
@@ -0,0 +1,656 @@
+/**
+ * @file net_listener_veth_test.c
+ * @brief 无板卡环境下的 net_listener 回环测试
+ * @details 创建一对 veth 网卡，在一端按 FPGA UDP 包头模板发送带序号的数据帧（夹杂 ARP 干扰帧），
+ *          在另一端用指定后端启动 net_listener，最后检查缓存回调收到的帧数与序号。
+ *
+ * 用法: net_listener_veth_test [recv|mmap|xdp|mmsg|fanout] [帧数] [payload|spin|stream|chunk|dual|armed|pcap|rcvbuf|monitor|shm]
+ *       fanout: 4 个 PACKET_FANOUT worker，缓存按时间戳归并
+ *       payload: 缓存只保存 UDP 负载（payload_only 模式）
+ *       spin: 抓包线程收帧后先忙等 50us 再阻塞，并绑定到 CPU 0
+ *       stream: 帧经 io_uring 流式写入 STREAM_PATH，停止后读回文件检查
+ *       chunk: 分块回调模式（1MB x 4 块，超时 20ms），在回调中逐块检查
+ *       pcap: 同时写 PCAP_PATH（pcapng），停止后分别全速和按原始间隔回放该文件，检查帧数、顺序和时间戳
+ *       armed: 常驻预备模式，分 3 次采集窗口发送，窗口之间另发的帧应被丢弃
+ *       dual: 另建一个 recv 后端的实例同时监听同一网卡，检查两个实例各自收齐（不适用于 xdp）
+ *       rcvbuf: 套接字接收缓冲区设为 32KB，检查运行中读到的内核丢包与收到的帧数对得上
+ *       monitor: 采集期间另一线程不停读取统计，检查每个快照内部一致、包数不回退
+ *       shm: 帧同时导出到共享内存帧环 SHM_NAME，由子进程零拷贝读取，检查帧数、顺序和落后统计；
+ *            另一个子进程以追赶模式登记后暂停到采集结束，检查它不拖累其他消费者、读到与跳过的帧数之和正确
+ * 需要 root 权限（创建 veth、原始套接字、加载 XDP 程序）。
+ */
+#include "../dev/fpga.h"
+#include "../dev/net_listener.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <sys/wait.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <linux/if_packet.h>
+
+#define VETH_RX   "sbeam_v0"   // 监听端
+#define VETH_TX   "sbeam_v1"   // 模拟 FPGA 发送端
+#define FRAME_LEN (14 + 20 + 0x408)
+#define STREAM_PATH "/tmp/sbeam_veth_stream.bin"
+#define PCAP_PATH   "/tmp/sbeam_veth_capture.pcapng"
+#define SHM_NAME    "/sbeam_veth_frames"
+
+static S_udp_header_params params = {
+  .dst_mac_high = 0xb07b,
+  .dst_mac_low  = 0x2500c019,
+  .src_mac_high = 0x0043,
+  .src_mac_low  = 0x4d494e40,
+  .src_ip       = 0xa9fe972f,
+  .dst_ip       = 0xc0a80105,
+  .src_port     = 5000,
+  .dst_port     = 5030,
+  .ip_total_len = 0x041c,
+  .udp_data_len = 0x408
+};
+
+static uint32_t frames_sent = 0;
+static uint32_t frames_ok = 0;
+static uint32_t frames_out_of_order = 0;
+static volatile uint32_t frames_dispatched = 0;
+static bool payload_mode = false;
+static bool stream_mode = false;
+static bool chunk_mode = false;
+static bool dual_mode = false;
+static bool armed_mode = false;
+static bool pcap_mode = false;
+
+// 实时回调：在分发线程中调用，只计数
+static void veth_packet_callback(const uint8_t *data, int length) {
+  (void)data;
+  if (length == FRAME_LEN)
+    frames_dispatched++;
+}
+
+// 帧头与 fpga_initialize_udp_header 写入 FPGA 的模板一致
+static void build_fpga_frame(uint8_t *frame) {
+  memset(frame, 0, FRAME_LEN);
+  fpga_build_udp_header(&params, frame);
+}
+
+static int send_frames(uint32_t count) {
+  int sock = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  if (sock < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  struct sockaddr_ll sll;
+  memset(&sll, 0, sizeof(sll));
+  sll.sll_family = AF_PACKET;
+  sll.sll_ifindex = if_nametoindex(VETH_TX);
+  sll.sll_halen = ETH_ALEN;
+
+  uint8_t frame[FRAME_LEN];
+  uint8_t arp[60];
+  build_fpga_frame(frame);
+  memset(arp, 0xFF, sizeof(arp));
+  memcpy(arp + 6, frame + 6, 6);
+  arp[12] = 0x08; arp[13] = 0x06;
+
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t seq = htonl(i);
+    memcpy(frame + FPGA_UDP_HEADER_LEN, &seq, 4);
+    if (sendto(sock, frame, sizeof(frame), 0, (struct sockaddr *)&sll, sizeof(sll)) == sizeof(frame))
+      frames_sent++;
+    if (i % 16 == 0)
+      sendto(sock, arp, sizeof(arp), 0, (struct sockaddr *)&sll, sizeof(sll));
+    if (i % 64 == 63)
+      usleep(200); // 控制速率，避免 veth 发送队列溢出
+  }
+
+  close(sock);
+  return 0;
+}
+
+// 预备模式下在采集窗口之外发送的帧，应被丢弃，不计入发送数
+static uint32_t send_outside_window(uint32_t count) {
+  uint32_t sent = frames_sent;
+  send_frames(count);
+  uint32_t n = frames_sent - sent;
+  frames_sent = sent;
+  return n;
+}
+
+// 统计一帧 FPGA 帧并检查序号是否连续递增
+static void check_frame(const uint8_t *pkt, uint32_t length, uint32_t *expected) {
+  // payload 模式下只有 UDP 负载，序号位于负载开头
+  if (payload_mode) {
+    if (length != FRAME_LEN - FPGA_UDP_HEADER_LEN)
+      return;
+  } else {
+    if (length != FRAME_LEN || pkt[36] != (params.dst_port >> 8) ||
+        pkt[37] != (params.dst_port & 0xFF))
+      return;
+    pkt += FPGA_UDP_HEADER_LEN;
+  }
+
+  uint32_t seq;
+  memcpy(&seq, pkt, 4);
+  seq = ntohl(seq);
+  if (seq != *expected)
+    frames_out_of_order++;
+  *expected = seq + 1;
+  frames_ok++;
+}
+
+// 缓存回调：逐帧检查
+static void veth_cache_callback(const uint8_t *cache_data, uint32_t total_packets,
+                                uint64_t total_bytes, const uint32_t *packet_lengths) {
+  uint64_t offset = 0;
+  uint32_t expected = 0;
+
+  for (uint32_t i = 0; i < total_packets; i++) {
+    check_frame(cache_data + offset, packet_lengths[i], &expected);
+    offset += packet_lengths[i];
+  }
+  printf("[缓存回调] 总包数: %u, 总字节数: %lu, FPGA 帧: %u, 乱序: %u\n",
+         total_packets, total_bytes, frames_ok, frames_out_of_order);
+}
+
+// 缓存视图回调：核对偏移索引、固定步长和时间戳
+// （fanout 模式下各包分散在多个分片中，偏移不连续且不提供固定步长）
+static bool view_ok = false;
+static void veth_cache_view_callback(const net_cache_view_t *view) {
+  uint64_t bytes = 0;
+  uint32_t unstamped = 0;
+
+  view_ok = true;
+  for (uint32_t i = 0; i < view->packet_count; i++) {
+    if (net_cache_packet(view, i) != view->data + view->packet_offsets[i])
+      view_ok = false;
+    if (view->stride && (view->packet_lengths[i] != view->stride ||
+                         view->packet_offsets[i] != (uint64_t)i * view->stride))
+      view_ok = false;
+    if (view->packet_timestamps[i] == 0 ||
+        (i > 0 && view->packet_timestamps[i] < view->packet_timestamps[i - 1]))
+      unstamped++;
+    bytes += view->packet_lengths[i];
+  }
+  if (bytes != view->total_bytes || unstamped > 0)
+    view_ok = false;
+  printf("[视图回调] 包数: %u, 固定步长: %u, 无效时间戳: %u, 索引%s\n", view->packet_count,
+         view->stride, unstamped, view_ok ? "一致" : "不一致");
+}
+
+// 读回流式写盘文件，按记录逐帧检查；返回记录数，格式错误返回 -1
+static long check_stream_file(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    perror("fopen");
+    return -1;
+  }
+
+  uint8_t buf[NET_BUFFER_SIZE];
+  uint32_t expected = 0;
+  long records = 0;
+  net_stream_record_t rec;
+  while (fread(&rec, sizeof(rec), 1, fp) == 1) {
+    uint32_t padded = (sizeof(rec) + rec.length + NET_STREAM_RECORD_ALIGN - 1) /
+                      NET_STREAM_RECORD_ALIGN * NET_STREAM_RECORD_ALIGN - sizeof(rec);
+    if (rec.flags & NET_STREAM_PAD) {
+      fseek(fp, rec.length, SEEK_CUR);
+      continue;
+    }
+    if (rec.length > sizeof(buf) || rec.timestamp_ns == 0 || fread(buf, padded, 1, fp) != 1) {
+      fclose(fp);
+      return -1;
+    }
+    check_frame(buf, rec.length, &expected);
+    records++;
+  }
+  fclose(fp);
+  return records;
+}
+
+// 分块回调：在工作线程中按块顺序检查，序号跨块连续
+static uint32_t chunk_expected = 0;
+static uint32_t chunk_count = 0;
+static uint32_t chunk_packets = 0;
+static bool chunk_ok = true;
+static void veth_chunk_callback(const net_cache_view_t *view, uint32_t chunk_seq) {
+  if (chunk_seq != chunk_count)
+    chunk_ok = false;
+  for (uint32_t i = 0; i < view->packet_count; i++)
+    check_frame(net_cache_packet(view, i), view->packet_lengths[i], &chunk_expected);
+  chunk_count++;
+  chunk_packets += view->packet_count;
+}
+
+// 第二个实例的缓存视图回调：通过 user_data 找到该实例的计数
+static uint32_t dual_packets = 0;
+static uint32_t dual_kernel_dropped = 0;
+static bool dual_ctx_ok = false;
+static void dual_cache_view_callback(const net_cache_view_t *view) {
+  net_listener_t *nl = net_listener_ctx_current();
+  uint32_t *packets = nl ? net_listener_ctx_user_data(nl) : NULL;
+  dual_ctx_ok = packets == &dual_packets;
+  if (packets) {
+    *packets = view->packet_count;
+    // 内核丢包数在停止时读取，缓存释放后清零，这里取该实例的最终值
+    dual_kernel_dropped = net_listener_ctx_get_cache_stats(nl).kernel_dropped_packets;
+  }
+}
+
+// 监控线程：采集期间不停读取统计快照。每帧长度相同，快照一致时字节数与包数成比例，
+// 且包数不会回退
+static volatile bool monitor_running = false;
+static uint32_t monitor_snapshots = 0;
+static uint32_t monitor_torn = 0;
+static void *monitor_thread(void *arg) {
+  (void)arg;
+  uint32_t last_packets = 0;
+  while (monitor_running) {
+    cache_stats_t s = net_listener_get_cache_stats();
+    net_timestamp_stats_t t = net_listener_get_timestamp_stats();
+    if (s.total_bytes != (uint64_t)s.total_packets * FRAME_LEN || s.cache_used != s.total_bytes ||
+        s.total_packets < last_packets || (t.count > 1 && t.last_ns < t.first_ns))
+      monitor_torn++;
+    last_packets = s.total_packets;
+    monitor_snapshots++;
+  }
+  return NULL;
+}
+
+// 回放：缓存视图中的帧序号应严格递增（与采集时的顺序一致，内核丢包处可跳号）
+static uint32_t replay_packets = 0;
+static bool replay_in_order = false;
+static void replay_cache_view_callback(const net_cache_view_t *view) {
+  replay_packets = view->packet_count;
+  replay_in_order = true;
+  for (uint32_t i = 0; i < view->packet_count; i++) {
+    uint32_t seq, prev = 0;
+    memcpy(&seq, net_cache_packet(view, i) + FPGA_UDP_HEADER_LEN, 4);
+    if (i > 0)
+      memcpy(&prev, net_cache_packet(view, i - 1) + FPGA_UDP_HEADER_LEN, 4);
+    if (i > 0 && ntohl(seq) <= ntohl(prev))
+      replay_in_order = false;
+  }
+}
+
+// 用回放源把 pcapng 文件送入同一处理路径，返回耗时（毫秒），失败返回 -1
+static double replay_capture(bool timing, net_timestamp_stats_t *ts) {
+  net_listener_config_t cfg;
+  net_listener_config_init(&cfg);
+  cfg.mode = NET_CAPTURE_REPLAY;
+  cfg.replay_path = PCAP_PATH;
+  cfg.replay_timing = timing;
+  cfg.udp_filter_enable = true;
+  cfg.udp_filter = params;
+  cfg.cache_view_cb = replay_cache_view_callback;
+
+  net_listener_t *nl = net_listener_ctx_create();
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  if (!nl || net_listener_ctx_start(nl, "replay", NULL, NULL, 64 * 1024 * 1024, &cfg) < 0) {
+    net_listener_ctx_destroy(nl);
+    return -1;
+  }
+  while (!net_listener_ctx_replay_finished(nl))
+    usleep(1000);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  *ts = net_listener_ctx_get_timestamp_stats(nl);
+  net_listener_ctx_destroy(nl);
+  return (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6;
+}
+
+// 共享内存消费者（子进程）：登记后经 ready_fd 通知父进程开始发送，读到生产者关闭为止，
+// 经 result_fd 回报 { 帧数, 序号是否严格递增 }
+static void shm_consumer_process(int ready_fd, int result_fd) {
+  net_shm_reader_t *r = net_shm_reader_open(SHM_NAME);
+  uint32_t result[2] = { 0, 1 };
+  char ready = r ? 1 : 0;
+  write(ready_fd, &ready, 1);
+  if (r) {
+    const uint8_t *data;
+    uint32_t length, prev = 0;
+    int ret;
+    while ((ret = net_shm_reader_next(r, &data, &length, NULL)) >= 0) {
+      if (ret == 0) {
+        usleep(100);
+        continue;
+      }
+      uint32_t seq;
+      memcpy(&seq, data + FPGA_UDP_HEADER_LEN, 4);
+      if (result[0] > 0 && ntohl(seq) <= prev)
+        result[1] = 0;
+      prev = ntohl(seq);
+      result[0]++;
+    }
+    net_shm_reader_close(r);
+  }
+  write(result_fd, result, sizeof(result));
+  _exit(0);
+}
+
+// 共享内存追赶消费者（子进程）：登记后暂停，直到父进程停止采集后经 go_fd 通知才开始读，
+// 经 result_fd 回报 { 读到帧数, 跳过帧数, 序号是否严格递增 }
+static void shm_viewer_process(int ready_fd, int go_fd, int result_fd) {
+  net_shm_reader_t *r = net_shm_reader_open_lapped(SHM_NAME);
+  uint32_t result[3] = { 0, 0, 1 };
+  char ready = r ? 1 : 0, go;
+  write(ready_fd, &ready, 1);
+  if (r && read(go_fd, &go, 1) == 1) {
+    const uint8_t *data;
+    uint32_t length, prev = 0;
+    int ret;
+    while ((ret = net_shm_reader_next(r, &data, &length, NULL)) > 0) {
+      uint32_t seq;
+      memcpy(&seq, data + FPGA_UDP_HEADER_LEN, 4);
+      if (result[0] > 0 && ntohl(seq) <= prev)
+        result[2] = 0;
+      prev = ntohl(seq);
+      result[0]++;
+    }
+    result[1] = (uint32_t)net_shm_reader_lost(r);
+  }
+  net_shm_reader_close(r);
+  write(result_fd, result, sizeof(result));
+  _exit(0);
+}
+
+static int setup_veth(void) {
+  char cmd[256];
+  snprintf(cmd, sizeof(cmd),
+           "ip link del %s 2>/dev/null; ip link add %s type veth peer name %s && "
+           "ip link set %s up && ip link set %s up",
+           VETH_RX, VETH_RX, VETH_TX, VETH_RX, VETH_TX);
+  return system(cmd) == 0 ? 0 : -1;
+}
+
+static void teardown_veth(void) {
+  char cmd[64];
+  snprintf(cmd, sizeof(cmd), "ip link del %s 2>/dev/null", VETH_RX);
+  system(cmd);
+}
+
+int main(int argc, char *argv[]) {
+  const char *mode_name = argc > 1 ? argv[1] : "recv";
+  uint32_t count = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 10000;
+  payload_mode = argc > 3 && strcmp(argv[3], "payload") == 0;
+  bool spin_mode = argc > 3 && strcmp(argv[3], "spin") == 0;
+  stream_mode = argc > 3 && strcmp(argv[3], "stream") == 0;
+  chunk_mode = argc > 3 && strcmp(argv[3], "chunk") == 0;
+  dual_mode = argc > 3 && strcmp(argv[3], "dual") == 0;
+  armed_mode = argc > 3 && strcmp(argv[3], "armed") == 0;
+  pcap_mode = argc > 3 && strcmp(argv[3], "pcap") == 0;
+  bool rcvbuf_mode = argc > 3 && strcmp(argv[3], "rcvbuf") == 0;
+  bool monitor_mode = argc > 3 && strcmp(argv[3], "monitor") == 0;
+  bool shm_mode = argc > 3 && strcmp(argv[3], "shm") == 0;
+
+  net_listener_config_t cfg;
+  net_listener_config_init(&cfg);
+  cfg.udp_filter_enable = true;
+  cfg.udp_filter = params;
+  cfg.payload_only = payload_mode;
+  cfg.cache_view_cb = veth_cache_view_callback;
+  cfg.armed = armed_mode;
+  if (pcap_mode)
+    cfg.pcap_path = PCAP_PATH;
+  if (shm_mode) {
+    cfg.shm_name = SHM_NAME;
+    cfg.shm_slot_count = 16384;
+  }
+  if (stream_mode) {
+    cfg.stream_path = STREAM_PATH;
+    cfg.stream_block_size = 256 * 1024; // 小块，让测试覆盖块尾填充和多个在途写请求
+  }
+  if (chunk_mode) {
+    cfg.chunk_cb = veth_chunk_callback;
+    cfg.chunk_size = 1 << 20;
+    cfg.chunk_count = 4;
+    cfg.chunk_timeout_ms = 20;
+  }
+  if (rcvbuf_mode)
+    cfg.rcvbuf_size = 32 * 1024; // 小接收缓冲区，让内核丢包在运行中即可观测
+  if (spin_mode) {
+    cfg.spin_us = 50;
+    cfg.cpu_affinity = 0x1;
+  }
+  if (strcmp(mode_name, "mmap") == 0) {
+    cfg.mode = NET_CAPTURE_MMAP;
+  } else if (strcmp(mode_name, "xdp") == 0) {
+    cfg.mode = NET_CAPTURE_XDP;
+  } else if (strcmp(mode_name, "mmsg") == 0) {
+    cfg.mode = NET_CAPTURE_RECVMMSG;
+  } else if (strcmp(mode_name, "fanout") == 0) {
+    cfg.fanout_workers = 4;
+  } else if (strcmp(mode_name, "recv") != 0) {
+    printf("用法: %s [recv|mmap|xdp|mmsg|fanout] [帧数] [payload|spin|stream|chunk|dual|armed|pcap|rcvbuf|monitor|shm]\n", argv[0]);
+    return -1;
+  }
+
+  if (setup_veth() < 0) {
+    printf("[主程序] 创建 veth 失败（需要 root 权限）。\n");
+    return -1;
+  }
+  usleep(100000);
+
+  if (net_listener_start_with_config(VETH_RX, veth_packet_callback, veth_cache_callback,
+                                     64 * 1024 * 1024, &cfg) < 0) {
+    printf("[主程序] 网络监听启动失败。\n");
+    teardown_veth();
+    return -1;
+  }
+
+  net_listener_t *second = NULL;
+  if (dual_mode) {
+    net_listener_config_t cfg2;
+    net_listener_config_init(&cfg2);
+    cfg2.udp_filter_enable = true;
+    cfg2.udp_filter = params;
+    cfg2.cache_view_cb = dual_cache_view_callback;
+    cfg2.user_data = &dual_packets;
+    second = net_listener_ctx_create();
+    if (!second || net_listener_ctx_start(second, VETH_RX, NULL, NULL, 64 * 1024 * 1024, &cfg2) < 0) {
+      printf("[主程序] 第二个监听实例启动失败。\n");
+      net_listener_ctx_destroy(second);
+      net_listener_stop_with_cache(VETH_RX);
+      teardown_veth();
+      return -1;
+    }
+  }
+
+  pid_t consumer = -1, viewer = -1;
+  int shm_pipe[2] = { -1, -1 }, viewer_pipe[2] = { -1, -1 }, viewer_go[2] = { -1, -1 };
+  if (shm_mode) {
+    char ready = 0, viewer_ready = 0;
+    if (pipe(shm_pipe) == 0 && (consumer = fork()) == 0)
+      shm_consumer_process(shm_pipe[1], shm_pipe[1]);
+    if (consumer > 0 && pipe(viewer_pipe) == 0 && pipe(viewer_go) == 0 && (viewer = fork()) == 0) {
+      close(viewer_go[1]);  // 父进程异常退出时 go_fd 读到 EOF
+      shm_viewer_process(viewer_pipe[1], viewer_go[0], viewer_pipe[1]);
+    }
+    if (consumer < 0 || read(shm_pipe[0], &ready, 1) != 1 || !ready ||
+        viewer < 0 || read(viewer_pipe[0], &viewer_ready, 1) != 1 || !viewer_ready) {
+      printf("[主程序] 共享内存消费者启动失败。\n");
+      net_listener_stop_with_cache(VETH_RX);
+      teardown_veth();
+      return -1;
+    }
+  }
+
+  // 预备模式：每个窗口收到的帧序号都从 0 开始，缓存回调逐窗口检查
+  uint32_t shot_packets = 0, shot_kernel_dropped = 0, idle_sent = 0, dispatched_late = 0;
+  double begin_us = 0, end_us = 0;
+  if (armed_mode) {
+    uint32_t dispatched_at_end = frames_dispatched;
+    for (int shot = 0; shot < 3; shot++) {
+      idle_sent += send_outside_window(count / 8);
+      usleep(50000);
+      // shot_end 返回后上一窗口的实时回调应已全部结束
+      dispatched_late += frames_dispatched - dispatched_at_end;
+
+      struct timespec b0, b1, e0, e1;
+      clock_gettime(CLOCK_MONOTONIC, &b0);
+      net_listener_shot_begin();
+      clock_gettime(CLOCK_MONOTONIC, &b1);
+      send_frames(count / 3);
+      usleep(50000);
+      clock_gettime(CLOCK_MONOTONIC, &e0);
+      int n = net_listener_shot_end();
+      clock_gettime(CLOCK_MONOTONIC, &e1);
+      dispatched_at_end = frames_dispatched;
+      begin_us += (b1.tv_sec - b0.tv_sec) * 1e6 + (b1.tv_nsec - b0.tv_nsec) / 1e3;
+      end_us += (e1.tv_sec - e0.tv_sec) * 1e6 + (e1.tv_nsec - e0.tv_nsec) / 1e3;
+      shot_packets += n > 0 ? (uint32_t)n : 0;
+      shot_kernel_dropped += net_listener_get_cache_stats().kernel_dropped_packets;
+    }
+    idle_sent += send_outside_window(count / 8);  // 最后一个窗口关闭后的帧，停止时不应再交付
+    usleep(50000);
+    dispatched_late += frames_dispatched - dispatched_at_end;
+  } else {
+    pthread_t monitor;
+    monitor_running = monitor_mode;
+    if (monitor_mode)
+      pthread_create(&monitor, NULL, monitor_thread, NULL);
+    send_frames(count);
+    usleep(200000); // 等待最后一批帧被处理
+    if (monitor_mode) {
+      monitor_running = false;
+      pthread_join(monitor, NULL);
+      printf("[结果] 监控线程: %u 次快照, 不一致 %u 次\n", monitor_snapshots, monitor_torn);
+    }
+  }
+
+  cache_stats_t stats = net_listener_get_cache_stats();
+  if (armed_mode) {
+    printf("[结果] 预备模式: %u 个窗口, 窗口内缓存 %u 帧, 窗口外丢弃 %u 帧（窗口间发送 %u 帧）, "
+           "平均开窗 %.1f us / 关窗（含交付）%.1f us, 关窗后仍回调 %u 帧\n", stats.shot_seq, shot_packets,
+           stats.outside_window_packets, idle_sent, begin_us / 3, end_us / 3, dispatched_late);
+    stats.total_packets = shot_packets;
+    stats.kernel_dropped_packets = shot_kernel_dropped;
+  }
+  net_timestamp_stats_t ts = net_listener_get_timestamp_stats();
+  net_stream_stats_t ss = net_listener_get_stream_stats();
+  net_shm_stats_t sh = net_listener_get_shm_stats();
+  if (shm_mode)
+    printf("[主程序] 停止前共享内存: %llu 帧, 消费者: %u (pid %d), 落后 %u 帧\n",
+           (unsigned long long)sh.frames, sh.consumers, (int)consumer, sh.max_lag);
+  printf("[主程序] 停止前写盘: %llu 帧, 在途块: %u\n",
+         (unsigned long long)ss.frames, ss.inflight_blocks);
+  struct timespec t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &t0);
+  net_listener_stop_with_cache(VETH_RX);
+  clock_gettime(CLOCK_MONOTONIC, &t1);
+  if (viewer > 0)
+    write(viewer_go[1], "g", 1);  // 生产者已关闭，暂停的追赶消费者开始读
+  net_listener_release_cache();
+  net_listener_ctx_destroy(second);
+  teardown_veth();
+
+  if (chunk_mode)
+    printf("[结果] 分块回调: %u 块 / %u 包, 已回收: %u, 待处理: %u, 块序号%s\n", chunk_count,
+           chunk_packets, stats.chunks_delivered, stats.chunks_pending, chunk_ok ? "连续" : "不连续");
+
+  if (dual_mode)
+    printf("[结果] 第二个实例: 缓存 %u 帧, 内核丢弃: %u, 回调实例%s\n", dual_packets,
+           dual_kernel_dropped, dual_ctx_ok ? "正确" : "错误");
+
+  bool shm_ok = true;
+  if (shm_mode) {
+    uint32_t result[2] = { 0, 0 };
+    sh = net_listener_get_shm_stats();
+    waitpid(consumer, NULL, 0);
+    if (read(shm_pipe[0], result, sizeof(result)) != sizeof(result))
+      result[0] = 0;
+    printf("[结果] 共享内存: 导出 %llu 帧, 环满丢弃 %llu, 子进程读到 %u 帧, 顺序%s\n",
+           (unsigned long long)sh.frames, (unsigned long long)sh.dropped_frames, result[0],
+           result[1] ? "正确" : "错误");
+    shm_ok = result[0] == sh.frames && result[1] && sh.frames + sh.dropped_frames == frames_ok &&
+             sh.reclaimed_consumers == 0;
+
+    // 追赶消费者暂停期间不约束生产者：读到的加上跳过的正好是登记后导出的全部帧
+    uint32_t viewer_result[3] = { 0, 0, 0 };
+    waitpid(viewer, NULL, 0);
+    if (read(viewer_pipe[0], viewer_result, sizeof(viewer_result)) != sizeof(viewer_result))
+      viewer_result[2] = 0;
+    printf("[结果] 共享内存追赶消费者: 读到 %u 帧, 跳过 %u 帧, 顺序%s\n",
+           viewer_result[0], viewer_result[1], viewer_result[2] ? "正确" : "错误");
+    shm_ok = shm_ok && viewer_result[2] && viewer_result[0] + viewer_result[1] == sh.frames;
+  }
+
+  bool replay_ok = true;
+  if (pcap_mode) {
+    net_pcap_stats_t ps = net_listener_get_pcap_stats();
+    net_timestamp_stats_t fast_ts, timed_ts;
+    double fast_ms = replay_capture(false, &fast_ts);
+    uint32_t fast_packets = replay_packets;
+    bool fast_order = replay_in_order;
+    double timed_ms = replay_capture(true, &timed_ts);
+    unlink(PCAP_PATH);
+    double span_ms = (ts.last_ns - ts.first_ns) / 1e6;
+    printf("[结果] pcapng: %llu 帧 / %llu 字节, 写盘丢弃: %llu, 缓冲区最大占用: %u KB\n",
+           (unsigned long long)ps.frames, (unsigned long long)ps.bytes_written,
+           (unsigned long long)ps.dropped_frames, ps.buffer_high_water >> 10);
+    printf("[结果] 全速回放: %u 帧, 顺序%s, 耗时 %.1f ms; 按原始间隔回放: %u 帧, 耗时 %.1f ms（原始跨度 %.1f ms）\n",
+           fast_packets, fast_order ? "正确" : "错误", fast_ms, replay_packets, timed_ms, span_ms);
+    replay_ok = ps.dropped_frames == 0 && ps.write_errors == 0 && ps.frames == frames_ok &&
+                fast_packets == frames_ok && fast_order && replay_packets == frames_ok &&
+                fast_ts.first_ns == ts.first_ns && fast_ts.last_ns == ts.last_ns &&
+                timed_ts.count == ts.count && timed_ms >= span_ms * 0.95;
+  }
+
+  long records = 0;
+  if (stream_mode) {
+    ss = net_listener_get_stream_stats();
+    records = check_stream_file(STREAM_PATH);
+    unlink(STREAM_PATH);
+    printf("[结果] 写盘: %llu 帧 / %llu 字节, 文件记录: %ld, %s, 吞吐 %.1f MB/s, "
+           "最大在途块: %u, 写盘丢弃: %llu, 写错误: %llu\n",
+           (unsigned long long)ss.frames, (unsigned long long)ss.bytes_written, records,
+           ss.direct_io ? "O_DIRECT" : "缓冲写", ss.throughput_mb_s, ss.inflight_high_water,
+           (unsigned long long)ss.dropped_frames, (unsigned long long)ss.write_errors);
+  }
+
+  printf("[结果] 后端: %s, 发送: %u, 接收: %u, 乱序: %u, 缓存丢弃: %u, 内核丢弃: %u\n",
+         mode_name, frames_sent, frames_ok, frames_out_of_order,
+         stats.dropped_packets, stats.kernel_dropped_packets);
+  printf("[结果] 缓存丢弃原因: 数据区满 %u / 索引满 %u, 接收缓冲区: %u 字节\n",
+         stats.cache_full_drops, stats.index_full_drops, stats.rcvbuf_bytes);
+  printf("[结果] 时间戳: %u 帧, 跨度 %.3f ms, 包间隔 平均 %.1f us / 最小 %.1f us / 最大 %.1f us, 抖动 %.1f us\n",
+         ts.count, (ts.last_ns - ts.first_ns) / 1e6, ts.mean_gap_ns / 1e3,
+         ts.min_gap_ns / 1e3, ts.max_gap_ns / 1e3, ts.jitter_ns / 1e3);
+  printf("[结果] 停止耗时（含缓存回调）: %.3f ms\n",
+         (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6);
+  if (payload_mode)
+    printf("[结果] 帧头不符: %u\n", stats.header_mismatch_packets);
+  printf("[结果] 实时回调: %u 帧, 分发环最大积压: %u, 分发环溢出: %u\n",
+         frames_dispatched, stats.dispatch_high_water, stats.dispatch_overflow);
+  if (stats.batch_count > 0)
+    printf("[结果] recvmmsg 批次: %u, 平均每批: %.2f 帧\n", stats.batch_count, stats.avg_batch_fill);
+  printf("[结果] 唤醒延迟分布 (us):");
+  for (int i = 0; i < NET_LATENCY_BUCKETS; i++) {
+    if (stats.wakeup_latency_hist[i])
+      printf(" <%u:%u", 1u << i, stats.wakeup_latency_hist[i]);
+  }
+  printf("\n");
+
+  // 流式写盘时帧不进入内存缓存，以文件记录代替缓存统计和视图检查
+  bool stored_ok = stream_mode ? records >= 0 && (uint64_t)records == ss.frames &&
+                                 ss.write_errors == 0 && ss.dropped_frames == 0
+                               : chunk_mode ? chunk_ok && chunk_count > 1 && chunk_packets == stats.total_packets &&
+                                              stats.total_packets == frames_ok
+                               : stats.total_packets == frames_ok && view_ok;
+  bool pass = frames_ok + stats.kernel_dropped_packets == frames_sent &&
+              stats.dropped_packets == stats.cache_full_drops + stats.index_full_drops &&
+              frames_out_of_order <= stats.kernel_dropped_packets &&
+              frames_dispatched + stats.dispatch_overflow == frames_ok && stored_ok &&
+              (!dual_mode || (dual_ctx_ok && dual_packets + dual_kernel_dropped == frames_sent)) &&
+              replay_ok && shm_ok && (!monitor_mode || (monitor_snapshots > 0 && monitor_torn == 0)) && (!armed_mode || (stats.shot_seq == 3 && stats.outside_window_packets == idle_sent && dispatched_late == 0));
+  printf("%s\n", pass ? "✅ 测试通过" : "❌ 测试失败");
+  return pass ? 0 : 1;
+}
@@ -832,6 +832,7 @@ int main(int argc, char *argv[]) {
   // 清理工作
   printf("🧹 执行清理工作...\n");
   // 注意：实际的硬件清理应该在各个驱动模块中完成
+  sbeam_release_cache();
   
   printf("🎉 测试程序正常退出\n");
   return 0;
@@ -235,18 +235,46 @@ int main(int argc, char *argv[]) {
   // 打印测试配置
   print_lib_test_config(&dds_config, start_gain, end_gain, gain_duration_us, cache_size);
   
-  printf("🚀 开始调用库函数...\n");
+  // 用法: test_lib_sbeam [网卡名] [采集次数] [legacy]，设备只在打开会话时初始化一次；
+  // legacy 使用原来的固定延时，用于对比每次采集的建立时间
+  sbeam_session_config_t session_cfg;
+  sbeam_session_config_init(&session_cfg);
+  if (argc > 1)
+    session_cfg.eth_ifname = argv[1];
+  if (argc > 3 && strcmp(argv[3], "legacy") == 0)
+    session_cfg.legacy_settle = true;
+  int shots = argc > 2 ? atoi(argv[2]) : 1;
+  if (shots < 1)
+    shots = 1;
+
+  sbeam_session_t *session = sbeam_session_open(&session_cfg);
+  if (!session) {
+    printf("❌ 打开 sbeam 会话失败\n");
+    return -1;
+  }
+
+  printf("🚀 开始调用库函数（%d 次）...\n", shots);
   
   // 调用库函数 - 这是主要测试点
-  int result = transmit_and_receive_single_beam_with_cache(
-    &dds_config,
-    start_gain,
-    end_gain,
-    gain_duration_us,
-    lib_packet_callback,  // 实时包回调
-    lib_cache_callback,   // 缓存回调
-    cache_size        // 缓存大小
-  );
+  int result = 0;
+  for (int i = 0; i < shots && keep_running && result == 0; i++) {
+    result = sbeam_session_transmit_and_receive(
+      session,
+      &dds_config,
+      start_gain,
+      end_gain,
+      gain_duration_us,
+      lib_packet_callback,  // 实时包回调
+      lib_cache_callback,   // 缓存回调
+      cache_size        // 缓存大小
+    );
+    sbeam_shot_stats_t shot = sbeam_session_get_shot_stats(session);
+    printf("⏱️  第 %d 次: 建立 %.3f ms，等待器件 %.3f ms，DDS 写 %u 字，DAC 写 %u 个寄存器，I2C 传输 %u 次%s\n",
+           i + 1, shot.setup_ns / 1e6, shot.settle_wait_ns / 1e6, shot.dds_words, shot.dac_regs,
+           shot.i2c_transfers,
+           shot.plan_reused ? "（计划复用）" : "");
+  }
+  sbeam_session_close(session);
   
   if (result == 0) {
     printf("✅ 库函数调用成功\n");
@@ -268,6 +296,7 @@ int main(int argc, char *argv[]) {
   // 清理工作
   printf("🧹 执行清理工作...\n");
   sbeam_clear_cache();  // 清理缓存
+  sbeam_release_cache();
   
   printf("🎉 库调用测试完成\n");
   return 0;
@@ -3,12 +3,14 @@
 #include "../dev/dac63001.h"
 #include "../dev/fpga.h"
 #include "../dev/net_listener.h"  // 只在实现文件中包含
+#include "../protocol/i2c_hal.h"
 #include "../utils/log.h"
+#include "../utils/settle.h"
 #include <pthread.h>
 #include <unistd.h>
-
-static const char *i2c_dev = "/dev/i2c-2";
-static const char *eth_ifname = "eth0";
+#include <stdlib.h>
+#include <string.h>
+#include <net/if.h>
 
 typedef struct {
   DDSConfig cfg;
@@ -27,6 +29,140 @@ S_udp_header_params udp_header_params = {
   .udp_data_len = 0x408
 };
 
+// 编译后的采集计划：一组采集参数对应的 DDS 与增益寄存器映像
+typedef struct {
+  DDSConfig dds;
+  uint16_t start_gain;
+  uint16_t end_gain;
+  uint32_t gain_duration_us;
+  ad5932_image_t dds_image;
+  dac63001_gain_image_t gain_image;
+} shot_plan_t;
+
+#define SBEAM_PLAN_CACHE_SIZE 8
+
+struct sbeam_session {
+  char i2c_dev[64];
+  char eth_ifname[IFNAMSIZ];
+  S_udp_header_params udp;
+
+  shot_plan_t plans[SBEAM_PLAN_CACHE_SIZE];
+  uint32_t plan_count;
+  uint32_t plan_next;                 // 缓存满时下一个被替换的计划
+  ad5932_image_t dds_applied;         // 芯片中当前的 DDS 寄存器映像
+  bool dds_applied_valid;
+  dac63001_gain_image_t gain_applied; // 芯片中当前的增益寄存器映像
+  bool gain_applied_valid;
+  sbeam_shot_stats_t shot_stats;      // 最近一次采集
+};
+
+// 设备描述符在 HAL 中是进程内唯一的，同一时间只有一个会话
+static sbeam_session_t *active_session = NULL;
+
+// 未打开会话时，旧接口使用默认设备和库内置的 UDP 包头
+static const char *current_i2c_dev(void) {
+  return active_session ? active_session->i2c_dev : SBEAM_DEFAULT_I2C_DEV;
+}
+
+static const char *current_ifname(void) {
+  return active_session ? active_session->eth_ifname : SBEAM_DEFAULT_ETH_IFNAME;
+}
+
+static const S_udp_header_params *current_udp(void) {
+  return active_session ? &active_session->udp : &udp_header_params;
+}
+
+// 旧接口结束时释放 I2C；会话打开期间描述符归会话所有，不能关闭
+static void release_i2c(void) {
+  if (!active_session)
+    dac63001_close();
+}
+
+// 旧接口绕过会话直接写 DDS/DAC 和 FPGA 触发：会话记录的芯片映像和 GPIO 触发状态不再可信，
+// 下次会话采集全部重写
+static void invalidate_session_images(void) {
+  if (!active_session)
+    return;
+  active_session->dds_applied_valid = false;
+  active_session->gain_applied_valid = false;
+}
+
+
+/**
+ * @brief 启动网络监听（选择实时包回调或缓存模式）
+ * @details 使用 TPACKET_V3 内存映射环形缓冲区接收，避免每帧一次 recv() 系统调用；
+ *          并按 udp_header_params 在内核中过滤，只有 FPGA 数据帧进入用户空间。
+ */
+static int start_listener(NetPacketCallback packet_cb, NetCacheCallback cache_cb, uint32_t cache_size) {
+  net_listener_config_t cfg;
+  net_listener_config_init(&cfg);
+  cfg.mode = NET_CAPTURE_MMAP;
+  cfg.udp_filter_enable = true;
+  cfg.udp_filter = *current_udp();
+
+  if (cache_cb && cache_size > 0) {
+    if (net_listener_start_with_config(current_ifname(), packet_cb, cache_cb, cache_size, &cfg) < 0) {
+      LOG_ERROR("带缓存的网络监听启动失败\n");
+      return -1;
+    }
+    LOG_INFO("启动带缓存的网络监听，缓存大小: %u MB\n", cache_size / (1024 * 1024));
+  } else {
+    if (net_listener_start_with_config(current_ifname(), packet_cb, NULL, 0, &cfg) < 0) {
+      LOG_ERROR("网络监听启动失败\n");
+      return -1;
+    }
+    LOG_INFO("启动实时包回调网络监听\n");
+  }
+  return 0;
+}
+
+// 常驻预备监听：启动时注册转发回调，每次采集前换成本次调用的回调。
+// 转发回调在分发线程中读取，两个指针都用原子操作访问
+static bool listener_armed = false;
+static char armed_ifname[IFNAMSIZ];
+static NetPacketCallback shot_packet_cb = NULL;
+static NetCacheCallback shot_cache_cb = NULL;
+
+static void armed_packet_callback(const uint8_t *data, int length) {
+  NetPacketCallback cb = __atomic_load_n(&shot_packet_cb, __ATOMIC_ACQUIRE);
+  if (cb)
+    cb(data, length);
+}
+
+static void armed_cache_callback(const uint8_t *cache_data, uint32_t total_packets,
+                                 uint64_t total_bytes, const uint32_t *packet_lengths) {
+  NetCacheCallback cb = __atomic_load_n(&shot_cache_cb, __ATOMIC_ACQUIRE);
+  if (cb)
+    cb(cache_data, total_packets, total_bytes, packet_lengths);
+}
+
+int sbeam_listener_arm(uint32_t cache_size) {
+  if (listener_armed)
+    return 0;
+
+  net_listener_config_t cfg;
+  net_listener_config_init(&cfg);
+  cfg.mode = NET_CAPTURE_MMAP;
+  cfg.udp_filter_enable = true;
+  cfg.udp_filter = *current_udp();
+  cfg.armed = true;
+  // 记下网卡名，会话先于监听关闭时仍能停到同一块网卡
+  snprintf(armed_ifname, sizeof(armed_ifname), "%s", current_ifname());
+  if (net_listener_start_with_config(armed_ifname, armed_packet_callback, armed_cache_callback,
+                                     cache_size, &cfg) < 0) {
+    LOG_ERROR("常驻网络监听启动失败\n");
+    return -1;
+  }
+  listener_armed = true;
+  LOG_INFO("常驻网络监听已就绪，缓存大小: %u MB\n", cache_size / (1024 * 1024));
+  return 0;
+}
+
+void sbeam_listener_disarm(void) {
+  if (listener_armed)
+    sbeam_stop_listener_with_cache(armed_ifname);
+}
+
 
 void* sweep_thread(void* arg) {
   SweepTask *task = (SweepTask*)arg;
@@ -53,11 +189,14 @@ void* sweep_thread(void* arg) {
 
 
 void generate_single_beam_signal(const DDSConfig *cfg) {
-  // 初始化 FPGA UDP 头
-  fpga_init(i2c_dev);
-  fpga_initialize_udp_header(&udp_header_params);
+  // 初始化 FPGA UDP 头（会话打开时已写入）
+  if (!active_session) {
+    fpga_init(current_i2c_dev());
+    fpga_initialize_udp_header(&udp_header_params);
+  }
   fpga_set_acq_enable(false);
   fpga_set_dac_ctrl_en(false); // 单独调用时，停用 DAC 的 GPIO 生成增益波形
+  invalidate_session_images();
 
   // 创建扫频线程
   pthread_t tid;
@@ -86,30 +225,21 @@ void receive_single_beam_response_with_cache(
   NetCacheCallback cache_cb,
   uint32_t cache_size
 ) {
+  invalidate_session_images();
+
   // 启动FPGA采集
-  fpga_init(i2c_dev);
+  fpga_init(current_i2c_dev());
   fpga_trigger_soft_reset();
   fpga_set_acq_enable(true);
 
   // 启动网络监听（选择实时包回调或缓存模式）
-  if (cache_cb && cache_size > 0) {
-    if (net_listener_start_with_cache(eth_ifname, packet_cb, cache_cb, cache_size) < 0) {
-      LOG_ERROR("带缓存的网络监听启动失败\n");
-      return;
-    }
-    LOG_INFO("启动带缓存的网络监听，缓存大小: %u MB\n", cache_size / (1024 * 1024));
-  } else {
-    if (net_listener_start(eth_ifname, packet_cb) < 0) {
-      LOG_ERROR("网络监听启动失败\n");
-      return;
-    }
-    LOG_INFO("启动实时包回调网络监听\n");
-  }
+  if (start_listener(packet_cb, cache_cb, cache_size) < 0)
+    return;
 
   // 配置DAC63001增益控制
-  dac63001_init(i2c_dev);
-  // 配置外部参考模式
-  if (dac63001_setup_external_ref() < 0) {
+  dac63001_init(current_i2c_dev());
+  // 配置外部参考模式（会话打开时已配置）
+  if (!active_session && dac63001_setup_external_ref() < 0) {
     LOG_ERROR("DAC配置失败\n");
     dac63001_close();
     return;
@@ -125,7 +255,7 @@ void receive_single_beam_response_with_cache(
   } else {
     if (dac63001_set_gain_sweep(start_gain, end_gain, gain_duration_us) < 0) {
       LOG_ERROR("增益扫描设置失败\n");
-      dac63001_close();
+      release_i2c();
       return 1;
     }
   }
@@ -140,12 +270,12 @@ void receive_single_beam_response_with_cache(
   LOG_INFO("单波束收发流程完成\n");
 
   // 停止网络监听（这会触发缓存回调）
-  sbeam_stop_listener_with_cache(eth_ifname);
+  sbeam_stop_listener_with_cache(current_ifname());
 
   // 清理资源
   ad5932_reset();
   ad5932_set_standby(false);
-  dac63001_close();
+  release_i2c();
   
   return 0;
 }
@@ -163,7 +293,214 @@ int transmit_and_receive_single_beam(
 }
 
 
-int transmit_and_receive_single_beam_with_cache(
+void sbeam_session_config_init(sbeam_session_config_t *cfg) {
+  cfg->i2c_dev = SBEAM_DEFAULT_I2C_DEV;
+  cfg->eth_ifname = SBEAM_DEFAULT_ETH_IFNAME;
+  cfg->udp.dst_mac_high = udp_header_params.dst_mac_high;
+  cfg->udp.dst_mac_low = udp_header_params.dst_mac_low;
+  cfg->udp.src_mac_high = udp_header_params.src_mac_high;
+  cfg->udp.src_mac_low = udp_header_params.src_mac_low;
+  cfg->udp.src_ip = udp_header_params.src_ip;
+  cfg->udp.dst_ip = udp_header_params.dst_ip;
+  cfg->udp.src_port = udp_header_params.src_port;
+  cfg->udp.dst_port = udp_header_params.dst_port;
+  cfg->udp.ip_total_len = udp_header_params.ip_total_len;
+  cfg->udp.udp_data_len = udp_header_params.udp_data_len;
+  cfg->legacy_settle = false;
+  cfg->dds_spi_hz = 0;
+}
+
+sbeam_session_t *sbeam_session_open(const sbeam_session_config_t *cfg) {
+  if (active_session) {
+    LOG_ERROR("已有打开的 sbeam 会话\n");
+    return NULL;
+  }
+
+  sbeam_session_config_t defaults;
+  if (!cfg) {
+    sbeam_session_config_init(&defaults);
+    cfg = &defaults;
+  }
+
+  sbeam_session_t *s = calloc(1, sizeof(*s));
+  if (!s)
+    return NULL;
+  snprintf(s->i2c_dev, sizeof(s->i2c_dev), "%s", cfg->i2c_dev ? cfg->i2c_dev : SBEAM_DEFAULT_I2C_DEV);
+  snprintf(s->eth_ifname, sizeof(s->eth_ifname), "%s",
+           cfg->eth_ifname ? cfg->eth_ifname : SBEAM_DEFAULT_ETH_IFNAME);
+  s->udp.dst_mac_high = cfg->udp.dst_mac_high;
+  s->udp.dst_mac_low = cfg->udp.dst_mac_low;
+  s->udp.src_mac_high = cfg->udp.src_mac_high;
+  s->udp.src_mac_low = cfg->udp.src_mac_low;
+  s->udp.src_ip = cfg->udp.src_ip;
+  s->udp.dst_ip = cfg->udp.dst_ip;
+  s->udp.src_port = cfg->udp.src_port;
+  s->udp.dst_port = cfg->udp.dst_port;
+  s->udp.ip_total_len = cfg->udp.ip_total_len;
+  s->udp.udp_data_len = cfg->udp.udp_data_len;
+
+  if (cfg->legacy_settle) {
+    ad5932_timing_t dds_timing = AD5932_TIMING_LEGACY;
+    dac63001_timing_t dac_timing = DAC63001_TIMING_LEGACY;
+    ad5932_set_timing(&dds_timing);
+    dac63001_set_timing(&dac_timing);
+  } else {
+    ad5932_set_timing(NULL);
+    dac63001_set_timing(NULL);
+  }
+
+  ad5932_set_spi_speed(cfg->dds_spi_hz);
+
+  // FPGA 与 DAC63001 共用同一个 I2C 描述符
+  if (fpga_init(s->i2c_dev) < 0) {
+    LOG_ERROR("打开 I2C 设备 %s 失败\n", s->i2c_dev);
+    free(s);
+    return NULL;
+  }
+  if (fpga_initialize_udp_header(&s->udp) < 0)
+    goto fail_i2c;
+
+  if (ad5932_init() < 0) {
+    LOG_ERROR("打开 AD5932 SPI 设备失败\n");
+    goto fail_i2c;
+  }
+
+  dac63001_init(s->i2c_dev);
+  if (dac63001_setup_external_ref() < 0) {
+    LOG_ERROR("DAC外部参考模式配置失败\n");
+    ad5932_close();
+    goto fail_i2c;
+  }
+
+  // DDS 从复位状态开始，寄存器映像未知，第一次采集全部写入
+  ad5932_reset();
+
+  active_session = s;
+  LOG_INFO("sbeam 会话已打开: I2C %s, 网卡 %s\n", s->i2c_dev, s->eth_ifname);
+  return s;
+
+fail_i2c:
+  dac63001_close();
+  free(s);
+  return NULL;
+}
+
+sbeam_shot_stats_t sbeam_session_get_shot_stats(const sbeam_session_t *session) {
+  sbeam_shot_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+  if (session)
+    stats = session->shot_stats;
+  return stats;
+}
+
+void sbeam_session_close(sbeam_session_t *session) {
+  if (!session)
+    return;
+
+  ad5932_reset();
+  ad5932_set_standby(false);
+  ad5932_close();
+  dac63001_close();
+  ad5932_set_timing(NULL);
+  dac63001_set_timing(NULL);
+  ad5932_set_spi_speed(0);
+  if (active_session == session)
+    active_session = NULL;
+  LOG_INFO("sbeam 会话已关闭\n");
+  free(session);
+}
+
+static bool plan_matches(const shot_plan_t *p, const DDSConfig *cfg, uint16_t start_gain,
+                         uint16_t end_gain, uint32_t gain_duration_us) {
+  return p->dds.start_freq == cfg->start_freq && p->dds.delta_freq == cfg->delta_freq &&
+         p->dds.num_incr == cfg->num_incr && p->dds.wave_type == cfg->wave_type &&
+         p->dds.mclk_mult == cfg->mclk_mult && p->dds.interval_val == cfg->interval_val &&
+         p->dds.positive_incr == cfg->positive_incr && p->start_gain == start_gain &&
+         p->end_gain == end_gain && p->gain_duration_us == gain_duration_us;
+}
+
+// 按采集参数查找已编译的计划，没有时计算寄存器映像并放入缓存
+static const shot_plan_t *get_shot_plan(sbeam_session_t *s, const DDSConfig *cfg, uint16_t start_gain,
+                                        uint16_t end_gain, uint32_t gain_duration_us) {
+  for (uint32_t i = 0; i < s->plan_count; i++) {
+    if (plan_matches(&s->plans[i], cfg, start_gain, end_gain, gain_duration_us)) {
+      s->shot_stats.plan_reused = true;
+      return &s->plans[i];
+    }
+  }
+
+  shot_plan_t plan;
+  plan.dds = *cfg;
+  plan.start_gain = start_gain;
+  plan.end_gain = end_gain;
+  plan.gain_duration_us = gain_duration_us;
+  ad5932_build_image(&plan.dds_image, cfg->start_freq, cfg->delta_freq, cfg->positive_incr,
+                     cfg->num_incr, 0, cfg->mclk_mult, cfg->interval_val, cfg->wave_type);
+
+  if (start_gain == end_gain) {
+    // 固定增益模式，直接设置电压
+    float voltage = ad8338_gain_to_voltage(start_gain);
+    LOG_INFO("起始和结束增益相同，直接设置固定电压进行接收信号 %.3fV\n", voltage);
+    dac63001_build_fixed_image(voltage, &plan.gain_image);
+  } else if (dac63001_build_gain_sweep_image(start_gain, end_gain, gain_duration_us,
+                                             &plan.gain_image) < 0) {
+    LOG_ERROR("增益扫描设置失败\n");
+    return NULL;
+  }
+
+  uint32_t slot;
+  if (s->plan_count < SBEAM_PLAN_CACHE_SIZE)
+    slot = s->plan_count++;
+  else
+    slot = s->plan_next++ % SBEAM_PLAN_CACHE_SIZE;
+  s->plans[slot] = plan;
+  return &s->plans[slot];
+}
+
+// 只写入与上一次采集不同的寄存器
+static int arm_shot_plan(sbeam_session_t *s, const shot_plan_t *plan) {
+  int dds_words = ad5932_apply_image(&plan->dds_image, s->dds_applied_valid ? &s->dds_applied : NULL);
+  if (dds_words < 0) {
+    s->dds_applied_valid = false;
+    LOG_ERROR("DDS寄存器写入失败\n");
+    return -1;
+  }
+  s->dds_applied = plan->dds_image;
+  s->dds_applied_valid = true;
+
+  const dac63001_gain_image_t *prev = s->gain_applied_valid ? &s->gain_applied : NULL;
+  bool mode_changed = !prev || prev->sweep != plan->gain_image.sweep;
+  int gain_regs = dac63001_apply_gain_image(&plan->gain_image, prev);
+  if (gain_regs < 0) {
+    s->gain_applied_valid = false;
+    LOG_ERROR("增益寄存器写入失败\n");
+    return -1;
+  }
+
+  // 增益模式切换时才改 GPIO 触发：扫描需要扫频结束时由 GPIO 启动波形，固定增益不需要
+  if (mode_changed) {
+    if (plan->gain_image.sweep) {
+      if (dac63001_enable_gpio_start_stop_trigger() < 0) {
+        s->gain_applied_valid = false;
+        LOG_ERROR("DAC GPIO触发配置失败\n");
+        return -1;
+      }
+    } else {
+      LOG_INFO("固定增益时，不启用FPGA的触发锯齿波增益波形\n");
+      fpga_set_dac_ctrl_en(false);
+    }
+  }
+  s->gain_applied = plan->gain_image;
+  s->gain_applied_valid = true;
+
+  s->shot_stats.dds_words = (uint32_t)dds_words;
+  s->shot_stats.dac_regs = (uint32_t)gain_regs;
+  LOG_INFO("采集计划就绪: DDS 写入 %d 字，DAC 写入 %d 个寄存器\n", dds_words, gain_regs);
+  return 0;
+}
+
+int sbeam_session_transmit_and_receive(
+  sbeam_session_t *session,
   const DDSConfig *cfg,
   uint16_t start_gain,
   uint16_t end_gain,
@@ -172,99 +509,97 @@ int transmit_and_receive_single_beam_with_cache(
   NetCacheCallback cache_cb,
   uint32_t cache_size
 ) {
-  // 1. 初始化FPGA网络头
-  fpga_init(i2c_dev);
-  fpga_initialize_udp_header(&udp_header_params);
-  
-  // 2. 配置扫频参数
-  ad5932_init();
-  ad5932_reset();
-  ad5932_set_start_frequency(cfg->start_freq);
-  ad5932_set_delta_frequency(cfg->delta_freq, cfg->positive_incr);
-  ad5932_set_number_of_increments(cfg->num_incr);
-  ad5932_set_increment_interval(0, cfg->mclk_mult, cfg->interval_val);
-  ad5932_set_waveform(cfg->wave_type);
-  
-  // 3. 配置接收增益
-  dac63001_init(i2c_dev);
-  if (dac63001_setup_external_ref() < 0) {
-    LOG_ERROR("DAC外部参考模式配置失败\n");
-    dac63001_close();
+  if (!session || session != active_session) {
+    LOG_ERROR("sbeam 会话未打开\n");
     return -1;
   }
 
-  // 固定增益模式，直接设置电压
-  if (start_gain == end_gain) {
-    float voltage = ad8338_gain_to_voltage(start_gain);
-    LOG_INFO("起始和结束增益相同，直接设置固定电压进行接收信号 %.3fV\n", voltage);
-    dac63001_set_fixed_voltage(voltage);
-    LOG_INFO("当前增益: %d dB (%.3fV)\n", start_gain, voltage);
+  uint64_t setup_start = settle_now_ns();
+  uint64_t waited_start = ad5932_settle_waited_ns() + dac63001_settle_waited_ns();
+  uint64_t i2c_start = i2c_hal_transfer_count();
+  memset(&session->shot_stats, 0, sizeof(session->shot_stats));
 
-    LOG_INFO("固定增益时，不启用FPGA的触发锯齿波增益波形\n");
-    fpga_set_dac_ctrl_en(false);
-  } else {
-    // 锯齿波增益扫描模式，仅需配置
-    if (dac63001_set_gain_sweep(start_gain, end_gain, gain_duration_us) < 0) {
-      LOG_ERROR("增益扫描设置失败\n");
-      dac63001_close();
-      return -1;
-    }
-  
-    // 4. 可变增益时，需要配置GPIO触发以同步增益扫描开始
-    if (dac63001_enable_gpio_start_stop_trigger() < 0) {
-      LOG_ERROR("DAC GPIO触发配置失败\n");
-      dac63001_close();
-      return -1;
-    }
-  }
+  // 1-3. 配置扫频参数与接收增益：设备、UDP 包头和外部参考模式在打开会话时已初始化，
+  //      这里只写入与上一次采集不同的寄存器，参数不变时不访问 SPI/I2C（复位过的 DDS 控制字除外）
+  const shot_plan_t *plan = get_shot_plan(session, cfg, start_gain, end_gain, gain_duration_us);
+  if (!plan || arm_shot_plan(session, plan) < 0)
+    return -1;
   
-  // 5. 启动网络监听（选择实时包回调或缓存模式）
-  if (cache_cb && cache_size > 0) {
-    if (net_listener_start_with_cache(eth_ifname, packet_cb, cache_cb, cache_size) < 0) {
-      LOG_ERROR("带缓存的网络监听启动失败\n");
-      dac63001_close();
+  // 4. 启动网络监听（选择实时包回调或缓存模式）；常驻预备时只打开采集窗口
+  if (listener_armed) {
+    __atomic_store_n(&shot_packet_cb, packet_cb, __ATOMIC_RELEASE);
+    __atomic_store_n(&shot_cache_cb, cache_cb, __ATOMIC_RELEASE);
+    if (net_listener_shot_begin() < 0) {
+      LOG_ERROR("打开采集窗口失败\n");
       return -1;
     }
-    LOG_INFO("启动带缓存的网络监听，缓存大小: %u MB\n", cache_size / (1024 * 1024));
-  } else {
-    if (net_listener_start(eth_ifname, packet_cb) < 0) {
-      LOG_ERROR("网络监听启动失败\n");
-      dac63001_close();
-      return -1;
-    }
-    LOG_INFO("启动实时包回调网络监听\n");
+  } else if (start_listener(packet_cb, cache_cb, cache_size) < 0) {
+    return -1;
   }
   
-  // 6. 启动FPGA发送网络包
+  // 5. 增益配置生效后启动FPGA发送网络包
+  dac63001_wait_settled();
   fpga_set_acq_enable(true);
   
-  // 7. 启动扫频信号，并同步等待扫频结束(同时也是增益输出的触发信号)
+  // 6. 启动扫频信号，并同步等待扫频结束(同时也是增益输出的触发信号)
   ad5932_start_sweep();
-  LOG_INFO("扫频信号开始生成...\n");
+  session->shot_stats.setup_ns = settle_now_ns() - setup_start;
+  session->shot_stats.settle_wait_ns = ad5932_settle_waited_ns() + dac63001_settle_waited_ns() - waited_start;
+  session->shot_stats.i2c_transfers = (uint32_t)(i2c_hal_transfer_count() - i2c_start);
+  LOG_INFO("扫频信号开始生成，建立耗时 %.3f ms（等待器件生效 %.3f ms，I2C 传输 %u 次）\n",
+           session->shot_stats.setup_ns / 1e6, session->shot_stats.settle_wait_ns / 1e6,
+           session->shot_stats.i2c_transfers);
   
-  // 8. 扫频结束后硬件 GPIO 触发立即启动增益扫描波形
+  // 7. 扫频结束后硬件 GPIO 触发立即启动增益扫描波形
   while (!ad5932_is_sweep_done()) {
     usleep(1); // 1微秒轮询等待
   }
   LOG_INFO("扫频信号生成完成，同时产生增益控制信号接收数据\n");
   
-  // 10. 延迟增益持续的时间+50ms后，停止FPGA发送网络包
+  // 8. 延迟增益持续的时间+50ms后，停止FPGA发送网络包
   usleep(gain_duration_us + 50000);
   fpga_set_acq_enable(false);
   LOG_INFO("单波束收发流程完成\n");
 
-  // 11. 停止网络监听（这会触发缓存回调）
-  sbeam_stop_listener_with_cache(eth_ifname);
+  // 9. 停止网络监听（这会触发缓存回调）；常驻预备时只关闭采集窗口
+  if (listener_armed)
+    net_listener_shot_end();
+  else
+    sbeam_stop_listener_with_cache(session->eth_ifname);
   
-  // 清理资源
+  // 10. DDS 回到复位状态，等待下一次采集；复位只改写控制字，下次采集重写控制字即可
   ad5932_reset();
   ad5932_set_standby(false);
-  dac63001_close();
+  session->dds_applied.words[AD5932_IMG_CONTROL] = AD5932_RESET_WORD;
   
   return 0;
 }
 
 
+int transmit_and_receive_single_beam_with_cache(
+  const DDSConfig *cfg,
+  uint16_t start_gain,
+  uint16_t end_gain,
+  uint32_t gain_duration_us,
+  NetPacketCallback packet_cb,
+  NetCacheCallback cache_cb,
+  uint32_t cache_size
+) {
+  if (active_session)
+    return sbeam_session_transmit_and_receive(active_session, cfg, start_gain, end_gain,
+                                              gain_duration_us, packet_cb, cache_cb, cache_size);
+
+  // 未打开会话时按默认配置临时打开，保持每次调用独立初始化、结束后释放设备的旧行为
+  sbeam_session_t *session = sbeam_session_open(NULL);
+  if (!session)
+    return -1;
+  int ret = sbeam_session_transmit_and_receive(session, cfg, start_gain, end_gain,
+                                               gain_duration_us, packet_cb, cache_cb, cache_size);
+  sbeam_session_close(session);
+  return ret;
+}
+
+
 sbeam_cache_stats_t sbeam_get_cache_stats(void) {
   cache_stats_t net_stats = net_listener_get_cache_stats();
   sbeam_cache_stats_t stats;
@@ -274,14 +609,38 @@ sbeam_cache_stats_t sbeam_get_cache_stats(void) {
   stats.cache_size = net_stats.cache_size;
   stats.cache_used = net_stats.cache_used;
   stats.dropped_packets = net_stats.dropped_packets;
+  stats.cache_full_drops = net_stats.cache_full_drops;
+  stats.index_full_drops = net_stats.index_full_drops;
+  stats.kernel_dropped_packets = net_stats.kernel_dropped_packets;
+  stats.rcvbuf_bytes = net_stats.rcvbuf_bytes;
   
   return stats;
 }
 
+sbeam_timestamp_stats_t sbeam_get_timestamp_stats(void) {
+  net_timestamp_stats_t net_stats = net_listener_get_timestamp_stats();
+  sbeam_timestamp_stats_t stats;
+
+  stats.count = net_stats.count;
+  stats.first_ns = net_stats.first_ns;
+  stats.last_ns = net_stats.last_ns;
+  stats.min_gap_ns = net_stats.min_gap_ns;
+  stats.max_gap_ns = net_stats.max_gap_ns;
+  stats.mean_gap_ns = net_stats.mean_gap_ns;
+  stats.jitter_ns = net_stats.jitter_ns;
+
+  return stats;
+}
+
 void sbeam_clear_cache(void) {
   net_listener_clear_cache();
 }
 
 void sbeam_stop_listener_with_cache(const char *ifname) {
+  listener_armed = false;
   net_listener_stop_with_cache(ifname);
+}
+
+void sbeam_release_cache(void) {
+  net_listener_release_cache();
 }
\ No newline at end of file
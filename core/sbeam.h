@@ -30,9 +30,64 @@ typedef struct {
   uint64_t total_bytes;        // 总字节数
   uint32_t cache_size;         // 缓存大小
   uint32_t cache_used;         // 已用缓存
-  uint32_t dropped_packets;    // 丢弃的包数
+  uint32_t dropped_packets;    // 丢弃的包数（= cache_full_drops + index_full_drops）
+  uint32_t cache_full_drops;   // 缓存数据区已满丢弃的包数
+  uint32_t index_full_drops;   // 包索引已满丢弃的包数
+  uint32_t kernel_dropped_packets; // 内核环形缓冲区丢弃的包数
+  uint32_t rcvbuf_bytes;       // 实际的套接字接收缓冲区大小
 } sbeam_cache_stats_t;
 
+// 包到达时间统计结构体
+typedef struct {
+  uint32_t count;              // 带时间戳的包数
+  uint64_t first_ns;           // 第一包接收时间（CLOCK_REALTIME 纳秒）
+  uint64_t last_ns;            // 最后一包接收时间
+  uint64_t min_gap_ns;         // 最小包间隔
+  uint64_t max_gap_ns;         // 最大包间隔
+  double mean_gap_ns;          // 平均包间隔
+  double jitter_ns;            // 包间隔标准差
+} sbeam_timestamp_stats_t;
+
+// 会话默认使用的硬件接口
+#define SBEAM_DEFAULT_I2C_DEV    "/dev/i2c-2"
+#define SBEAM_DEFAULT_ETH_IFNAME "eth0"
+
+// FPGA 发出的 UDP 包头参数（主机字节序），与 FPGA 寄存器中的包头模板一一对应
+typedef struct {
+  uint16_t dst_mac_high;   // 目的 MAC 高 16 位
+  uint32_t dst_mac_low;    // 目的 MAC 低 32 位
+  uint16_t src_mac_high;   // 源 MAC 高 16 位
+  uint32_t src_mac_low;    // 源 MAC 低 32 位
+  uint32_t src_ip;
+  uint32_t dst_ip;
+  uint16_t src_port;
+  uint16_t dst_port;
+  uint16_t ip_total_len;
+  uint16_t udp_data_len;
+} sbeam_udp_params_t;
+
+// 会话配置
+typedef struct {
+  const char *i2c_dev;         // FPGA / DAC63001 所在的 I2C 总线设备
+  const char *eth_ifname;      // 接收 FPGA 数据的网卡
+  sbeam_udp_params_t udp;      // 写入 FPGA 的 UDP 包头，同时用于内核过滤
+  bool legacy_settle;          // 使用原来的固定延时代替按数据手册等待（对比建立时间用）
+  uint32_t dds_spi_hz;         // AD5932 的 SPI 时钟，0 表示默认 1 MHz，最高 40 MHz
+} sbeam_session_config_t;
+
+// 单次采集的建立时间统计
+typedef struct {
+  uint64_t setup_ns;           // 从调用开始到触发扫频的时间
+  uint64_t settle_wait_ns;     // 其中等待器件配置生效的时间
+  uint32_t dds_words;          // 本次写入 AD5932 的寄存器字数
+  uint32_t dac_regs;           // 本次写入 DAC63001 的寄存器数
+  uint32_t i2c_transfers;      // 建立过程中发出的 I2C 传输次数
+  bool plan_reused;            // 采集计划来自缓存
+} sbeam_shot_stats_t;
+
+// 会话句柄：持有 I2C/SPI 设备、网卡名与 UDP 包头参数
+typedef struct sbeam_session sbeam_session_t;
+
 
 /**
  * @brief 生成单波束信号（配置并启动 AD5932）
@@ -172,7 +227,8 @@ void receive_single_beam_response_with_cache(
  *  - `-1`：任意初始化、配置或启动阶段失败。
  * 
  * @note
- * - 调用前需确保 `i2c_dev`、`eth_ifname`、`udp_header_params` 已正确初始化；
+ * - 已打开会话时在该会话上执行；否则按默认配置临时打开一个会话，结束后关闭；
+ * - 连续多次采集时应使用 sbeam_session_open 与 sbeam_session_transmit_and_receive，避免每次重新初始化设备；
  * - 若启用缓存模式，需保证系统内存充足；
  * - 函数执行过程为阻塞式，直到扫频和接收流程完全结束；
  * - 在错误退出时会自动关闭 DAC 和网络监听。
@@ -188,19 +244,92 @@ int transmit_and_receive_single_beam_with_cache(
 );
 
 
+/**
+ * @brief 用默认值填充会话配置（SBEAM_DEFAULT_I2C_DEV、SBEAM_DEFAULT_ETH_IFNAME 与库内置 UDP 包头）
+ */
+void sbeam_session_config_init(sbeam_session_config_t *cfg);
+
+/**
+ * @brief 打开会话
+ * @details 打开 I2C 与 SPI 设备，把 UDP 包头写入 FPGA，初始化 AD5932 并把 DAC63001 配置为外部参考模式。
+ *          这些只在打开时做一次，之后在会话上的每次采集只配置本次的扫频与增益。
+ *          设备描述符在进程内只有一份，同一时间只能打开一个会话；会话打开期间，
+ *          旧接口（transmit_and_receive_single_beam_with_cache 等）也在该会话上执行。
+ * @param cfg 会话配置，NULL 表示全部使用默认值
+ * @return 成功返回会话句柄；已有会话打开或任一设备初始化失败时返回 NULL
+ */
+sbeam_session_t *sbeam_session_open(const sbeam_session_config_t *cfg);
+
+/**
+ * @brief 在会话上执行一次单波束收发
+ * @details 流程与参数同 transmit_and_receive_single_beam_with_cache，但不重新打开设备、
+ *          不重写 UDP 包头和 DAC 参考配置，结束后也不关闭设备。
+ * @return 0 成功，-1 失败
+ */
+int sbeam_session_transmit_and_receive(
+  sbeam_session_t *session,
+  const DDSConfig *cfg,
+  uint16_t start_gain,
+  uint16_t end_gain,
+  uint32_t gain_duration_us,
+  NetPacketCallback packet_cb,
+  NetCacheCallback cache_cb,
+  uint32_t cache_size
+);
+
+/**
+ * @brief 获取会话上最近一次采集的建立时间统计
+ * @details 设置 legacy_settle 打开另一个会话跑同样的参数，即可对比原来的固定延时。
+ */
+sbeam_shot_stats_t sbeam_session_get_shot_stats(const sbeam_session_t *session);
+
+/**
+ * @brief 关闭会话，复位 AD5932 并释放 I2C/SPI 设备
+ * @details 不停止常驻预备监听，需要时先调用 sbeam_listener_disarm。
+ */
+void sbeam_session_close(sbeam_session_t *session);
+
 /**
  * @brief 获取缓存统计信息
  */
 sbeam_cache_stats_t sbeam_get_cache_stats(void);
 
+/**
+ * @brief 获取包到达时间统计
+ * @details 可用第一包/最后一包时间与 DDS 扫频结束时间对齐，用间隔标准差衡量抖动。
+ */
+sbeam_timestamp_stats_t sbeam_get_timestamp_stats(void);
+
 /**
  * @brief 手动清空缓存
  */
 void sbeam_clear_cache(void);
 
+/**
+ * @brief 启动常驻预备网络监听
+ * @details 套接字、混杂模式、接收环和抓包线程只建立一次，之后每次
+ *          transmit_and_receive_single_beam_with_cache 只开关一个采集窗口，窗口外的帧丢弃，
+ *          缓存回调在关闭窗口时收到本次采集的数据。各次调用传入的 packet_cb / cache_cb 仍然生效，
+ *          cache_size 以本函数的参数为准。已打开会话时监听该会话的网卡，否则监听 SBEAM_DEFAULT_ETH_IFNAME。
+ * @param cache_size 每次采集的缓存大小（字节）
+ * @return 0 成功，-1 失败
+ */
+int sbeam_listener_arm(uint32_t cache_size);
+
+/**
+ * @brief 停止常驻预备网络监听
+ */
+void sbeam_listener_disarm(void);
+
 /**
  * @brief 停止网络监听（带缓存数据传递）
  */
 void sbeam_stop_listener_with_cache(const char *ifname);
 
+/**
+ * @brief 释放采集缓存
+ * @details 缓存在首次采集时映射、预缺页并锁定，之后各次采集复用；程序退出前调用本函数释放。
+ */
+void sbeam_release_cache(void);
+
 #endif  // SBEAM_H
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include "ad5932.h"
 #include "../protocol/spi_hal.h"
 #include "fpga.h"
+#include "../utils/settle.h"
 #include <stdint.h>
 #include <unistd.h>  // 包含usleep函数，用于必要的延时
 #include <stdio.h>   // 包含标准输入输出函数，例如 FILE
@@ -13,12 +14,70 @@
 
 #define DELTAF_WORD_MULTIPLIER 8388608.0 // 2^23
 
+static ad5932_timing_t timing = AD5932_TIMING_DATASHEET;
+static uint32_t spi_speed_hz = AD5932_SPI_DEFAULT_HZ;
+
+// 已写入的寄存器何时全部生效；触发扫频前等待
+static settle_t dds_settle;
+
+void ad5932_set_timing(const ad5932_timing_t *t) {
+  ad5932_timing_t datasheet = AD5932_TIMING_DATASHEET;
+  timing = t ? *t : datasheet;
+  dds_settle.serialize = timing.serialize;
+}
+
+uint64_t ad5932_settle_waited_ns(void) {
+  return dds_settle.waited_ns;
+}
+
+void ad5932_set_spi_speed(uint32_t speed_hz) {
+  if (speed_hz == 0)
+    speed_hz = AD5932_SPI_DEFAULT_HZ;
+  if (speed_hz > AD5932_SPI_MAX_HZ)
+    speed_hz = AD5932_SPI_MAX_HZ;
+  spi_speed_hz = speed_hz;
+}
+
 
 /**
  * @brief 初始化AD5932驱动
+ * @return 成功返回0，失败返回-1
  */
-void ad5932_init(void) {
-  spi_hal_init();
+int ad5932_init(void) {
+  return spi_hal_init();
+}
+
+/**
+ * @brief 关闭AD5932驱动
+ */
+void ad5932_close(void) {
+  spi_hal_close();
+}
+
+/**
+ * @brief 在一次 SPI 传输中连续写入多个16位字。
+ * @details 每个字之后释放一次片选（FSYNC 上升沿），芯片按单独写入处理。
+ * @return 成功返回0，失败返回-1。
+ */
+int ad5932_write_words(const uint16_t *words, int count) {
+  uint8_t tx_buf[SPI_HAL_MAX_BATCH][2];
+  spi_hal_xfer_t xfers[SPI_HAL_MAX_BATCH];
+
+  if (count > SPI_HAL_MAX_BATCH)
+    return -1;
+  for (int i = 0; i < count; i++) {
+    // 将16位数据拆分为两个8位字节（高位在前）
+    tx_buf[i][0] = (words[i] >> 8) & 0xFF; // MSB
+    tx_buf[i][1] = words[i] & 0xFF;        // LSB
+    xfers[i].tx_buf = tx_buf[i];
+    xfers[i].len = 2;
+    xfers[i].speed_hz = spi_speed_hz;
+    xfers[i].delay_usecs = 0;
+    xfers[i].cs_change = true;
+  }
+
+  // 调用协议层的SPI批量写入函数
+  return spi_hal_write_batch(xfers, count) < 0 ? -1 : 0;
 }
 
 /**
@@ -26,14 +85,7 @@ void ad5932_init(void) {
  * @param data 要写入的16位数据。
  */
 void ad5932_write(uint16_t data) {
-  uint8_t tx_buf[2];
-
-  // 将16位数据拆分为两个8位字节（高位在前）
-  tx_buf[0] = (data >> 8) & 0xFF; // MSB
-  tx_buf[1] = data & 0xFF;        // LSB
-
-  // 调用协议层的SPI写入函数
-  spi_hal_write(tx_buf, 2);
+  ad5932_write_words(&data, 1);
 }
 
 /**
@@ -43,19 +95,13 @@ void ad5932_write(uint16_t data) {
  * 的默认控制字，从而执行复位操作。
  * 这种写入行为会使芯片的内部状态机回到初始状态。
  *
- * @note 根据AD5932数据手册，复位后可能需要短暂的延时以确保芯片
- * 处于就绪状态，因此这里添加了一个10毫秒（10000微秒）的延时。
+ * @note 复位与其他寄存器写入一样只登记生效时间，不在此处延时。
  */
 void ad5932_reset(void) {
 
-  // 构造复位命令: 控制寄存器地址 + 基础控制字 + 24位频率模式
-  uint16_t reset_command = AD5932_REG_CONTROL | AD5932_CTRL_BASE | AD5932_CTRL_B24;
-  
-  // 调用驱动层的写入函数，将复位命令发送给芯片
-  ad5932_write(reset_command);
-  
-  // 添加一个短暂的延时，以确保复位操作完成
-  usleep(10000); // 10毫秒
+  // 复位命令: 控制寄存器地址 + 基础控制字 + 24位频率模式
+  ad5932_write(AD5932_RESET_WORD);
+  settle_after(&dds_settle, timing.write_settle_ns);
 }
 
 /**
@@ -72,7 +118,7 @@ void ad5932_reset(void) {
  *
  * @param wave_type 波形类型(0=正弦波, 1=三角波, 2=方波)
  */
-void ad5932_set_waveform(int wave_type) {
+static uint16_t waveform_word(int wave_type) {
   uint16_t control = AD5932_REG_CONTROL | AD5932_CTRL_BASE | AD5932_CTRL_B24 | AD5932_CTRL_DAC_EN 
     | AD5932_CTRL_SYNC_EN | AD5932_CTRL_SYNC_EOS;
 
@@ -95,9 +141,12 @@ void ad5932_set_waveform(int wave_type) {
       control |= AD5932_CTRL_SINE; // 默认正弦波
       break;
   }
+  return control;
+}
 
-  ad5932_write(control);
-  usleep(10000); // 10 ms 延时确保设置生效
+void ad5932_set_waveform(int wave_type) {
+  ad5932_write(waveform_word(wave_type));
+  settle_after(&dds_settle, timing.write_settle_ns);
 }
 
 
@@ -109,18 +158,25 @@ void ad5932_set_waveform(int wave_type) {
  *
  * @param freq 起始频率，单位为Hz。
  */
-void ad5932_set_start_frequency(uint32_t start_frequency_hz) {
+static void start_frequency_words(uint32_t start_frequency_hz, uint16_t *low, uint16_t *high) {
   uint32_t freq_word;
 
   // 计算频率字: FREQ_WORD = (fout * 2^24) / MCLK
   freq_word = (uint32_t)((start_frequency_hz * FREQ_WORD_MULTIPLIER) / MCLK_FREQUENCY);
   
-  // 写入低12位
-  ad5932_write(AD5932_REG_FSTART_L | (freq_word & 0x0FFF));
-  // 写入高12位
-  ad5932_write(AD5932_REG_FSTART_H | ((freq_word >> 12) & 0x0FFF));
+  *low = AD5932_REG_FSTART_L | (freq_word & 0x0FFF);          // 低12位
+  *high = AD5932_REG_FSTART_H | ((freq_word >> 12) & 0x0FFF); // 高12位
+}
+
+void ad5932_set_start_frequency(uint32_t start_frequency_hz) {
+  uint16_t low, high;
+  start_frequency_words(start_frequency_hz, &low, &high);
 
-  usleep(10000);
+  // 先写低12位，再写高12位
+  uint16_t words[2] = { low, high };
+  ad5932_write_words(words, 2);
+
+  settle_after(&dds_settle, timing.write_settle_ns);
 }
 
 
@@ -134,7 +190,7 @@ void ad5932_set_start_frequency(uint32_t start_frequency_hz) {
  * @param delta_freq 频率递增值，单位为Hz。
  * @param positive   递增方向，true表示正增量，false表示负增量。
  */
-void ad5932_set_delta_frequency(uint32_t delta_freq, bool positive) {
+static void delta_frequency_words(uint32_t delta_freq, bool positive, uint16_t *low, uint16_t *high) {
   uint32_t delta_word;
   uint16_t delta_low12, delta_high11;
 
@@ -149,12 +205,19 @@ void ad5932_set_delta_frequency(uint32_t delta_freq, bool positive) {
     delta_high11 |= (1 << 11); // 设置D11为1，表示负增量
   }
 
-  // 写入低12位
-  ad5932_write(AD5932_REG_DELTA_FREQ_L | delta_low12);
-  // 写入高11位
-  ad5932_write(AD5932_REG_DELTA_FREQ_H | delta_high11);
+  *low = AD5932_REG_DELTA_FREQ_L | delta_low12;
+  *high = AD5932_REG_DELTA_FREQ_H | delta_high11;
+}
 
-  usleep(10000);
+void ad5932_set_delta_frequency(uint32_t delta_freq, bool positive) {
+  uint16_t low, high;
+  delta_frequency_words(delta_freq, positive, &low, &high);
+
+  // 先写低12位，再写高11位
+  uint16_t words[2] = { low, high };
+  ad5932_write_words(words, 2);
+
+  settle_after(&dds_settle, timing.write_settle_ns);
 }
 
 
@@ -166,16 +229,20 @@ void ad5932_set_delta_frequency(uint32_t delta_freq, bool positive) {
  *
  * @param frequency_increments 递增次数，范围2~4095。
  */
-void ad5932_set_number_of_increments(uint16_t frequency_increments) {
+static uint16_t number_of_increments_word(uint16_t frequency_increments) {
   // 确保递增次数在有效范围内
   if (frequency_increments < 2) {
     frequency_increments = 2;
   } else if (frequency_increments > 4095) {
     frequency_increments = 4095;
   }
+  return AD5932_REG_NUM_INCR | (frequency_increments & 0x0FFF);
+}
+
+void ad5932_set_number_of_increments(uint16_t frequency_increments) {
   // 写入递增次数寄存器
-  ad5932_write(AD5932_REG_NUM_INCR | (frequency_increments & 0x0FFF));
-  usleep(10000);
+  ad5932_write(number_of_increments_word(frequency_increments));
+  settle_after(&dds_settle, timing.write_settle_ns);
 }
 
 
@@ -192,7 +259,7 @@ void ad5932_set_number_of_increments(uint16_t frequency_increments) {
  * @param mclk_mult   当mode为1时的乘数选择，0=1x, 1=5x, 2=100x, 3=500x。(这里暂时不考虑 mode 是否为1)//TODO
  * @param interval    递增间隔值，范围0~2047。
  */
-void ad5932_set_increment_interval(int mode, int mclk_mult, uint16_t interval) {
+static uint16_t increment_interval_word(int mode, int mclk_mult, uint16_t interval) {
   uint16_t reg_value = AD5932_REG_INCR_INTVL;
   
   // 确保在有效范围内
@@ -212,8 +279,68 @@ void ad5932_set_increment_interval(int mode, int mclk_mult, uint16_t interval) {
   // 设置模式(位13)
   reg_value |= ((mode & 0x01) << 13);
 
-  ad5932_write(reg_value);
-  usleep(10000);
+  return reg_value;
+}
+
+void ad5932_set_increment_interval(int mode, int mclk_mult, uint16_t interval) {
+  ad5932_write(increment_interval_word(mode, mclk_mult, interval));
+  settle_after(&dds_settle, timing.write_settle_ns);
+}
+
+
+/**
+ * @brief 生成一次扫频的寄存器映像（不访问硬件）
+ * @details 各寄存器字与对应的 ad5932_set_* 写入的完全相同。
+ */
+void ad5932_build_image(ad5932_image_t *img, uint32_t start_frequency_hz, uint32_t delta_freq,
+                        bool positive, uint16_t frequency_increments, int mode, int mclk_mult,
+                        uint16_t interval, int wave_type) {
+  start_frequency_words(start_frequency_hz, &img->words[AD5932_IMG_FSTART_L],
+                        &img->words[AD5932_IMG_FSTART_H]);
+  delta_frequency_words(delta_freq, positive, &img->words[AD5932_IMG_DELTA_L],
+                        &img->words[AD5932_IMG_DELTA_H]);
+  img->words[AD5932_IMG_NUM_INCR] = number_of_increments_word(frequency_increments);
+  img->words[AD5932_IMG_INCR_INTVL] = increment_interval_word(mode, mclk_mult, interval);
+  img->words[AD5932_IMG_CONTROL] = waveform_word(wave_type);
+}
+
+/**
+ * @brief 写入寄存器映像中与上次写入不同的字
+ * @details B24 模式下频率字的高低两半必须成对连续写入，任一半不同就两半都写。
+ *          要写的字放在一次 SPI 传输中发出，只登记一次生效时间，ad5932_start_sweep 触发前统一等待；
+ *          逐条等待的时序（serialize）下仍按寄存器逐个写入并等待。
+ * @param prev 芯片中当前的映像，NULL 表示未知，全部写入
+ * @return 写入的字数；SPI 写入失败返回-1，此时芯片中的映像未知
+ */
+int ad5932_apply_image(const ad5932_image_t *img, const ad5932_image_t *prev) {
+  uint16_t words[AD5932_IMG_COUNT];
+  int written = 0;
+  for (int i = 0; i < AD5932_IMG_COUNT; i++) {
+    bool pair_low = i == AD5932_IMG_FSTART_L || i == AD5932_IMG_DELTA_L;
+    bool changed = !prev || img->words[i] != prev->words[i] ||
+                   (pair_low && img->words[i + 1] != prev->words[i + 1]);
+    if (!changed)
+      continue;
+    int n = pair_low ? 2 : 1;
+    if (timing.serialize) {
+      if (ad5932_write_words(&img->words[i], n) < 0)
+        return -1;
+      settle_after(&dds_settle, timing.write_settle_ns);
+    } else {
+      words[written] = img->words[i];
+      if (pair_low)
+        words[written + 1] = img->words[i + 1];
+    }
+    written += n;
+    i += n - 1;
+  }
+
+  if (!timing.serialize && written > 0) {
+    if (ad5932_write_words(words, written) < 0)
+      return -1;
+    settle_after(&dds_settle, timing.write_settle_ns);
+  }
+  return written;
 }
 
 
@@ -247,11 +374,19 @@ bool ad5932_is_sweep_done(void) {
  * @note FPGA 寄存器地址 0x10 对应 CTRL 引脚
  */
 void ad5932_start_sweep(void) {
+  // 最小脉宽不超过一条 I2C 写消息的时长时，拉低与拉高在同一次传输中完成
+  if (!timing.serialize && timing.ctrl_pulse_ns <= FPGA_I2C_WRITE_MIN_NS) {
+    settle_wait(&dds_settle);
+    fpga_pulse_dds_ctrl();
+    return;
+  }
+
   // 拉低 CTRL
   fpga_set_dds_ctrl_pulse(false);
 
-  // 确保 CTRL 有足够脉宽 (~1us-10us)
-  usleep(10000); // 10ms 延迟
+  // CTRL 低电平保持最小脉宽，且之前写入的寄存器都已生效后才拉高触发
+  settle_after(&dds_settle, timing.ctrl_pulse_ns);
+  settle_wait(&dds_settle);
 
   // 拉高 CTRL
   fpga_set_dds_ctrl_pulse(true);
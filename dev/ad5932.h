@@ -7,6 +7,10 @@
 // AD5932 主时钟频率 (根据实际硬件配置)
 #define MCLK_FREQUENCY 50000000.0 // 50 MHz
 
+// SPI 时钟：默认 1 MHz，数据手册 SCLK 周期最小 25 ns
+#define AD5932_SPI_DEFAULT_HZ  1000000
+#define AD5932_SPI_MAX_HZ      40000000
+
 // =============================================================================
 // AD5932 寄存器地址定义
 // =============================================================================
@@ -65,6 +69,42 @@
 #define AD5932_CTRL_BASE   (AD5932_CTRL_RSVD7 | AD5932_CTRL_RSVD6 | \
               AD5932_CTRL_RSVD4 | AD5932_CTRL_RSVD1 | AD5932_CTRL_RSVD0)
 
+/* 软复位写入的控制字：关闭 DAC 与 SYNCOUT，只保留 24 位频率模式 */
+#define AD5932_RESET_WORD  (AD5932_REG_CONTROL | AD5932_CTRL_BASE | AD5932_CTRL_B24)
+
+// =============================================================================
+// 时序参数：写入只登记生效时刻，ad5932_start_sweep 触发前才等待
+// =============================================================================
+typedef struct {
+  uint32_t write_settle_ns;   // 寄存器字写入后到生效
+  uint32_t ctrl_pulse_ns;     // CTRL 低电平最小宽度
+  bool serialize;             // 每次写入后立即等待，不合并
+} ad5932_timing_t;
+
+/* 数据手册：数据在第 16 个 SCLK 下降沿锁存，再经数个 MCLK 周期同步生效（50 MHz 下百纳秒级）；
+ * CTRL 只需保持数个 MCLK 周期。两者各取 1 us，已含余量 */
+#define AD5932_TIMING_DATASHEET { .write_settle_ns = 1000, .ctrl_pulse_ns = 1000, .serialize = false }
+/* 原来的固定延时：每次设置后等 10 ms，CTRL 低电平 10 ms，用于对比 */
+#define AD5932_TIMING_LEGACY { .write_settle_ns = 10000000, .ctrl_pulse_ns = 10000000, .serialize = true }
+
+// =============================================================================
+// 寄存器映像：一次扫频需要写入的全部寄存器字，下标即写入顺序（控制字最后写）
+// =============================================================================
+typedef enum {
+  AD5932_IMG_FSTART_L = 0,
+  AD5932_IMG_FSTART_H,
+  AD5932_IMG_DELTA_L,
+  AD5932_IMG_DELTA_H,
+  AD5932_IMG_NUM_INCR,
+  AD5932_IMG_INCR_INTVL,
+  AD5932_IMG_CONTROL,
+  AD5932_IMG_COUNT
+} ad5932_image_index_t;
+
+typedef struct {
+  uint16_t words[AD5932_IMG_COUNT];
+} ad5932_image_t;
+
 
 /**
  * @brief 将16位数据写入AD5932寄存器。
@@ -72,10 +112,42 @@
  */
 void ad5932_write(uint16_t data);
 
+/**
+ * @brief 选择时序参数
+ * @param timing NULL 表示 AD5932_TIMING_DATASHEET
+ */
+void ad5932_set_timing(const ad5932_timing_t *timing);
+
+/**
+ * @brief 累计等待寄存器生效的时间（纳秒）
+ */
+uint64_t ad5932_settle_waited_ns(void);
+
+/**
+ * @brief 设置AD5932的SPI时钟频率
+ * @param speed_hz 0 表示 AD5932_SPI_DEFAULT_HZ，超过 AD5932_SPI_MAX_HZ 时取上限
+ */
+void ad5932_set_spi_speed(uint32_t speed_hz);
+
+/**
+ * @brief 在一次 SPI 传输中连续写入多个16位字，每个字之后释放片选。
+ * @param words 要写入的字
+ * @param count 字数，不超过 SPI_HAL_MAX_BATCH
+ * @return 成功返回0，失败返回-1
+ */
+int ad5932_write_words(const uint16_t *words, int count);
+
 /**
  * @brief 初始化AD5932驱动
+ * @details SPI 设备已打开时不会重复打开。
+ * @return 成功返回0，失败返回-1
+ */
+int ad5932_init(void);
+
+/**
+ * @brief 关闭AD5932驱动
  */
-void ad5932_init(void);
+void ad5932_close(void);
 
 
 /**
@@ -130,6 +202,22 @@ void ad5932_set_number_of_increments(uint16_t frequency_increments);
  */
 void ad5932_set_increment_interval(int mode, int mclk_mult, uint16_t interval);
 
+/**
+ * @brief 生成一次扫频的寄存器映像（不访问硬件）
+ * @details 参数含义与 ad5932_set_* 相同，映像中的字与逐个调用它们写入的字一致。
+ */
+void ad5932_build_image(ad5932_image_t *img, uint32_t start_frequency_hz, uint32_t delta_freq,
+                        bool positive, uint16_t frequency_increments, int mode, int mclk_mult,
+                        uint16_t interval, int wave_type);
+
+/**
+ * @brief 只写入与芯片当前映像不同的寄存器字
+ * @param img  要写入的映像
+ * @param prev 芯片中当前的映像，NULL 表示未知，全部写入
+ * @return 写入的字数；SPI 写入失败返回-1，此时芯片中的映像未知
+ */
+int ad5932_apply_image(const ad5932_image_t *img, const ad5932_image_t *prev);
+
 
 // ========== 与引脚相关的操作 ==========
 /**
@@ -2,6 +2,7 @@
 #include "../protocol/i2c_hal.h"
 #include "../utils/log.h"
 #include "../dev/fpga.h"
+#include "../utils/settle.h"
 #include <unistd.h>
 #include <stdio.h>
 #include <math.h>
@@ -14,32 +15,69 @@ static const float slew_times[] = {
 // 代码步长表
 static const uint16_t code_steps[] = {1, 2, 3, 4, 6, 8, 16, 32};
 
+// FPGA 触发增益波形后保持 GPIO 的时间：0.5ms，适用于产生1ms - 2.5ms左右的锯齿波
+#define DAC_GPIO_TRIGGER_NS 500000
+
+static dac63001_timing_t timing = DAC63001_TIMING_DATASHEET;
+
+// 已写入的配置何时生效；打开采集前等待
+static settle_t dac_settle;
+
+// 最近写入 FUNC-CONFIG 的 slew rate，未知时按最慢的一档估计停止时间
+static dac63001_slew_rate_t current_slew = DAC63001_SLEW_5128US;
+
+void dac63001_set_timing(const dac63001_timing_t *t) {
+  dac63001_timing_t datasheet = DAC63001_TIMING_DATASHEET;
+  timing = t ? *t : datasheet;
+  dac_settle.serialize = timing.serialize;
+}
+
+void dac63001_wait_settled(void) {
+  settle_wait(&dac_settle);
+}
+
+uint64_t dac63001_settle_waited_ns(void) {
+  return dac_settle.waited_ns;
+}
+
+// 停止函数生成后，等当前这一步走完再改写波形相关寄存器
+static void wait_waveform_stopped(void) {
+  uint64_t ns = timing.stop_settle_ns;
+  if (ns == 0)
+    ns = (uint64_t)(slew_times[current_slew] * 1000.0f) + timing.vout_settle_ns;
+  settle_after(&dac_settle, ns);
+  settle_wait(&dac_settle);
+}
+
 void dac63001_init(const char* i2c_bus) {
   i2c_hal_init(i2c_bus);
 }
 
 int dac63001_setup_external_ref(void) {
-  int ret;
-  uint16_t verify;
+  uint16_t verify[2];
+  i2c_hal_batch_t batch;
 
   LOG_INFO("配置 DAC63001 外部参考电压模式。外部参考电压为 %f V\n", DAC63001_EXT_REF_VOLTAGE);
 
+  // 两个配置寄存器的写入与验证在一次 I2C 传输中完成
+  i2c_hal_batch_init(&batch);
+
   // 1. COMMON-CONFIG 配置
   uint16_t common_config = 0x0207; // 0000 0010 0000 0111
-  ret = i2c_hal_write_reg16(DAC63001_I2C_ADDR, COMMON_CONFIG_REG, common_config);
-  if (ret < 0) return ret;
+  i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, COMMON_CONFIG_REG, common_config);
 
   // 验证写入
-  if (i2c_hal_read_reg16(DAC63001_I2C_ADDR, COMMON_CONFIG_REG, &verify) < 0) return -1;
+  i2c_hal_batch_read_reg16(&batch, DAC63001_I2C_ADDR, COMMON_CONFIG_REG, &verify[0]);
 
   // 2. DAC-0-VOUT-CMP-CONFIG 配置
   uint16_t vout_config = 0x0000;
-  ret = i2c_hal_write_reg16(DAC63001_I2C_ADDR, DAC_0_VOUT_CMP_CONFIG, vout_config);
-  if (ret < 0) return ret;
+  i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_VOUT_CMP_CONFIG, vout_config);
+  i2c_hal_batch_read_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_VOUT_CMP_CONFIG, &verify[1]);
 
-  if (i2c_hal_read_reg16(DAC63001_I2C_ADDR, DAC_0_VOUT_CMP_CONFIG, &verify) < 0) return -1;
+  if (i2c_hal_batch_submit(&batch) < 0) return -1;
 
-  usleep(50000); // 等待配置稳定
+  // 通道上电、切换参考后输出才可用
+  settle_after(&dac_settle, timing.ref_settle_ns);
   return 0;
 }
 
@@ -64,20 +102,42 @@ int dac63001_set_fixed_voltage(float voltage) {
   // 停止任何可能正在运行的波形生成
   ret = dac63001_stop_waveform();
   if (ret < 0) return ret;
-  
-  usleep(100000);
+  wait_waveform_stopped();
 
-  // 计算DAC代码并设置
+  // 计算DAC代码并设置，写入与验证在一次 I2C 传输中完成
   uint16_t dac_code = voltage_to_dac_code(voltage, DAC63001_EXT_REF_VOLTAGE);
-  ret = i2c_hal_write_reg16(DAC63001_I2C_ADDR, DAC_0_DATA_REG, dac_code);
-  if (ret < 0) return ret;
-
-  // 验证写入
-  if (i2c_hal_read_reg16(DAC63001_I2C_ADDR, DAC_0_DATA_REG, &verify) < 0) return -1;
+  i2c_hal_batch_t batch;
+  i2c_hal_batch_init(&batch);
+  i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_DATA_REG, dac_code);
+  i2c_hal_batch_read_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_DATA_REG, &verify);
+  if (i2c_hal_batch_submit(&batch) < 0) return -1;
+  settle_after(&dac_settle, timing.vout_settle_ns);
 
   return 0;
 }
 
+// 反向锯齿波的 MARGIN_HIGH / MARGIN_LOW / FUNC_CONFIG 寄存器值
+static void sawtooth_regs(float min_voltage, float max_voltage,
+                          dac63001_code_step_t code_step, dac63001_slew_rate_t slew_rate,
+                          uint16_t *margin_high, uint16_t *margin_low, uint16_t *func_config) {
+  *margin_high = voltage_to_dac_code(max_voltage, DAC63001_EXT_REF_VOLTAGE);
+  *margin_low = voltage_to_dac_code(min_voltage, DAC63001_EXT_REF_VOLTAGE);
+
+  // DAC-0-FUNC-CONFIG 位域说明:
+  // bit15: CLR-SEL-0 = 0 (清零到零刻度)
+  // bit14: SYNC-CONFIG-0 = 0 (立即更新)
+  // bit13: BRD-CONFIG-0 = 0 (不响应广播)
+  // bit12-11: PHASE-SEL-0 = 00 (0°相位)
+  // bit10-8: FUNC-CONFIG-0 = 010 (反向锯齿波)
+  // bit7: LOG-SLEW-EN-0 = 0 (线性slew)
+  // bit6-4: CODE-STEP-0 = code_step (代码步长)
+  // bit3-0: SLEW-RATE-0 = slew_rate (slew速率)
+  *func_config = 0x0000;
+  *func_config |= (0x2 << 8);       // FUNC-CONFIG-0 = 010 (反向锯齿波)
+  *func_config |= (code_step << 4); // CODE-STEP-0
+  *func_config |= slew_rate;        // SLEW-RATE-0
+}
+
 int dac63001_setup_sawtooth_wave(float min_voltage, float max_voltage, 
                 dac63001_code_step_t code_step, 
                 dac63001_slew_rate_t slew_rate) {
@@ -90,39 +150,24 @@ int dac63001_setup_sawtooth_wave(float min_voltage, float max_voltage,
   // 停止函数生成
   ret = dac63001_stop_waveform();
   if (ret < 0) return ret;
-  
-  usleep(100000);
+  wait_waveform_stopped();
 
   // 计算DAC代码
-  uint16_t margin_high_code = voltage_to_dac_code(max_voltage, DAC63001_EXT_REF_VOLTAGE);
-  uint16_t margin_low_code = voltage_to_dac_code(min_voltage, DAC63001_EXT_REF_VOLTAGE);
+  uint16_t margin_high_code, margin_low_code, func_config;
+  sawtooth_regs(min_voltage, max_voltage, code_step, slew_rate,
+                &margin_high_code, &margin_low_code, &func_config);
   LOG_INFO("MARGIN_HIGH 代码: 0x%04X\n", margin_high_code);
   LOG_INFO("MARGIN_LOW 代码: 0x%04X\n", margin_low_code);
   
-  // 设置MARGIN_HIGH寄存器
-  ret = i2c_hal_write_reg16(DAC63001_I2C_ADDR, DAC_0_MARGIN_HIGH, margin_high_code);
-  if (ret < 0) return ret;
-  
-  // 设置MARGIN_LOW寄存器 
-  ret = i2c_hal_write_reg16(DAC63001_I2C_ADDR, DAC_0_MARGIN_LOW, margin_low_code);
-  if (ret < 0) return ret;
-  
-  // 配置DAC-0-FUNC-CONFIG寄存器
-  // 位域说明:
-  // bit15: CLR-SEL-0 = 0 (清零到零刻度)
-  // bit14: SYNC-CONFIG-0 = 0 (立即更新)
-  // bit13: BRD-CONFIG-0 = 0 (不响应广播)
-  // bit12-11: PHASE-SEL-0 = 00 (0°相位)
-  // bit10-8: FUNC-CONFIG-0 = 010 (反向锯齿波)
-  // bit7: LOG-SLEW-EN-0 = 0 (线性slew)
-  // bit6-4: CODE-STEP-0 = code_step (代码步长)
-  // bit3-0: SLEW-RATE-0 = slew_rate (slew速率)
-  uint16_t func_config = 0x0000;
-  func_config |= (0x2 << 8);       // FUNC-CONFIG-0 = 010 (反向锯齿波)
-  func_config |= (code_step << 4); // CODE-STEP-0
-  func_config |= slew_rate;        // SLEW-RATE-0
-  
-  ret = i2c_hal_write_reg16(DAC63001_I2C_ADDR, DAC_0_FUNC_CONFIG, func_config);
+  // MARGIN_HIGH、MARGIN_LOW、DAC-0-FUNC-CONFIG 在一次 I2C 传输中写入
+  i2c_hal_batch_t batch;
+  i2c_hal_batch_init(&batch);
+  i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_MARGIN_HIGH, margin_high_code);
+  i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_MARGIN_LOW, margin_low_code);
+  int func_op = i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_FUNC_CONFIG, func_config);
+  ret = i2c_hal_batch_submit(&batch);
+  if (i2c_hal_batch_status(&batch, func_op) == 0)
+    current_slew = slew_rate;
   if (ret < 0) return ret;
   
   // 计算预期频率
@@ -158,11 +203,17 @@ int dac63001_stop_waveform(void) {
 int dac63001_enable_gpio_start_stop_trigger(void) {
   LOG_INFO("启用GPIO引脚触发DAC函数开始/停止\n");
 
+  // FPGA 使能、定时器与使能回读在一次 I2C 传输中完成
   LOG_INFO("开启FPGA上的GPIO控制功能\n"); 
-  fpga_set_dac_ctrl_en(true);
-  fpga_set_dac_duration_timer_ns(12500); // 持续0.5ms，适用于产生1ms - 2.5ms左右的锯齿波
-  
-  if (!fpga_is_dac_ctrl_en()) {
+  uint32_t ctrl_en = 0;
+  i2c_hal_batch_t batch;
+  i2c_hal_batch_init(&batch);
+  fpga_batch_write(&batch, REG_DAC_CTRL_EN, 0x0001);
+  LOG_INFO("配置DAC触发波形生成后，等待 %d ns后停止\n", DAC_GPIO_TRIGGER_NS);
+  fpga_batch_write(&batch, REG_DAC_TIMER, DAC_GPIO_TRIGGER_NS / FPGA_DAC_TIMER_TICK_NS);
+  fpga_batch_read(&batch, REG_DAC_CTRL_EN, &ctrl_en);
+  
+  if (i2c_hal_batch_submit(&batch) < 0 || (ctrl_en & 0x1) == 0) {
     LOG_ERROR("GPIO控制功能FPGA启动失败！\n");
     return -1;
   }
@@ -375,8 +426,10 @@ void calculate_sweep_parameters(uint32_t target_duration_us, float voltage_range
 
 
 
-// 设置增益扫描（使用具体电阻值）
-int dac63001_set_gain_sweep(uint16_t start_gain, uint16_t end_gain, uint32_t gain_duration_us) {
+// 校验增益扫描参数并计算锯齿波的电压范围、代码步长和 slew rate
+static int gain_sweep_params(uint16_t start_gain, uint16_t end_gain, uint32_t gain_duration_us,
+                             float *min_voltage, float *max_voltage,
+                             dac63001_code_step_t *code_step, dac63001_slew_rate_t *slew_rate) {
   if (start_gain >= end_gain) {
     LOG_ERROR("起始增益要小于结束增益\n");
     return -1;
@@ -387,8 +440,6 @@ int dac63001_set_gain_sweep(uint16_t start_gain, uint16_t end_gain, uint32_t gai
     return -1;
   }
 
-  int ret;
-  
   LOG_INFO("设置增益扫描: %ddB -> %ddB, 持续时间: %uus\n", 
        start_gain, end_gain, gain_duration_us);
   
@@ -414,23 +465,90 @@ int dac63001_set_gain_sweep(uint16_t start_gain, uint16_t end_gain, uint32_t gai
   
   // 计算扫描参数
   float voltage_range = fabsf(end_voltage - start_voltage);
-  dac63001_code_step_t code_step;
-  dac63001_slew_rate_t slew_rate;
-  calculate_sweep_parameters(gain_duration_us, voltage_range, &code_step, &slew_rate);
+  calculate_sweep_parameters(gain_duration_us, voltage_range, code_step, slew_rate);
   
-  float min_voltage, max_voltage;
-
   // 增益增加：电压从高到低
-  max_voltage = start_voltage;  // 起始电压（高电压，低增益）
-  min_voltage = end_voltage;    // 结束电压（低电压，高增益）
-  LOG_INFO("增益增加模式: 电压从 %.3fV -> %.3fV\n", max_voltage, min_voltage);
+  *max_voltage = start_voltage;  // 起始电压（高电压，低增益）
+  *min_voltage = end_voltage;    // 结束电压（低电压，高增益）
+  LOG_INFO("增益增加模式: 电压从 %.3fV -> %.3fV\n", *max_voltage, *min_voltage);
+  return 0;
+}
+
+// 设置增益扫描（使用具体电阻值）
+int dac63001_set_gain_sweep(uint16_t start_gain, uint16_t end_gain, uint32_t gain_duration_us) {
+  float min_voltage, max_voltage;
+  dac63001_code_step_t code_step;
+  dac63001_slew_rate_t slew_rate;
+  if (gain_sweep_params(start_gain, end_gain, gain_duration_us, &min_voltage, &max_voltage,
+                        &code_step, &slew_rate) < 0)
+    return -1;
   
   // 配置锯齿波（反向锯齿波从MARGIN_HIGH到MARGIN_LOW）
-  ret = dac63001_setup_sawtooth_wave(min_voltage, max_voltage, code_step, slew_rate);
+  int ret = dac63001_setup_sawtooth_wave(min_voltage, max_voltage, code_step, slew_rate);
   if (ret < 0) {
     LOG_ERROR("锯齿波配置失败\n");
     return ret;
   }
   
   return 0;
+}
+
+int dac63001_build_gain_sweep_image(uint16_t start_gain, uint16_t end_gain, uint32_t gain_duration_us,
+                                    dac63001_gain_image_t *img) {
+  float min_voltage, max_voltage;
+  dac63001_code_step_t code_step;
+  dac63001_slew_rate_t slew_rate;
+  if (gain_sweep_params(start_gain, end_gain, gain_duration_us, &min_voltage, &max_voltage,
+                        &code_step, &slew_rate) < 0)
+    return -1;
+
+  img->sweep = true;
+  img->data = 0;
+  sawtooth_regs(min_voltage, max_voltage, code_step, slew_rate,
+                &img->margin_high, &img->margin_low, &img->func_config);
+  return 0;
+}
+
+void dac63001_build_fixed_image(float voltage, dac63001_gain_image_t *img) {
+  img->sweep = false;
+  img->data = voltage_to_dac_code(voltage, DAC63001_EXT_REF_VOLTAGE);
+  img->margin_high = 0;
+  img->margin_low = 0;
+  img->func_config = 0;
+}
+
+int dac63001_apply_gain_image(const dac63001_gain_image_t *img, const dac63001_gain_image_t *prev) {
+  // 与当前模式不同或映像未知时，所有相关寄存器都要写
+  bool all = !prev || prev->sweep != img->sweep;
+  bool data = !img->sweep && (all || img->data != prev->data);
+  bool high = img->sweep && (all || img->margin_high != prev->margin_high);
+  bool low = img->sweep && (all || img->margin_low != prev->margin_low);
+  bool func = img->sweep && (all || img->func_config != prev->func_config);
+  if (!data && !high && !low && !func)
+    return 0;
+
+  // 改写前先停止函数生成并等待当前一步结束，与 dac63001_set_fixed_voltage / setup_sawtooth_wave 相同
+  int ret = dac63001_stop_waveform();
+  if (ret < 0) return ret;
+  wait_waveform_stopped();
+
+  // 变化的寄存器在一次 I2C 传输中写入
+  i2c_hal_batch_t batch;
+  i2c_hal_batch_init(&batch);
+  int func_op = -1;
+  if (data)
+    i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_DATA_REG, img->data);
+  if (high)
+    i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_MARGIN_HIGH, img->margin_high);
+  if (low)
+    i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_MARGIN_LOW, img->margin_low);
+  if (func)
+    func_op = i2c_hal_batch_write_reg16(&batch, DAC63001_I2C_ADDR, DAC_0_FUNC_CONFIG, img->func_config);
+  ret = i2c_hal_batch_submit(&batch);
+  if (func_op >= 0 && i2c_hal_batch_status(&batch, func_op) == 0)
+    current_slew = (dac63001_slew_rate_t)(img->func_config & 0xF);
+  if (ret < 0) return -1;
+  if (data)
+    settle_after(&dac_settle, timing.vout_settle_ns);
+  return batch.op_count;
 }
\ No newline at end of file
@@ -61,6 +61,38 @@ typedef enum {
     DAC63001_STEP_32LSB
 } dac63001_code_step_t;
 
+// 时序参数：写入只登记生效时刻，依赖它的操作之前才等待
+typedef struct {
+  uint32_t ref_settle_ns;    // 配置外部参考、通道上电后到输出可用
+  uint32_t vout_settle_ns;   // DAC_0_DATA 改写后输出建立
+  uint32_t stop_settle_ns;   // 停止函数生成后到可以改写波形寄存器，0 = 按当前 slew 步长计算
+  bool serialize;            // 每次写入后立即等待，不合并
+} dac63001_timing_t;
+
+/* 数据手册：输出建立时间为 10 us 量级，取 20 us；通道上电为数十微秒量级，取 100 us；
+ * 函数发生器在当前一步走完后停止，最长一步为 slew 表中的 5128 us */
+#define DAC63001_TIMING_DATASHEET { .ref_settle_ns = 100000, .vout_settle_ns = 20000, \
+                                    .stop_settle_ns = 0, .serialize = false }
+/* 原来的固定延时：参考配置后 50 ms，停止波形后 100 ms，用于对比 */
+#define DAC63001_TIMING_LEGACY { .ref_settle_ns = 50000000, .vout_settle_ns = 0, \
+                                 .stop_settle_ns = 100000000, .serialize = true }
+
+/**
+ * @brief 选择时序参数
+ * @param timing NULL 表示 DAC63001_TIMING_DATASHEET
+ */
+void dac63001_set_timing(const dac63001_timing_t *timing);
+
+/**
+ * @brief 等到已写入的配置全部生效（打开采集、触发增益波形之前调用）
+ */
+void dac63001_wait_settled(void);
+
+/**
+ * @brief 累计等待配置生效的时间（纳秒）
+ */
+uint64_t dac63001_settle_waited_ns(void);
+
 /**
  * @brief 初始化DAC63001驱动
  * @param i2c_bus I2C总线设备路径
@@ -128,6 +160,36 @@ void dac63001_close(void);
  */
 int dac63001_set_gain_sweep(uint16_t start_gain, uint16_t end_gain, uint32_t gain_duration_us);
 
+// 增益控制寄存器映像：一次采集需要的 DAC63001 输出配置
+typedef struct {
+  bool sweep;              // true = 锯齿波增益扫描，false = 固定电压
+  uint16_t data;           // DAC_0_DATA（固定电压）
+  uint16_t margin_high;    // DAC_0_MARGIN_HIGH（扫描）
+  uint16_t margin_low;     // DAC_0_MARGIN_LOW（扫描）
+  uint16_t func_config;    // DAC_0_FUNC_CONFIG（扫描）
+} dac63001_gain_image_t;
+
+/**
+ * @brief 生成增益扫描的寄存器映像（不访问硬件），参数检查同 dac63001_set_gain_sweep
+ * @return 0 成功，-1 参数无效
+ */
+int dac63001_build_gain_sweep_image(uint16_t start_gain, uint16_t end_gain, uint32_t gain_duration_us,
+                                    dac63001_gain_image_t *img);
+
+/**
+ * @brief 生成固定电压的寄存器映像（不访问硬件）
+ * @param voltage 输出电压值 (0-1.25V)
+ */
+void dac63001_build_fixed_image(float voltage, dac63001_gain_image_t *img);
+
+/**
+ * @brief 只写入与芯片当前映像不同的寄存器
+ * @details 有寄存器要改写时先停止函数生成并等当前一步走完，全部相同时不访问硬件。
+ * @param prev 芯片中当前的映像，NULL 表示未知，全部写入
+ * @return 写入的寄存器数，失败返回 -1
+ */
+int dac63001_apply_gain_image(const dac63001_gain_image_t *img, const dac63001_gain_image_t *prev);
+
 /**
  * @brief 增益值转换为电压值（使用具体电阻值）
  * @param gain_dB 增益值 (dB)
@@ -145,20 +145,12 @@ void fpga_release_soft_reset(void) {
 
 
 /**
- * @brief 初始化并写入UDP/IP/ETH头部到FPGA寄存器
- * @details 根据提供的参数构建UDP/IP/以太网帧头，计算IP校验和，并将整个头部数据以4字节为单位写入FPGA的指定寄存器区域。
- * @param  指向UDP头部配置参数结构体的指针。
- * @return 0表示成功，-1表示失败。
+ * @brief 按参数构建 FPGA 发出的 ETH/IP/UDP 帧头模板
+ * @details fpga_initialize_udp_header 与 fpga_build_udp_header 共用，保证写入 FPGA 的模板
+ *          与上位机校验用的模板完全一致。
  */
-int fpga_initialize_udp_header(S_udp_header_params *params) {
-  LOG_INFO("Initializing FPGA UDP header...\n");
-  if (params == NULL) {
-    LOG_ERROR("Input parameters pointer is NULL.\n");
-    return -1;
-  }
-
-  U_pkg_hdr pkg_hdr;
-  memset(&pkg_hdr, 0, sizeof(U_pkg_hdr));
+static void build_pkg_hdr(const S_udp_header_params *params, U_pkg_hdr *hdr) {
+  memset(hdr, 0, sizeof(U_pkg_hdr));
 
   // --- 1. 填充MAC地址 (处理字节序并拼接) ---
   
@@ -168,54 +160,83 @@ int fpga_initialize_udp_header(S_udp_header_params *params) {
   uint32_t tmp_dst_l = htonl(params->dst_mac_low);
 
   // 低4字节 (MAC[2]到MAC[5])
-  memcpy(pkg_hdr.eth.dst_mac + 2, (unsigned char*)&tmp_dst_l, 4);
+  memcpy(hdr->eth.dst_mac + 2, (unsigned char*)&tmp_dst_l, 4);
   // 高2字节 (MAC[0]到MAC[1])
-  memcpy(pkg_hdr.eth.dst_mac, (unsigned char*)&tmp_dst_h, 2);
+  memcpy(hdr->eth.dst_mac, (unsigned char*)&tmp_dst_h, 2);
 
   // 源MAC地址 (Src MAC)
   uint16_t tmp_src_h = htons(params->src_mac_high);
   uint32_t tmp_src_l = htonl(params->src_mac_low);
   
   // 低4字节
-  memcpy(pkg_hdr.eth.src_mac + 2, (unsigned char*)&tmp_src_l, 4);
+  memcpy(hdr->eth.src_mac + 2, (unsigned char*)&tmp_src_l, 4);
   // 高2字节
-  memcpy(pkg_hdr.eth.src_mac, (unsigned char*)&tmp_src_h, 2);
-
-  LOG_INFO("Configured MAC addresses - DST: %02X:%02X:%02X:%02X:%02X:%02X, SRC: %02X:%02X:%02X:%02X:%02X:%02X\n",
-           pkg_hdr.eth.dst_mac[0], pkg_hdr.eth.dst_mac[1], pkg_hdr.eth.dst_mac[2],
-           pkg_hdr.eth.dst_mac[3], pkg_hdr.eth.dst_mac[4], pkg_hdr.eth.dst_mac[5],
-           pkg_hdr.eth.src_mac[0], pkg_hdr.eth.src_mac[1], pkg_hdr.eth.src_mac[2],
-           pkg_hdr.eth.src_mac[3], pkg_hdr.eth.src_mac[4], pkg_hdr.eth.src_mac[5]);
+  memcpy(hdr->eth.src_mac, (unsigned char*)&tmp_src_h, 2);
 
 
   // --- 2. 填充以太网头部 (Ethernet Header) ---
-  pkg_hdr.eth.eth_type = htons((uint16_t)0x0800); // 0x0800 for IPV4
+  hdr->eth.eth_type = htons((uint16_t)0x0800); // 0x0800 for IPV4
 
 
   // --- 3. 填充IP头部 (IP Header) ---
-  pkg_hdr.ip.ver_hl    = 0x45; // Version 4, Header Length 5 (20 bytes)
-  pkg_hdr.ip.serv_type = 0;
-  pkg_hdr.ip.pkt_len   = htons((uint16_t)0x041c); // 固定总长度 (IP头+UDP头+数据)
-  pkg_hdr.ip.re_mark   = 0;
-  pkg_hdr.ip.flag_seg  = 0;
-  pkg_hdr.ip.surv_tm   = 0x80; // TTL
-  pkg_hdr.ip.protocol  = 0x11; // 0x11 for UDP
-  pkg_hdr.ip.h_check   = 0; // 校验和先清零，再计算
+  hdr->ip.ver_hl    = 0x45; // Version 4, Header Length 5 (20 bytes)
+  hdr->ip.serv_type = 0;
+  hdr->ip.pkt_len   = htons((uint16_t)0x041c); // 固定总长度 (IP头+UDP头+数据)
+  hdr->ip.re_mark   = 0;
+  hdr->ip.flag_seg  = 0;
+  hdr->ip.surv_tm   = 0x80; // TTL
+  hdr->ip.protocol  = 0x11; // 0x11 for UDP
+  hdr->ip.h_check   = 0; // 校验和先清零，再计算
   
   // 源IP：使用传入参数并转换为网络字节序
-  pkg_hdr.ip.src_ip = htonl(params->src_ip);
-  pkg_hdr.ip.dst_ip = htonl(params->dst_ip); 
+  hdr->ip.src_ip = htonl(params->src_ip);
+  hdr->ip.dst_ip = htonl(params->dst_ip); 
 
   // 计算IP校验和
-  ipcsum(&pkg_hdr.ip);
+  ipcsum(&hdr->ip);
 
 
   // --- 4. 填充UDP头部 (UDP Header) ---
   // 端口号：转换为网络字节序
-  pkg_hdr.udp.sport = htons(params->src_port);
-  pkg_hdr.udp.dport = htons(params->dst_port);
-  pkg_hdr.udp.pktlen = htons((uint16_t)0x408); // 固定UDP总长度 (UDP头+数据)
-  pkg_hdr.udp.check_sum = 0; // 简化：UDP校验和设置为0
+  hdr->udp.sport = htons(params->src_port);
+  hdr->udp.dport = htons(params->dst_port);
+  hdr->udp.pktlen = htons((uint16_t)0x408); // 固定UDP总长度 (UDP头+数据)
+  hdr->udp.check_sum = 0; // 简化：UDP校验和设置为0
+}
+
+/**
+ * @brief 生成 FPGA 发出的 ETH/IP/UDP 帧头（不写寄存器）
+ * @details 供 net_listener 校验收到的帧头、剥离帧头后只缓存 UDP 负载。
+ * @param params 与 fpga_initialize_udp_header 相同的参数
+ * @param hdr    输出缓冲区，至少 FPGA_UDP_HEADER_LEN 字节
+ */
+void fpga_build_udp_header(const S_udp_header_params *params, uint8_t *hdr) {
+  U_pkg_hdr pkg_hdr;
+  build_pkg_hdr(params, &pkg_hdr);
+  memcpy(hdr, pkg_hdr.data, FPGA_UDP_HEADER_LEN);
+}
+
+/**
+ * @brief 初始化并写入UDP/IP/ETH头部到FPGA寄存器
+ * @details 根据提供的参数构建UDP/IP/以太网帧头，计算IP校验和，并将整个头部数据以4字节为单位写入FPGA的指定寄存器区域。
+ * @param  指向UDP头部配置参数结构体的指针。
+ * @return 0表示成功，-1表示失败。
+ */
+int fpga_initialize_udp_header(S_udp_header_params *params) {
+  LOG_INFO("Initializing FPGA UDP header...\n");
+  if (params == NULL) {
+    LOG_ERROR("Input parameters pointer is NULL.\n");
+    return -1;
+  }
+
+  U_pkg_hdr pkg_hdr;
+  build_pkg_hdr(params, &pkg_hdr);
+
+  LOG_INFO("Configured MAC addresses - DST: %02X:%02X:%02X:%02X:%02X:%02X, SRC: %02X:%02X:%02X:%02X:%02X:%02X\n",
+           pkg_hdr.eth.dst_mac[0], pkg_hdr.eth.dst_mac[1], pkg_hdr.eth.dst_mac[2],
+           pkg_hdr.eth.dst_mac[3], pkg_hdr.eth.dst_mac[4], pkg_hdr.eth.dst_mac[5],
+           pkg_hdr.eth.src_mac[0], pkg_hdr.eth.src_mac[1], pkg_hdr.eth.src_mac[2],
+           pkg_hdr.eth.src_mac[3], pkg_hdr.eth.src_mac[4], pkg_hdr.eth.src_mac[5]);
 
 
   // --- 5. 打印配置信息 ---
@@ -241,23 +262,47 @@ int fpga_initialize_udp_header(S_udp_header_params *params) {
 
 
   // --- 6. 写入FPGA寄存器 ---
-  LOG_INFO("Writing UDP header to FPGA registers (base address: 0x%04X)\n", REG_UDP_HDR_0);
-  
-  // 头部总长度以4字节对齐写入
+  // 头部总长度以4字节对齐写入；全部写入与回读合并成一次 I2C 传输
   size_t header_dword_count = sizeof(U_pkg_hdr) / 4;
-  LOG_INFO("Total header dwords to write: %zu\n", header_dword_count);
+  LOG_INFO("Writing %zu UDP header dwords to FPGA registers (base address: 0x%04X)\n",
+           header_dword_count, REG_UDP_HDR_0);
+  uint32_t read_back[sizeof(U_pkg_hdr) / 4] = {0};
+  i2c_hal_batch_t batch;
+  i2c_hal_batch_init(&batch);
   for(size_t i = 0; i < header_dword_count; i++) {
-    uint32_t write_data = *(uint32_t*)&pkg_hdr.data[i * 4];
-    uint32_t read_back = 0;
-    uint16_t addr = REG_UDP_HDR_0 + (uint16_t)i;
-
-    fpga_reg_write_4Bytes(FPGA_I2C_SLAVE, addr, &pkg_hdr.data[i * 4]);
-    i2c_hal_fpga_read(FPGA_I2C_SLAVE, addr, &read_back);
-    
-    LOG_INFO("index=%zu write=0x%08x readbk=0x%08x addr = 0x%02x\n", i, write_data, read_back, (REG_UDP_HDR_0 + i));
+    if (i2c_hal_batch_fpga_write_4Bytes(&batch, FPGA_I2C_SLAVE, REG_UDP_HDR_0 + (uint16_t)i,
+                                        &pkg_hdr.data[i * 4]) < 0) {
+      LOG_ERROR("UDP header write does not fit in one I2C batch\n");
+      return -1;
+    }
+  }
+  for(size_t i = 0; i < header_dword_count; i++) {
+    if (i2c_hal_batch_fpga_read(&batch, FPGA_I2C_SLAVE, REG_UDP_HDR_0 + (uint16_t)i, &read_back[i]) < 0) {
+      LOG_ERROR("UDP header readback does not fit in one I2C batch\n");
+      return -1;
+    }
+  }
+  if (i2c_hal_batch_submit(&batch) < 0) {
+    LOG_ERROR("Failed to write UDP header to FPGA (%d of %d I2C operations failed)\n",
+              batch.failed, batch.op_count);
+    return -1;
+  }
+
+  // 回读与写入不一致时逐个打印
+  int mismatches = 0;
+  for(size_t i = 0; i < header_dword_count; i++) {
+    uint32_t write_data;
+    memcpy(&write_data, &pkg_hdr.data[i * 4], sizeof(write_data));
+    write_data = ntohl(write_data);
+    if (read_back[i] != write_data) {
+      LOG_WARN("index=%zu write=0x%08x readbk=0x%08x addr = 0x%02zx\n", i, write_data, read_back[i],
+               (REG_UDP_HDR_0 + i));
+      mismatches++;
+    }
   }
   
-  LOG_INFO("FPGA UDP header initialization completed successfully\n");
+  LOG_INFO("FPGA UDP header initialization completed (%d I2C transfer(s), %d readback mismatch(es))\n",
+           batch.transfers, mismatches);
   return 0;
 }
 
@@ -282,6 +327,27 @@ void fpga_set_dds_ctrl_pulse(bool enable) {
   }
 }
 
+int fpga_pulse_dds_ctrl(void) {
+  i2c_hal_batch_t batch;
+  i2c_hal_batch_init(&batch);
+  i2c_hal_batch_fpga_write(&batch, FPGA_I2C_SLAVE, REG_DDS_CTRL, 0x0000);
+  i2c_hal_batch_fpga_write(&batch, FPGA_I2C_SLAVE, REG_DDS_CTRL, 0x0001);
+  if (i2c_hal_batch_submit(&batch) < 0) {
+    LOG_ERROR("Failed to pulse DDS control line.\n");
+    return -1;
+  }
+  LOG_DEBUG("FPGA DDS control pulse: TRIGGERED\n");
+  return 0;
+}
+
+int fpga_batch_write(i2c_hal_batch_t *batch, fpga_reg_addr_t reg, uint32_t val) {
+  return i2c_hal_batch_fpga_write(batch, FPGA_I2C_SLAVE, reg, val);
+}
+
+int fpga_batch_read(i2c_hal_batch_t *batch, fpga_reg_addr_t reg, uint32_t *val) {
+  return i2c_hal_batch_fpga_read(batch, FPGA_I2C_SLAVE, reg, val);
+}
+
 void fpga_set_dds_standby(bool enable) {
   uint16_t val = enable ? 0x0001 : 0x0000;
   LOG_INFO("FPGA set DDS standby: %s\n", enable ? "ENABLED" : "DISABLED");
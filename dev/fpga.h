@@ -2,6 +2,7 @@
 #define DEV_FPGA_H
 #include <stdint.h>
 #include <stdbool.h>
+#include "../protocol/i2c_hal.h"
 /* FPGA Register Addresses
  * 基于 RK3568 平台的 FPGA 寄存器地址定义
 */
@@ -96,11 +97,39 @@ void fpga_release_soft_reset(void);
  */
 int fpga_initialize_udp_header(S_udp_header_params *params);
 
+// FPGA 帧头长度：以太网 14 + IP 20 + UDP 8
+#define FPGA_UDP_HEADER_LEN  42
+
+// REG_DAC_TIMER 的计数单位（纳秒）
+#define FPGA_DAC_TIMER_TICK_NS 40
+
+/**
+ * @brief 生成与 fpga_initialize_udp_header 写入内容一致的帧头（不访问硬件）
+ */
+void fpga_build_udp_header(const S_udp_header_params *params, uint8_t *hdr);
+
 // DDS 控制函数声明
 bool fpga_is_dds_standby_up(void);
 void fpga_set_dds_ctrl_pulse(bool enable);
 void fpga_set_dds_standby(bool enable);
 
+// CTRL 一次写入至少占用总线数十微秒
+#define FPGA_I2C_WRITE_MIN_NS 50000
+
+/**
+ * @brief 在一次 I2C 传输中把 DDS CTRL 先拉低再拉高，触发扫频
+ * @details 低电平持续一条完整的写消息，不短于 FPGA_I2C_WRITE_MIN_NS。
+ * @return 0 成功，-1 失败
+ */
+int fpga_pulse_dds_ctrl(void);
+
+/**
+ * @brief 向批量传输中添加一次 FPGA 寄存器写入 / 读取
+ * @return 操作序号，失败返回 -1
+ */
+int fpga_batch_write(i2c_hal_batch_t *batch, fpga_reg_addr_t reg, uint32_t val);
+int fpga_batch_read(i2c_hal_batch_t *batch, fpga_reg_addr_t reg, uint32_t *val);
+
 // DAC 控制函数
 void fpga_set_dac_ctrl_en(bool enable);
 bool fpga_is_dac_ctrl_en(void);
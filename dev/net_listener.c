@@ -1,122 +1,980 @@
+#define _GNU_SOURCE // recvmmsg, pthread_setaffinity_np
 #include "net_listener.h"
+#include "net_xdp.h"
 #include "../utils/log.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
+#include <sys/mman.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <sys/ioctl.h>
 #include <netinet/ip.h>
 #include <netinet/udp.h>
 #include <net/ethernet.h>
 #include <net/if.h>
 #include <linux/if_packet.h>
+#include <linux/filter.h>
 #include <arpa/inet.h>
 
-static volatile int running = 0;
-static pthread_t listener_thread;
-static int sockfd = -1;
-static NetPacketCallback user_cb = NULL;
-static NetCacheCallback user_cache_cb = NULL;
-
-// 缓存相关变量
-static uint8_t *packet_cache = NULL;
-static uint32_t *packet_lengths = NULL;
-static uint32_t cache_size = 0;
-static uint32_t cache_used = 0;
-static uint32_t packet_count = 0;
-static uint32_t max_packets = 0;
-static uint64_t total_bytes = 0;
-static uint32_t dropped_packets = 0;
-static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
-
-// 缓存管理函数
-static int init_cache(uint32_t size) {
-  pthread_mutex_lock(&cache_mutex);
+#if defined(__x86_64__) || defined(__i386__)
+#define cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define cpu_relax() __asm__ __volatile__("yield" ::: "memory")
+#else
+#define cpu_relax() do { } while (0)
+#endif
+
+/*
+ * seqlock：单写者写前后各递增一次 seq（奇数 = 写入中），读者拷贝前后 seq 相同且为偶数时
+ * 得到一致快照，否则重读。写者不等待读者，监控线程读取计数不会阻塞抓包线程。
+ */
+static inline void seq_write_begin(uint32_t *seq) {
+  __atomic_store_n(seq, *seq + 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void seq_write_end(uint32_t *seq) {
+  __atomic_store_n(seq, *seq + 1, __ATOMIC_RELEASE);
+}
+
+static void seq_read(const uint32_t *seq, void *dst, const void *src, size_t len) {
+  for (;;) {
+    uint32_t begin = __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+    if (begin & 1) {
+      cpu_relax();
+      continue;
+    }
+    memcpy(dst, src, len);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(seq, __ATOMIC_RELAXED) == begin)
+      return;
+  }
+}
+
+// 采集计数：运行中只由抓包线程在 seqlock 写区间内更新（停止后由控制线程更新），
+// 独占缓存行，与监听实例的其他字段不伪共享
+typedef struct {
+  uint32_t seq;                   // 必须是第一个字段，见 reset_counters
+  uint32_t packet_count;          // 同时是当前缓存的写入位置
+  uint32_t cache_used;
+  uint32_t dropped_packets;
+  uint32_t cache_full_drops;
+  uint32_t index_full_drops;
+  uint32_t header_mismatch_packets;
+  uint32_t batch_count;           // recvmmsg 批次数
+  uint64_t batch_frames;          // recvmmsg 批次内收到的总帧数
+  uint64_t total_bytes;
+
+  // 时间戳统计
+  uint32_t ts_count;
+  uint64_t ts_first;
+  uint64_t ts_last;
+  uint64_t ts_min_gap;
+  uint64_t ts_max_gap;
+  double ts_gap_sq_sum;
+
+  // 分块模式：已交出的块数及其中的包数和字节数
+  uint32_t chunk_seq;
+  uint32_t chunk_done_packets;
+  uint64_t chunk_done_bytes;
+} __attribute__((aligned(64))) capture_stats_t;
+
+// 回调分发环：每个抓包线程（单生产者）一个环，分发线程（单消费者）轮询所有环调用 user_cb，
+// 所有环都空时分发线程阻塞在 dispatch_efd 上，生产者只在它已休眠时写 eventfd 唤醒
+typedef struct {
+  uint32_t length;
+  uint8_t data[NET_BUFFER_SIZE];
+} dispatch_slot_t;
+
+typedef struct {
+  dispatch_slot_t *slots;
+  uint32_t mask;
+  uint32_t head __attribute__((aligned(64)));  // 生产者写
+  uint32_t high_water;                         // 环内最大积压帧数
+  uint32_t overflow;                           // 环满未能交给回调的帧数
+  uint32_t tail __attribute__((aligned(64)));  // 消费者写
+} dispatch_ring_t;
+
+// 分块回调的块描述
+typedef struct {
+  uint32_t seq;
+  uint32_t packet_count;
+  uint64_t bytes;
+  uint32_t stride;
+} chunk_desc_t;
+
+// PACKET_FANOUT worker（见下方 PACKET_FANOUT 多核接收）。分片计数由 worker 在 seq 写区间内
+// 更新；每个 worker 独占缓存行
+typedef struct {
+  uint32_t seq;
+  net_listener_t *l;
+  uint32_t index;
+  int sock;
+  pthread_t thread;
+  dispatch_ring_t *ring;
+  uint64_t data_base;     // 分片在 packet_cache 中的起始偏移
+  uint32_t data_cap;      // 分片数据容量（字节）
+  uint32_t data_used;
+  uint32_t index_base;    // 分片在索引数组中的起始下标
+  uint32_t index_cap;
+  uint32_t count;
+  uint32_t cache_full;
+  uint32_t index_full;
+  uint32_t mismatched;
+  uint32_t batches;
+  uint64_t frames;
+  uint64_t first_ts;      // 分片内第一包/最后一包时间戳，供运行中的时间戳统计
+  uint64_t last_ts;
+  uint32_t clear_gen;     // 分片已执行到的 clear_cache 代数，落后于 l->clear_gen 时分片视为已清空
+} __attribute__((aligned(64))) fanout_worker_t;
+
+// 常驻预备模式的采集窗口状态
+enum { SHOT_IDLE = 0, SHOT_OPEN, SHOT_CLOSING };
+
+// shot_end 等待抓包线程读空套接字的最长时间，帧持续到达时超时后强制关闭窗口
+#define NET_SHOT_CLOSE_TIMEOUT_MS 100
+
+/*
+ * 监听实例：一次抓包会话的全部状态。旧接口操作 default_listener，
+ * net_listener_ctx_* 接口可在同一进程中为多个网卡各建一个实例并行采集。
+ */
+struct net_listener {
+  volatile int running;
+  int stop_efd;                 // 停止请求 eventfd，首次启动时创建，之后各次启动复用
+  pthread_t listener_thread;
+  int sockfd;
+  char ifname[IFNAMSIZ];
+  NetPacketCallback user_cb;
+  NetCacheCallback user_cache_cb;
+  NetCacheViewCallback user_cache_view_cb;
+  net_listener_config_t listener_cfg;
+
+  // TPACKET_V3 环形缓冲区
+  uint8_t *ring_map;
+  size_t ring_map_len;
+
+  // 回调分发环
+  dispatch_ring_t dispatch_rings[NET_FANOUT_MAX_WORKERS];
+  uint32_t dispatch_ring_count;
+  volatile int dispatch_running;
+  int dispatch_efd;                // 分发线程休眠时等待的 eventfd
+  uint32_t dispatch_sleeping;      // 分发线程已（或即将）阻塞在 dispatch_efd 上
+  pthread_t dispatch_thread;
+
+  // AF_XDP 套接字（NET_CAPTURE_XDP 模式下 sockfd 仅用于网卡 ioctl）
+  net_xdp_socket_t *xdp_sock;
+
+  // 分块回调：持久缓存区域切成若干块，当前块即 packet_cache 等字段所指的区域，
+  // 写满或超时后交给工作线程回调，回调返回后放回空闲列表
+  NetChunkCallback user_chunk_cb;
+  bool chunk_mode;
+  chunk_desc_t chunks[NET_CHUNK_MAX_COUNT];
+  uint32_t chunk_total;
+  uint32_t chunk_data_size;       // 每块数据容量
+  uint32_t chunk_max_packets;     // 每块索引容量
+  int cur_chunk;                  // 当前写入的块，-1 = 无空闲块（新帧计为丢弃）
+  uint64_t chunk_first_ts;        // 当前块第一包时间戳
+  uint32_t chunk_free[NET_CHUNK_MAX_COUNT];
+  uint32_t chunk_free_count;
+  uint32_t chunk_ready[NET_CHUNK_MAX_COUNT]; // 待回调块的 FIFO
+  uint32_t chunk_ready_head;
+  uint32_t chunk_ready_count;
+  uint32_t chunks_delivered;      // 由工作线程原子累加
+  bool chunk_stopping;
+  bool chunk_worker_started;
+  pthread_t chunk_thread;
+  pthread_cond_t chunk_cond;
+
+  // 流式写盘（stream_path 非空时替代内存缓存）
+  net_stream_t *stream;
+  net_stream_stats_t stream_final_stats; // 最近一次关闭时的统计
+
+  // pcapng 写盘与回放
+  net_pcap_writer_t *pcap;
+  net_pcap_stats_t pcap_final_stats;
+  net_pcap_reader_t *replay;
+  bool replay_done;
+
+  // 共享内存帧环（供其他进程读取）
+  net_shm_writer_t *shm;
+  net_shm_stats_t shm_final_stats;
+
+  // 缓存
+  uint8_t *packet_cache;
+  uint32_t *packet_lengths;
+  uint64_t *packet_offsets;       // 各包在 packet_cache 中的起始偏移
+  uint64_t *packet_timestamps;    // 各包内核接收时间（CLOCK_REALTIME 纳秒）
+  uint32_t uniform_length;        // 所有包长度相同时为该长度，否则为 0
+  uint32_t cache_size;
+  uint32_t max_packets;
+  uint32_t kernel_dropped_packets; // 多个线程原子累加
+  uint32_t rcvbuf_bytes;
+  bool clear_pending;             // 运行中 clear_cache 的请求，由抓包线程在下次写计数前执行
+  uint32_t clear_gen;             // 运行中 clear_cache 的次数，fanout worker 据此清空各自的分片
+  // 保护块队列、写盘句柄和采集窗口状态；抓包路径上只在交出分块时持有
+  pthread_mutex_t cache_mutex;
+
+  capture_stats_t stats;
+
+  // 唤醒延迟直方图（fanout 时多个抓包线程原子累加）
+  uint32_t latency_hist[NET_LATENCY_BUCKETS];
+
+  // payload_only 模式：缓存前校验的帧头模板
+  bool payload_only;
+  uint8_t payload_template[FPGA_UDP_HEADER_LEN];
+
+  // 持久缓存区域：首次使用时映射并预先缺页、锁定，之后各次采集复用，
+  // 由 net_listener_ctx_release_cache 释放。布局为 [包数据 | 包偏移数组 | 包时间戳数组 | 包长度数组]。
+  uint8_t *cache_region;
+  size_t cache_region_len;
+  size_t cache_region_data_len;      // 包数据部分容量（字节）
+  uint32_t cache_region_max_packets; // 包偏移/时间戳/长度数组容量
+  bool cache_region_huge;
+  bool cache_region_locked;
+  uint8_t *gather_cache;             // fanout 缓存回调的连续拷贝区，位于区域中分片数据之后
+
+  // PACKET_FANOUT
+  fanout_worker_t fanout_workers[NET_FANOUT_MAX_WORKERS];
+  uint32_t fanout_count;          // 0 = 未启用 fanout
+  uint32_t fanout_started;        // 已启动的额外 worker 线程数
+
+  // 常驻预备模式：窗口由 shot_begin 打开、shot_end 置为 CLOSING，
+  // 抓包线程读空套接字后（或被要求强制关闭时在下一帧之前）置回 IDLE 并唤醒 shot_end。
+  // 只有抓包线程（回放结束后为 shot_end）把 CLOSING 置回 IDLE
+  int shot_state;                 // SHOT_IDLE / SHOT_OPEN / SHOT_CLOSING
+  int shot_efd;                   // 请求抓包线程收尾窗口，首次以预备模式启动时创建
+  uint64_t shot_close_ns;         // 最早可完成关闭的时刻（CLOCK_MONOTONIC）
+  bool shot_force_close;          // 不再等套接字读空，抓包线程处理下一帧前即关闭窗口
+  uint32_t shot_seq;
+  uint32_t outside_window_packets;
+  pthread_cond_t shot_cond;
+
+  void *user_data;                // listener_cfg.user_data
+};
+
+#define NET_LISTENER_INITIALIZER { \
+  .stop_efd = -1, \
+  .sockfd = -1, \
+  .dispatch_efd = -1, \
+  .cur_chunk = -1, \
+  .shot_efd = -1, \
+  .chunk_cond = PTHREAD_COND_INITIALIZER, \
+  .shot_cond = PTHREAD_COND_INITIALIZER, \
+  .cache_mutex = PTHREAD_MUTEX_INITIALIZER, \
+}
+
+// 旧接口使用的默认实例
+static net_listener_t default_listener = NET_LISTENER_INITIALIZER;
+
+// 当前线程正在为哪个实例调用用户回调，见 net_listener_ctx_current
+static __thread net_listener_t *current_listener = NULL;
+
+// 清零本次采集的计数。调用者须是当前唯一的计数写者：抓包线程本身、抓包线程启动前或
+// 停止后的控制线程，或预备模式下窗口关闭期间（抓包线程不写计数）的 shot_begin
+static void reset_counters(net_listener_t *l) {
+  seq_write_begin(&l->stats.seq);
+  memset((uint8_t *)&l->stats + sizeof(l->stats.seq), 0, sizeof(l->stats) - sizeof(l->stats.seq));
+  seq_write_end(&l->stats.seq);
+  __atomic_store_n(&l->clear_pending, false, __ATOMIC_RELEASE);
+  __atomic_store_n(&l->kernel_dropped_packets, 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&l->chunks_delivered, 0, __ATOMIC_RELAXED);
+  for (int i = 0; i < NET_LATENCY_BUCKETS; i++)
+    __atomic_store_n(&l->latency_hist[i], 0, __ATOMIC_RELAXED);
+}
+
+// 抓包线程在写计数前调用：执行运行中 clear_cache 留下的清零请求
+static inline void apply_pending_clear(net_listener_t *l) {
+  if (__atomic_load_n(&l->clear_pending, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(&l->clear_pending, false, __ATOMIC_ACQUIRE))
+    reset_counters(l);
+}
+
+// 累计包间隔统计（调用者处于计数写区间），ts 为 0 表示该帧没有时间戳
+static inline void record_timestamp(net_listener_t *l, uint64_t ts) {
+  if (ts == 0)
+    return;
+  if (l->stats.ts_count == 0) {
+    l->stats.ts_first = ts;
+  } else {
+    uint64_t gap = ts > l->stats.ts_last ? ts - l->stats.ts_last : 0;
+    if (l->stats.ts_count == 1 || gap < l->stats.ts_min_gap)
+      l->stats.ts_min_gap = gap;
+    if (gap > l->stats.ts_max_gap)
+      l->stats.ts_max_gap = gap;
+    l->stats.ts_gap_sq_sum += (double)gap * gap;
+  }
+  l->stats.ts_last = ts;
+  l->stats.ts_count++;
+}
+
+static inline uint64_t timespec_to_ns(const struct timespec *ts) {
+  return (uint64_t)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+// 从 recvmsg 的控制消息中取 SO_TIMESTAMPNS 时间戳，没有时返回 0
+static uint64_t cmsg_timestamp_ns(struct msghdr *msg) {
+  for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR(msg, c)) {
+    if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+      struct timespec ts;
+      memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+      return timespec_to_ns(&ts);
+    }
+  }
+  return 0;
+}
+
+#define NET_TS_CMSG_SPACE  CMSG_SPACE(sizeof(struct timespec))
+
+/*
+ * 抓包线程调度与等待策略
+ */
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+static inline uint64_t monotonic_ns(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return timespec_to_ns(&now);
+}
+
+// spin-then-block：距上次收到帧不足 spin_us 时以非阻塞方式轮询，否则阻塞等待
+static inline bool in_spin_window(net_listener_t *l, uint64_t last_rx_ns) {
+  return l->listener_cfg.spin_us && monotonic_ns() - last_rx_ns < l->listener_cfg.spin_us * 1000ULL;
+}
+
+// 抓包线程关闭采集窗口并唤醒 shot_end：套接字已读空且到达收尾时刻，或被要求强制关闭
+static void finish_shot_window(net_listener_t *l) {
+  pthread_mutex_lock(&l->cache_mutex);
+  if (l->shot_state == SHOT_CLOSING) {
+    __atomic_store_n(&l->shot_force_close, false, __ATOMIC_RELAXED);
+    __atomic_store_n(&l->shot_state, SHOT_IDLE, __ATOMIC_RELEASE);
+    pthread_cond_broadcast(&l->shot_cond);
+  }
+  pthread_mutex_unlock(&l->cache_mutex);
+}
+
+// 常驻预备模式下窗口外到达的帧直接丢弃；CLOSING 期间仍属于当前窗口，
+// 除非 shot_end 已要求强制关闭，此时抓包线程在写入这些帧之前关闭窗口
+static inline bool outside_shot_window(net_listener_t *l, uint32_t frames) {
+  if (!l->listener_cfg.armed)
+    return false;
+  int state = __atomic_load_n(&l->shot_state, __ATOMIC_ACQUIRE);
+  if (state == SHOT_CLOSING && __atomic_load_n(&l->shot_force_close, __ATOMIC_ACQUIRE)) {
+    finish_shot_window(l);
+    state = SHOT_IDLE;
+  }
+  if (state != SHOT_IDLE)
+    return false;
+  __atomic_add_fetch(&l->outside_window_packets, frames, __ATOMIC_RELAXED);
+  return true;
+}
+
+// 记录内核收包时刻（CLOCK_REALTIME 纳秒）到抓包线程取到该帧之间的延迟
+static inline void record_wakeup_latency(net_listener_t *l, uint64_t ts) {
+  if (ts == 0)
+    return;
+
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  uint64_t now_ns = timespec_to_ns(&now);
+  uint64_t us = now_ns > ts ? (now_ns - ts) / 1000 : 0;
+  uint32_t bucket = 0;
+  while (us && bucket < NET_LATENCY_BUCKETS - 1) {
+    us >>= 1;
+    bucket++;
+  }
+  __atomic_fetch_add(&l->latency_hist[bucket], 1, __ATOMIC_RELAXED);
+}
+
+// 套接字忙轮询：recv/poll 时直接轮询网卡队列，失败（权限或内核不支持）只告警
+static void set_busy_poll(int sock, uint32_t busy_poll_us, bool prefer) {
+  int val = (int)busy_poll_us;
+  int on = 1;
+
+  if (busy_poll_us == 0)
+    return;
+  if (setsockopt(sock, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) < 0)
+    LOG_WARN("[net_listener] SO_BUSY_POLL failed: %s\n", strerror(errno));
+  if (prefer && setsockopt(sock, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on)) < 0)
+    LOG_WARN("[net_listener] SO_PREFER_BUSY_POLL failed: %s\n", strerror(errno));
+}
+
+// 接收缓冲区：SO_RCVBUFFORCE 可超过 net.core.rmem_max（需要 CAP_NET_ADMIN），失败时退回
+// SO_RCVBUF（被 rmem_max 截断）。返回内核实际分配的大小
+static uint32_t set_rcvbuf(int sock, uint32_t size) {
+  int val = (int)size;
+  if (size > 0 && setsockopt(sock, SOL_SOCKET, SO_RCVBUFFORCE, &val, sizeof(val)) < 0 &&
+      setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &val, sizeof(val)) < 0)
+    LOG_WARN("[net_listener] SO_RCVBUF failed: %s\n", strerror(errno));
+
+  // 内核把设置值加倍以计入记账开销，读回值为加倍后的大小
+  int actual = 0;
+  socklen_t len = sizeof(actual);
+  getsockopt(sock, SOL_SOCKET, SO_RCVBUF, &actual, &len);
+  if (size > 0 && actual / 2 < val)
+    LOG_WARN("[net_listener] Receive buffer limited to %d bytes by net.core.rmem_max (requested %u)\n",
+             actual / 2, size);
+  return (uint32_t)actual;
+}
+
+/**
+ * @brief 在抓包线程内设置实时优先级和 CPU 亲和性
+ * @param worker fanout worker 序号（绑定 cpu_affinity 中第 worker 个 CPU，掩码为 0 时绑定
+ *               CPU worker）；-1 表示单线程抓包，绑定整个掩码
+ */
+static void setup_capture_thread(net_listener_t *l, int worker) {
+  if (l->listener_cfg.sched_priority > 0) {
+    struct sched_param sp = { .sched_priority = l->listener_cfg.sched_priority };
+    int err = pthread_setschedparam(pthread_self(), SCHED_FIFO, &sp);
+    if (err != 0)
+      LOG_WARN("[net_listener] SCHED_FIFO priority %d failed: %s\n",
+           l->listener_cfg.sched_priority, strerror(err));
+  }
+
+  uint32_t mask = l->listener_cfg.cpu_affinity;
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  cpu_set_t set;
+  CPU_ZERO(&set);
+
+  if (worker < 0) {
+    if (mask == 0)
+      return;
+    for (int cpu = 0; cpu < 32; cpu++)
+      if (mask & (1u << cpu))
+        CPU_SET(cpu, &set);
+  } else if (mask == 0) {
+    CPU_SET(worker % (ncpu > 0 ? ncpu : 1), &set);
+  } else {
+    int nth = worker % __builtin_popcount(mask);
+    for (int cpu = 0; cpu < 32; cpu++) {
+      if ((mask & (1u << cpu)) && nth-- == 0) {
+        CPU_SET(cpu, &set);
+        break;
+      }
+    }
+  }
+
+  if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0)
+    LOG_WARN("[net_listener] Failed to set capture thread CPU affinity\n");
+}
+
+
+/**
+ * @brief 校验帧头是否与 FPGA 帧头模板一致
+ * @details 跳过 IP 标识、IP 校验和与 UDP 校验和三个字段，其余 36 字节逐字节比较。
+ */
+static inline bool match_fpga_header(net_listener_t *l, const uint8_t *frame, uint32_t length) {
+  if (length < FPGA_UDP_HEADER_LEN)
+    return false;
+  return memcmp(frame, l->payload_template, 18) == 0 &&          // ETH + IP 版本/TOS/总长度
+         memcmp(frame + 20, l->payload_template + 20, 4) == 0 &&  // IP 标志/TTL/协议
+         memcmp(frame + 26, l->payload_template + 26, 14) == 0;   // IP 地址 + UDP 端口/长度
+}
+
+
+#define NET_CACHE_HUGE_PAGE_SIZE  (2UL << 20)
+#define NET_CACHE_INDEX_ENTRY     (2 * sizeof(uint64_t) + sizeof(uint32_t))  // 每包索引字节数
+
+static void unmap_cache_region(net_listener_t *l) {
+  if (!l->cache_region)
+    return;
+  if (l->cache_region_locked)
+    munlock(l->cache_region, l->cache_region_len);
+  munmap(l->cache_region, l->cache_region_len);
+  l->cache_region = NULL;
+  l->cache_region_len = 0;
+  l->cache_region_data_len = 0;
+  l->cache_region_max_packets = 0;
+  l->cache_region_huge = false;
+  l->cache_region_locked = false;
+}
+
+/**
+ * @brief 确保持久缓存区域至少能容纳 size 字节数据和 packets 个包的索引
+ * @details 已有区域足够大时直接复用；否则重新映射。优先使用 2MB 大页 (MAP_HUGETLB)，
+ *          大页不足时退回普通匿名映射并建议内核使用透明大页。映射后逐页写入完成预缺页，
+ *          再 mlock 锁定，避免采集过程中发生缺页或换出。mlock 失败（RLIMIT_MEMLOCK）
+ *          只打印警告。
+ */
+static int map_cache_region(net_listener_t *l, size_t size, uint32_t packets) {
+  size_t data_len = (size + 63) & ~(size_t)63;
+  if (l->cache_region && data_len <= l->cache_region_data_len && packets <= l->cache_region_max_packets)
+    return 0;
+
+  unmap_cache_region(l);
+
+  size_t len = data_len + (size_t)packets * NET_CACHE_INDEX_ENTRY;
+  size_t huge_len = (len + NET_CACHE_HUGE_PAGE_SIZE - 1) & ~(NET_CACHE_HUGE_PAGE_SIZE - 1);
+  void *p = mmap(NULL, huge_len, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+  if (p != MAP_FAILED) {
+    l->cache_region_huge = true;
+    len = huge_len;
+  } else {
+    p = mmap(NULL, len, PROT_READ | PROT_WRITE,
+             MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (p == MAP_FAILED) {
+      perror("mmap");
+      LOG_ERROR("[net_listener] Failed to map packet cache\n");
+      return -1;
+    }
+    madvise(p, len, MADV_HUGEPAGE);
+  }
+
+  // MAP_POPULATE 失败时不会报错，这里逐页写一次确保全部页已建立映射
+  long page = sysconf(_SC_PAGESIZE);
+  for (size_t off = 0; off < len; off += page)
+    ((volatile uint8_t *)p)[off] = 0;
+
+  l->cache_region_locked = mlock(p, len) == 0;
+  if (!l->cache_region_locked)
+    LOG_WARN("[net_listener] mlock packet cache failed, pages may be swapped out\n");
+
+  l->cache_region = p;
+  l->cache_region_len = len;
+  l->cache_region_data_len = (len - (size_t)packets * NET_CACHE_INDEX_ENTRY) & ~(size_t)63;
+  l->cache_region_max_packets = packets;
+
+  LOG_INFO("[net_listener] Cache region mapped: %zu MB (%s, %s)\n", len >> 20,
+       l->cache_region_huge ? "hugetlb" : "4K pages",
+       l->cache_region_locked ? "locked" : "unlocked");
+  return 0;
+}
+
+// 缓存管理函数：从持久区域中取出本次采集使用的部分。
+// gather 为 true 时区域额外预留 size 字节，供 fanout 分片按包顺序拼接后交给缓存回调
+static int init_cache(net_listener_t *l, uint32_t size, bool gather) {
+  pthread_mutex_lock(&l->cache_mutex);
   
   // 计算最大包数（假设平均包大小为1KB）
-  max_packets = size / 1024;
-  if (max_packets < 1000) max_packets = 1000; // 最小1000个包
-  
-  // 分配包数据缓存
-  cache_size = size;
-  packet_cache = malloc(cache_size);
-  if (!packet_cache) {
-    LOG_ERROR("[net_listener] Failed to allocate packet cache\n");
-    pthread_mutex_unlock(&cache_mutex);
-    return -1;
-  }
+  l->max_packets = size / 1024;
+  if (l->max_packets < 1000) l->max_packets = 1000; // 最小1000个包
   
-  // 分配包长度数组
-  packet_lengths = malloc(max_packets * sizeof(uint32_t));
-  if (!packet_lengths) {
-    LOG_ERROR("[net_listener] Failed to allocate packet lengths array\n");
-    free(packet_cache);
-    packet_cache = NULL;
-    pthread_mutex_unlock(&cache_mutex);
+  size_t data_len = ((size_t)size + 63) & ~(size_t)63;
+  if (map_cache_region(l, gather ? data_len + size : size, l->max_packets) < 0) {
+    pthread_mutex_unlock(&l->cache_mutex);
     return -1;
   }
+  l->cache_size = size;
+  l->packet_cache = l->cache_region;
+  l->gather_cache = gather ? l->cache_region + data_len : NULL;
+  l->packet_offsets = (uint64_t *)(l->cache_region + l->cache_region_data_len);
+  l->packet_timestamps = l->packet_offsets + l->cache_region_max_packets;
+  l->packet_lengths = (uint32_t *)(l->packet_timestamps + l->cache_region_max_packets);
   
-  cache_used = 0;
-  packet_count = 0;
-  total_bytes = 0;
-  dropped_packets = 0;
+  reset_counters(l);
   
   LOG_INFO("[net_listener] Cache initialized: %u MB, max packets: %u\n", 
-       size / (1024 * 1024), max_packets);
-  pthread_mutex_unlock(&cache_mutex);
+       size / (1024 * 1024), l->max_packets);
+  pthread_mutex_unlock(&l->cache_mutex);
   return 0;
 }
 
-static void cleanup_cache(void) {
-  pthread_mutex_lock(&cache_mutex);
-  if (packet_cache) {
-    free(packet_cache);
-    packet_cache = NULL;
+/**
+ * @brief 把当前块交给工作线程并换用空闲块（调用者处于计数写区间，不持有 cache_mutex）
+ * @details 只在操作与工作线程共享的块队列时持有 cache_mutex。
+ *          没有空闲块时当前块容量置 0，之后的帧计为丢弃，下次写入时再尝试取块。
+ *          packet_cache 保持非空，抓包循环仍走缓存路径并正确计数丢弃。
+ */
+static void rotate_chunk(net_listener_t *l) {
+  if (l->cur_chunk >= 0 && l->stats.packet_count == 0)
+    return;
+
+  pthread_mutex_lock(&l->cache_mutex);
+  if (l->cur_chunk >= 0) {
+    chunk_desc_t *d = &l->chunks[l->cur_chunk];
+    d->seq = l->stats.chunk_seq++;
+    d->packet_count = l->stats.packet_count;
+    d->bytes = l->stats.total_bytes;
+    d->stride = l->uniform_length;
+    l->chunk_ready[(l->chunk_ready_head + l->chunk_ready_count) % l->chunk_total] = (uint32_t)l->cur_chunk;
+    l->chunk_ready_count++;
+    pthread_cond_signal(&l->chunk_cond);
+    l->stats.chunk_done_packets += l->stats.packet_count;
+    l->stats.chunk_done_bytes += l->stats.total_bytes;
+    l->cur_chunk = -1;
   }
-  if (packet_lengths) {
-    free(packet_lengths);
-    packet_lengths = NULL;
+  l->stats.packet_count = 0;
+  l->stats.cache_used = 0;
+  l->stats.total_bytes = 0;
+  l->uniform_length = 0;
+
+  if (l->chunk_free_count == 0) {
+    pthread_mutex_unlock(&l->cache_mutex);
+    l->cache_size = 0;
+    l->max_packets = 0;
+    return;
   }
-  cache_size = 0;
-  cache_used = 0;
-  packet_count = 0;
-  total_bytes = 0;
-  dropped_packets = 0;
-  pthread_mutex_unlock(&cache_mutex);
+  l->cur_chunk = (int)l->chunk_free[--l->chunk_free_count];
+  pthread_mutex_unlock(&l->cache_mutex);
+  uint64_t *offsets = (uint64_t *)(l->cache_region + l->cache_region_data_len);
+  uint64_t *stamps = offsets + l->cache_region_max_packets;
+  uint32_t *lengths = (uint32_t *)(stamps + l->cache_region_max_packets);
+  size_t first = (size_t)l->cur_chunk * l->chunk_max_packets;
+  l->packet_cache = l->cache_region + (size_t)l->cur_chunk * l->chunk_data_size;
+  l->packet_offsets = offsets + first;
+  l->packet_timestamps = stamps + first;
+  l->packet_lengths = lengths + first;
+  l->cache_size = l->chunk_data_size;
+  l->max_packets = l->chunk_max_packets;
 }
 
-static int add_packet_to_cache(const uint8_t *data, int length) {
-  pthread_mutex_lock(&cache_mutex);
-  
-  // 检查缓存空间
-  if (packet_count >= max_packets) {
-    dropped_packets++;
-    pthread_mutex_unlock(&cache_mutex);
-    return -1; // 包数达到上限
+// 写入 added 个包之后调用（调用者处于计数写区间）：记录块内首包时间，块已超时则交出
+static inline void chunk_after_add(net_listener_t *l, uint32_t added, uint64_t first_ts, uint64_t last_ts) {
+  if (l->stats.packet_count == added)
+    l->chunk_first_ts = first_ts;
+  if (l->chunk_first_ts && last_ts >= l->chunk_first_ts + l->listener_cfg.chunk_timeout_ms * 1000000ULL)
+    rotate_chunk(l);
+}
+
+// 分块工作线程：按交出顺序逐块调用 user_chunk_cb，停止时处理完所有待回调块再退出
+static void *chunk_worker_loop(void *arg) {
+  net_listener_t *l = arg;
+  current_listener = l;
+  pthread_mutex_lock(&l->cache_mutex);
+  for (;;) {
+    while (l->chunk_ready_count == 0 && !l->chunk_stopping)
+      pthread_cond_wait(&l->chunk_cond, &l->cache_mutex);
+    if (l->chunk_ready_count == 0)
+      break;
+
+    uint32_t k = l->chunk_ready[l->chunk_ready_head];
+    l->chunk_ready_head = (l->chunk_ready_head + 1) % l->chunk_total;
+    l->chunk_ready_count--;
+    chunk_desc_t d = l->chunks[k];
+    uint64_t *offsets = (uint64_t *)(l->cache_region + l->cache_region_data_len);
+    uint64_t *stamps = offsets + l->cache_region_max_packets;
+    uint32_t *lengths = (uint32_t *)(stamps + l->cache_region_max_packets);
+    size_t first = (size_t)k * l->chunk_max_packets;
+    net_cache_view_t view = {
+      .data = l->cache_region + (size_t)k * l->chunk_data_size,
+      .packet_count = d.packet_count,
+      .total_bytes = d.bytes,
+      .packet_lengths = lengths + first,
+      .packet_offsets = offsets + first,
+      .packet_timestamps = stamps + first,
+      .stride = d.stride,
+    };
+    pthread_mutex_unlock(&l->cache_mutex);
+
+    l->user_chunk_cb(&view, d.seq);
+
+    pthread_mutex_lock(&l->cache_mutex);
+    l->chunk_free[l->chunk_free_count++] = k;
+    __atomic_add_fetch(&l->chunks_delivered, 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&l->cache_mutex);
+  return NULL;
+}
+
+/**
+ * @brief 把持久缓存区域切成 chunk_count 块并启动分块工作线程
+ * @details 每块的包索引容量按平均包大小 256 字节估算，索引先用完时同样提前交出该块。
+ */
+static int init_chunks(net_listener_t *l) {
+  uint32_t count = l->listener_cfg.chunk_count;
+  if (count < 2)
+    count = 2;
+  if (count > NET_CHUNK_MAX_COUNT)
+    count = NET_CHUNK_MAX_COUNT;
+  uint32_t size = (l->listener_cfg.chunk_size + 63) & ~63u;
+  if (size < NET_BUFFER_SIZE || (uint64_t)size * count > UINT32_MAX) {
+    LOG_ERROR("[net_listener] Invalid chunk size %u x %u\n", l->listener_cfg.chunk_size, count);
+    return -1;
+  }
+  uint32_t packets = size / 256 > 64 ? size / 256 : 64;
+
+  if (map_cache_region(l, size * count, packets * count) < 0)
+    return -1;
+  l->chunk_total = count;
+  l->chunk_data_size = size;
+  l->chunk_max_packets = packets;
+  for (uint32_t i = 0; i < count; i++)
+    l->chunk_free[i] = count - 1 - i;
+  l->chunk_free_count = count;
+  l->chunk_ready_head = 0;
+  l->chunk_ready_count = 0;
+  l->chunk_stopping = false;
+  l->cur_chunk = -1;
+  reset_counters(l);
+  l->chunk_mode = true;
+  seq_write_begin(&l->stats.seq);
+  rotate_chunk(l);
+  seq_write_end(&l->stats.seq);
+
+  if (pthread_create(&l->chunk_thread, NULL, chunk_worker_loop, l) != 0) {
+    perror("pthread_create");
+    l->chunk_mode = false;
+    return -1;
+  }
+  l->chunk_worker_started = true;
+  LOG_INFO("[net_listener] Chunk mode: %u x %u KB chunks, timeout %u ms\n", count, size / 1024,
+       l->listener_cfg.chunk_timeout_ms);
+  return 0;
+}
+
+// 交出最后一个未写满的块，等待工作线程处理完所有块后退出
+static void stop_chunk_worker(net_listener_t *l) {
+  if (!l->chunk_worker_started)
+    return;
+  if (l->cur_chunk >= 0) {
+    seq_write_begin(&l->stats.seq);
+    rotate_chunk(l);
+    seq_write_end(&l->stats.seq);
   }
+  pthread_mutex_lock(&l->cache_mutex);
+  l->chunk_stopping = true;
+  pthread_cond_signal(&l->chunk_cond);
+  pthread_mutex_unlock(&l->cache_mutex);
+  pthread_join(l->chunk_thread, NULL);
+  l->chunk_worker_started = false;
+  l->chunk_mode = false;
+}
+
+// 结束本次采集，区域本身保留给下一次使用
+static void cleanup_cache(net_listener_t *l) {
+  stop_chunk_worker(l);
+  pthread_mutex_lock(&l->cache_mutex);
+  l->packet_cache = NULL;
+  l->gather_cache = NULL;
+  l->packet_lengths = NULL;
+  l->packet_offsets = NULL;
+  l->packet_timestamps = NULL;
+  l->cache_size = 0;
+  reset_counters(l);
+  pthread_mutex_unlock(&l->cache_mutex);
+}
+
+// 抓包路径不加锁：计数在 seqlock 写区间内更新，只有交出分块时短暂持有 cache_mutex
+static int add_packet_to_cache(net_listener_t *l, const uint8_t *data, int length, uint64_t ts) {
+  apply_pending_clear(l);
+  seq_write_begin(&l->stats.seq);
+
+  int ret = -1;
+  // payload_only 模式下校验并剥离帧头
+  if (l->payload_only) {
+    if (!match_fpga_header(l, data, length)) {
+      l->stats.header_mismatch_packets++;
+      goto out;
+    }
+    data += FPGA_UDP_HEADER_LEN;
+    length -= FPGA_UDP_HEADER_LEN;
+  }
+  record_timestamp(l, ts);
+
+  // 分块模式下当前块放不下时先交出，换用空闲块
+  if (l->chunk_mode && (l->stats.packet_count >= l->max_packets || l->stats.cache_used + length > l->cache_size))
+    rotate_chunk(l);
   
-  if (cache_used + length > cache_size) {
-    dropped_packets++;
-    pthread_mutex_unlock(&cache_mutex);
-    return -1; // 缓存空间不足
+  // 检查缓存空间（两者都满时计为数据区满，分块模式无空闲块时即如此）
+  if (l->stats.cache_used + length > l->cache_size) {
+    l->stats.dropped_packets++;
+    l->stats.cache_full_drops++;
+    goto out; // 缓存空间不足
+  }
+
+  if (l->stats.packet_count >= l->max_packets) {
+    l->stats.dropped_packets++;
+    l->stats.index_full_drops++;
+    goto out; // 包数达到上限
   }
   
   // 存储包数据
-  memcpy(packet_cache + cache_used, data, length);
-  packet_lengths[packet_count] = length;
+  memcpy(l->packet_cache + l->stats.cache_used, data, length);
+  l->packet_lengths[l->stats.packet_count] = length;
+  l->packet_offsets[l->stats.packet_count] = l->stats.cache_used;
+  l->packet_timestamps[l->stats.packet_count] = ts;
+  if (l->stats.packet_count == 0)
+    l->uniform_length = length;
+  else if ((uint32_t)length != l->uniform_length)
+    l->uniform_length = 0;
   
-  cache_used += length;
-  total_bytes += length;
-  packet_count++;
-  
-  pthread_mutex_unlock(&cache_mutex);
+  l->stats.cache_used += length;
+  l->stats.total_bytes += length;
+  l->stats.packet_count++;
+  if (l->chunk_mode)
+    chunk_after_add(l, 1, ts, ts);
+  ret = 0;
+
+out:
+  seq_write_end(&l->stats.seq);
+  return ret;
+}
+
+// 写入流：payload_only 校验同缓存路径，帧数据由 net_stream 写入块缓冲
+static int add_packet_to_stream(net_listener_t *l, const uint8_t *data, int length, uint64_t ts) {
+  apply_pending_clear(l);
+  seq_write_begin(&l->stats.seq);
+  if (l->payload_only) {
+    if (!match_fpga_header(l, data, length)) {
+      l->stats.header_mismatch_packets++;
+      seq_write_end(&l->stats.seq);
+      return -1;
+    }
+    data += FPGA_UDP_HEADER_LEN;
+    length -= FPGA_UDP_HEADER_LEN;
+  }
+  record_timestamp(l, ts);
+  seq_write_end(&l->stats.seq);
+
+  return net_stream_add(l->stream, data, (uint32_t)length, ts);
+}
+
+// 写出剩余数据并关闭流式写盘、pcapng 写盘和共享内存帧环，保留最终统计
+static void close_writers(net_listener_t *l) {
+  pthread_mutex_lock(&l->cache_mutex);
+  if (l->stream && net_stream_close(l->stream, &l->stream_final_stats) < 0)
+    LOG_WARN("[net_listener] Stream closed with write errors\n");
+  l->stream = NULL;
+  if (l->pcap && net_pcap_close(l->pcap, &l->pcap_final_stats) < 0)
+    LOG_WARN("[net_listener] pcapng file closed with write errors\n");
+  l->pcap = NULL;
+  if (l->shm)
+    net_shm_close(l->shm, &l->shm_final_stats);
+  l->shm = NULL;
+  pthread_mutex_unlock(&l->cache_mutex);
+}
+
+/**
+ * @brief 建立 TPACKET_V3 接收环并映射到用户空间
+ * @details 环由 ring_block_count 个 ring_block_size 大小的块组成，
+ *          内核按块填充帧，用户态逐块处理后再归还给内核。
+ */
+static int setup_packet_ring(net_listener_t *l, int sock, const net_listener_config_t *cfg) {
+  int version = TPACKET_V3;
+  if (setsockopt(sock, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)) < 0) {
+    perror("setsockopt(PACKET_VERSION)");
+    return -1;
+  }
+
+  struct tpacket_req3 req;
+  memset(&req, 0, sizeof(req));
+  req.tp_block_size = cfg->ring_block_size;
+  req.tp_block_nr = cfg->ring_block_count;
+  req.tp_frame_size = cfg->ring_frame_size;
+  req.tp_frame_nr = (cfg->ring_block_size / cfg->ring_frame_size) * cfg->ring_block_count;
+  req.tp_retire_blk_tov = cfg->ring_block_timeout_ms;
+  req.tp_feature_req_word = 0;
+
+  if (setsockopt(sock, SOL_PACKET, PACKET_RX_RING, &req, sizeof(req)) < 0) {
+    perror("setsockopt(PACKET_RX_RING)");
+    return -1;
+  }
+
+  l->ring_map_len = (size_t)req.tp_block_size * req.tp_block_nr;
+  l->ring_map = mmap(NULL, l->ring_map_len, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_LOCKED, sock, 0);
+  if (l->ring_map == MAP_FAILED) {
+    // MAP_LOCKED 受 RLIMIT_MEMLOCK 限制，失败时退回普通映射
+    l->ring_map = mmap(NULL, l->ring_map_len, PROT_READ | PROT_WRITE, MAP_SHARED, sock, 0);
+  }
+  if (l->ring_map == MAP_FAILED) {
+    perror("mmap(PACKET_RX_RING)");
+    l->ring_map = NULL;
+    l->ring_map_len = 0;
+    return -1;
+  }
+
+  LOG_INFO("[net_listener] TPACKET_V3 ring: %u blocks x %u KB, frame %u bytes\n",
+       req.tp_block_nr, req.tp_block_size / 1024, req.tp_frame_size);
+  return 0;
+}
+
+static void teardown_packet_ring(net_listener_t *l) {
+  if (l->ring_map) {
+    munmap(l->ring_map, l->ring_map_len);
+    l->ring_map = NULL;
+    l->ring_map_len = 0;
+  }
+}
+
+/**
+ * @brief 根据 FPGA UDP 包头参数生成经典 BPF 过滤程序
+ * @details 仅放行与 fpga_initialize_udp_header 写入的模板一致的帧：
+ *          IPv4 / 源 MAC / 源 IP / 目的 IP / UDP / 源端口 / 目的端口。
+ *          其余帧在内核中丢弃，不会被拷贝、不占用缓存，也不计入 max_packets。
+ * @param params UDP 包头参数（主机字节序）
+ * @param prog   输出缓冲区，至少 NET_UDP_FILTER_LEN 条指令
+ * @return 指令条数
+ */
+#define NET_UDP_FILTER_LEN 21
+static int build_udp_filter(const S_udp_header_params *params, struct sock_filter *prog) {
+  uint32_t src_mac_h32 = ((uint32_t)params->src_mac_high << 16) | (params->src_mac_low >> 16);
+  uint32_t src_mac_l16 = params->src_mac_low & 0xFFFF;
+  struct sock_filter code[NET_UDP_FILTER_LEN] = {
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 12),                        // 以太网类型
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   ETHERTYPE_IP, 0, 18),
+    BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 6),                         // 源 MAC 高 4 字节
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   src_mac_h32, 0, 16),
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 10),                        // 源 MAC 低 2 字节
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   src_mac_l16, 0, 14),
+    BPF_STMT(BPF_LD  | BPF_B   | BPF_ABS, 23),                        // IP 协议
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   IPPROTO_UDP, 0, 12),
+    BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 26),                        // 源 IP
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   params->src_ip, 0, 10),
+    BPF_STMT(BPF_LD  | BPF_W   | BPF_ABS, 30),                        // 目的 IP
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   params->dst_ip, 0, 8),
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_ABS, 20),                        // 分片偏移
+    BPF_JUMP(BPF_JMP | BPF_JSET | BPF_K,  0x1FFF, 6, 0),
+    BPF_STMT(BPF_LDX | BPF_B   | BPF_MSH, 14),                        // X = IP 头长度
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, 14),                        // UDP 源端口
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   params->src_port, 0, 3),
+    BPF_STMT(BPF_LD  | BPF_H   | BPF_IND, 16),                        // UDP 目的端口
+    BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,   params->dst_port, 0, 1),
+    BPF_STMT(BPF_RET | BPF_K,             0x40000),                   // 放行整帧
+    BPF_STMT(BPF_RET | BPF_K,             0),                         // 丢弃
+  };
+  memcpy(prog, code, sizeof(code));
+  return NET_UDP_FILTER_LEN;
+}
+
+// 用户态版本的 build_udp_filter，条件与之一致，供没有套接字的回放源使用
+static bool match_udp_filter(const S_udp_header_params *params, const uint8_t *frame, uint32_t length) {
+  uint32_t src_mac_h32 = ((uint32_t)params->src_mac_high << 16) | (params->src_mac_low >> 16);
+  uint32_t src_mac_l16 = params->src_mac_low & 0xFFFF;
+  if (length < 34 || (frame[12] << 8 | frame[13]) != ETHERTYPE_IP)
+    return false;
+  uint32_t mac_h, ip_src, ip_dst;
+  memcpy(&mac_h, frame + 6, 4);
+  memcpy(&ip_src, frame + 26, 4);
+  memcpy(&ip_dst, frame + 30, 4);
+  if (ntohl(mac_h) != src_mac_h32 || (uint32_t)(frame[10] << 8 | frame[11]) != src_mac_l16 ||
+      frame[23] != IPPROTO_UDP || ntohl(ip_src) != params->src_ip || ntohl(ip_dst) != params->dst_ip ||
+      ((frame[20] << 8 | frame[21]) & 0x1FFF))
+    return false;
+  uint32_t udp = 14 + (frame[14] & 0x0F) * 4;
+  if (length < udp + 4)
+    return false;
+  return (frame[udp] << 8 | frame[udp + 1]) == params->src_port &&
+         (frame[udp + 2] << 8 | frame[udp + 3]) == params->dst_port;
+}
+
+static int attach_udp_filter(int sock, const S_udp_header_params *params) {
+  struct sock_filter code[NET_UDP_FILTER_LEN];
+  struct sock_fprog prog;
+  prog.len = build_udp_filter(params, code);
+  prog.filter = code;
+
+  if (setsockopt(sock, SOL_SOCKET, SO_ATTACH_FILTER, &prog, sizeof(prog)) < 0) {
+    perror("setsockopt(SO_ATTACH_FILTER)");
+    return -1;
+  }
+  LOG_INFO("[net_listener] BPF filter attached: UDP %u -> %u\n",
+       params->src_port, params->dst_port);
   return 0;
 }
 
-// 原有函数保持不变...
 static int set_promisc_mode(const char *ifname, int sockfd, int enable) {
   struct ifreq ifr;
   memset(&ifr, 0, sizeof(ifr));
@@ -138,12 +996,17 @@ static int set_promisc_mode(const char *ifname, int sockfd, int enable) {
   return 0;
 }
 
-static int create_raw_socket(const char *ifname) {
+/**
+ * @brief 创建并绑定原始套接字
+ * @details 套接字以协议号 0 创建，此时内核尚未挂接接收钩子；
+ *          过滤器和接收环在 bind 之前安装，保证 bind 之后收到的每一帧都经过过滤。
+ */
+static int create_raw_socket(net_listener_t *l, const char *ifname, const net_listener_config_t *cfg) {
   int sock;
   struct sockaddr_ll sll;
   struct ifreq ifr;
 
-  sock = socket(PF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+  sock = socket(PF_PACKET, SOCK_RAW, 0);
   if (sock < 0) {
     perror("socket");
     return -1;
@@ -154,6 +1017,36 @@ static int create_raw_socket(const char *ifname) {
     return -1;
   }
 
+  // 等待新帧和停止请求由 epoll 完成，接收本身不设超时；只有 recvmmsg 凑批时
+  // 用 SO_RCVTIMEO 限制批内等待，避免突发结束后一直阻塞在半满的批上
+  if (cfg->mode == NET_CAPTURE_RECVMMSG && cfg->batch_timeout_ms > 0) {
+    struct timeval tv = {
+      .tv_sec = cfg->batch_timeout_ms / 1000,
+      .tv_usec = (cfg->batch_timeout_ms % 1000) * 1000,
+    };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  }
+
+  set_busy_poll(sock, cfg->busy_poll_us, cfg->prefer_busy_poll);
+  l->rcvbuf_bytes = set_rcvbuf(sock, cfg->rcvbuf_size);
+
+  // 内核接收时间戳，随 recvmsg/recvmmsg 的控制消息返回（TPACKET 环自带时间戳）
+  int on = 1;
+  if (setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) < 0)
+    perror("setsockopt SO_TIMESTAMPNS");
+
+  if (cfg->udp_filter_enable && attach_udp_filter(sock, &cfg->udp_filter) < 0) {
+    set_promisc_mode(ifname, sock, 0);
+    close(sock);
+    return -1;
+  }
+
+  if (cfg->mode == NET_CAPTURE_MMAP && setup_packet_ring(l, sock, cfg) < 0) {
+    set_promisc_mode(ifname, sock, 0);
+    close(sock);
+    return -1;
+  }
+
   memset(&sll, 0, sizeof(sll));
   sll.sll_family = AF_PACKET;
   sll.sll_protocol = htons(ETH_P_ALL);
@@ -161,6 +1054,8 @@ static int create_raw_socket(const char *ifname) {
 
   if (ioctl(sock, SIOCGIFINDEX, &ifr) < 0) {
     perror("ioctl(SIOCGIFINDEX)");
+    set_promisc_mode(ifname, sock, 0);
+    teardown_packet_ring(l);
     close(sock);
     return -1;
   }
@@ -169,6 +1064,8 @@ static int create_raw_socket(const char *ifname) {
 
   if (bind(sock, (struct sockaddr *)&sll, sizeof(sll)) < 0) {
     perror("bind");
+    set_promisc_mode(ifname, sock, 0);
+    teardown_packet_ring(l);
     close(sock);
     return -1;
   }
@@ -176,116 +1073,1710 @@ static int create_raw_socket(const char *ifname) {
   return sock;
 }
 
-static void *listener_loop(void *arg) {
-  unsigned char buffer[NET_BUFFER_SIZE];
+/**
+ * @brief 把帧交给实时回调
+ * @details 启用分发环时只把帧拷入该抓包线程的环中，由分发线程调用 user_cb，回调耗时不会
+ *          阻塞抓包；环满时该帧不再交给回调（仍会写入缓存），计入 overflow。
+ */
+static inline void deliver_packet(net_listener_t *l, dispatch_ring_t *ring, const uint8_t *data, int length) {
+  if (!ring->slots) {
+    l->user_cb(data, length);
+    return;
+  }
 
-  while (running) {
-    int length = recv(sockfd, buffer, sizeof(buffer), 0);
-    if (length > 0) {
-      // 调用用户回调
-      if (user_cb)
-        user_cb(buffer, length);
-      
-      // 缓存数据包
-      if (user_cache_cb)
-        add_packet_to_cache(buffer, length);
-    } else {
-      usleep(1000);
-    }
+  uint32_t head = ring->head;
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  uint32_t pending = head - tail;
+  if (pending > ring->mask) {
+    ring->overflow++;
+    return;
   }
-  return NULL;
+
+  dispatch_slot_t *slot = &ring->slots[head & ring->mask];
+  if (length > NET_BUFFER_SIZE)
+    length = NET_BUFFER_SIZE;
+  memcpy(slot->data, data, length);
+  slot->length = length;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  if (pending + 1 > ring->high_water)
+    ring->high_water = pending + 1;
+
+  // 与 park_dispatcher 配对的全屏障：要么这里看到休眠标志并唤醒，要么分发线程休眠前看到新帧
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&l->dispatch_sleeping, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(&l->dispatch_sleeping, 0, __ATOMIC_ACQ_REL))
+    eventfd_write(l->dispatch_efd, 1);
 }
 
-int net_listener_start(const char *ifname, NetPacketCallback cb) {
-  return net_listener_start_with_cache(ifname, cb, NULL, 0);
+// 排空一个环中已提交的帧，返回处理的帧数
+static uint32_t drain_dispatch_ring(net_listener_t *l, dispatch_ring_t *ring) {
+  uint32_t tail = ring->tail;
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  uint32_t n = head - tail;
+
+  while (tail != head) {
+    dispatch_slot_t *slot = &ring->slots[tail & ring->mask];
+    l->user_cb(slot->data, slot->length);
+    tail++;
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+  }
+  return n;
 }
 
-int net_listener_start_with_cache(const char *ifname, NetPacketCallback cb, 
-                 NetCacheCallback cache_cb, uint32_t cache_size) {
-  LOG_INFO("[net_listener] Starting on %s...\n", ifname);
-  if (running)
-    return 0;
+static bool dispatch_rings_empty(net_listener_t *l) {
+  for (uint32_t i = 0; i < l->dispatch_ring_count; i++) {
+    dispatch_ring_t *ring = &l->dispatch_rings[i];
+    if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE))
+      return false;
+  }
+  return true;
+}
 
-  // 初始化缓存（如果启用了缓存功能）
-  user_cache_cb = cache_cb;
-  if (cache_cb && cache_size > 0) {
-    if (init_cache(cache_size) < 0) {
-      LOG_ERROR("[net_listener] Cache initialization failed\n");
-      return -1;
+// 等分发线程处理完环中已提交的帧；tail 在回调返回后才前移，环空即本次窗口的回调全部结束。
+// 只在窗口关闭后调用，此时不再有帧进入分发环
+static void wait_dispatch_drained(net_listener_t *l) {
+  while (!dispatch_rings_empty(l))
+    usleep(50);
+}
+
+// 先置休眠标志再复查各环，确认仍为空才阻塞，直到生产者提交新帧或停止
+static void park_dispatcher(net_listener_t *l) {
+  __atomic_store_n(&l->dispatch_sleeping, 1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (dispatch_rings_empty(l) && l->dispatch_running) {
+    eventfd_t wakeups;
+    eventfd_read(l->dispatch_efd, &wakeups);
+  }
+  __atomic_store_n(&l->dispatch_sleeping, 0, __ATOMIC_RELAXED);
+}
+
+// 分发线程：轮询各环逐帧调用 user_cb，停止时先排空所有环
+static void *dispatch_loop(void *arg) {
+  net_listener_t *l = arg;
+  current_listener = l;
+  int idle = 0;
+
+  for (;;) {
+    int stopping = !l->dispatch_running;
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < l->dispatch_ring_count; i++)
+      n += drain_dispatch_ring(l, &l->dispatch_rings[i]);
+
+    if (n == 0) {
+      if (stopping)
+        break;
+      // 短暂自旋后阻塞等待，空闲时不占 CPU，也没有周期唤醒
+      if (++idle > 64) {
+        park_dispatcher(l);
+        idle = 0;
+      }
+      continue;
     }
+    idle = 0;
   }
+  return NULL;
+}
 
-  // 创建原始套接字
-  sockfd = create_raw_socket(ifname);
-  if (sockfd < 0) {
-    cleanup_cache();
-    return -1;
+static void free_dispatch_rings(net_listener_t *l) {
+  for (uint32_t i = 0; i < l->dispatch_ring_count; i++) {
+    free(l->dispatch_rings[i].slots);
+    l->dispatch_rings[i].slots = NULL;
+  }
+  if (l->dispatch_efd >= 0) {
+    close(l->dispatch_efd);
+    l->dispatch_efd = -1;
   }
+}
 
-  user_cb = cb;
-  running = 1;
+// 为 rings 个抓包线程各建一个分发环，并启动分发线程
+static int start_dispatcher(net_listener_t *l, uint32_t slots, uint32_t rings) {
+  // 槽数向上取整为 2 的幂
+  uint32_t n = 1;
+  while (n < slots)
+    n <<= 1;
 
-  // 创建监听线程
-  if (pthread_create(&listener_thread, NULL, listener_loop, NULL) != 0) {
-    perror("pthread_create");
-    running = 0;
-    cleanup_cache();
-    close(sockfd);
+  l->dispatch_ring_count = rings;
+  l->dispatch_sleeping = 0;
+  l->dispatch_efd = eventfd(0, EFD_CLOEXEC);
+  if (l->dispatch_efd < 0) {
+    perror("eventfd");
     return -1;
   }
+  for (uint32_t i = 0; i < rings; i++) {
+    dispatch_ring_t *ring = &l->dispatch_rings[i];
+    ring->slots = malloc((size_t)n * sizeof(dispatch_slot_t));
+    if (!ring->slots) {
+      LOG_ERROR("[net_listener] Failed to allocate dispatch ring\n");
+      free_dispatch_rings(l);
+      return -1;
+    }
+    ring->mask = n - 1;
+    ring->head = 0;
+    ring->tail = 0;
+    ring->high_water = 0;
+    ring->overflow = 0;
+  }
+  l->dispatch_running = 1;
 
-  LOG_INFO("[net_listener] Started on %s\n", ifname);
+  if (pthread_create(&l->dispatch_thread, NULL, dispatch_loop, l) != 0) {
+    perror("pthread_create");
+    l->dispatch_running = 0;
+    free_dispatch_rings(l);
+    return -1;
+  }
   return 0;
 }
 
-void net_listener_stop(const char *ifname) {
-  net_listener_stop_with_cache(ifname);
-}
-
-void net_listener_stop_with_cache(const char *ifname) {
-  if (!running)
+// 抓包线程退出后调用：等待分发线程排空并退出
+static void stop_dispatcher(net_listener_t *l) {
+  if (!l->dispatch_rings[0].slots)
     return;
-  
-  running = 0;
-  pthread_join(listener_thread, NULL);
-  set_promisc_mode(ifname, sockfd, 0);
-  close(sockfd);
-  sockfd = -1;
-  
-  // 如果有缓存回调，传递缓存数据
-  if (user_cache_cb && packet_cache && packet_count > 0) {
-    LOG_INFO("[net_listener] Delivering cached data: %u packets, %lu bytes\n", 
-         packet_count, total_bytes);
-    user_cache_cb(packet_cache, packet_count, total_bytes, packet_lengths);
+
+  l->dispatch_running = 0;
+  eventfd_write(l->dispatch_efd, 1);
+  pthread_join(l->dispatch_thread, NULL);
+  free_dispatch_rings(l);
+
+  uint32_t overflow = 0, high_water = 0;
+  for (uint32_t i = 0; i < l->dispatch_ring_count; i++) {
+    overflow += l->dispatch_rings[i].overflow;
+    if (l->dispatch_rings[i].high_water > high_water)
+      high_water = l->dispatch_rings[i].high_water;
   }
-  
-  cleanup_cache();
-  user_cache_cb = NULL;
-  LOG_INFO("[net_listener] Stopped\n");
+  if (overflow > 0)
+    LOG_WARN("[net_listener] Dispatch ring overflowed %u times (high water %u)\n",
+         overflow, high_water);
 }
 
-int net_listener_is_running(void) {
-  return running;
-}
+/*
+ * 事件驱动等待：每个抓包线程一个 epoll 实例，同时监听接收套接字和停止 eventfd。
+ * 停止时写入的 eventfd 在下次启动前不读出，始终可读，所有抓包线程都会被唤醒退出。
+ */
+static int open_wait_set(net_listener_t *l, int fd) {
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd < 0) {
+    perror("epoll_create1");
+    return -1;
+  }
 
-cache_stats_t net_listener_get_cache_stats(void) {
+  struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+  struct epoll_event stop_ev = { .events = EPOLLIN, .data.fd = l->stop_efd };
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0 ||
+      epoll_ctl(epfd, EPOLL_CTL_ADD, l->stop_efd, &stop_ev) < 0) {
+    perror("epoll_ctl");
+    close(epfd);
+    return -1;
+  }
+  if (l->listener_cfg.armed) {
+    struct epoll_event shot_ev = { .events = EPOLLIN, .data.fd = l->shot_efd };
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, l->shot_efd, &shot_ev) < 0) {
+      perror("epoll_ctl");
+      close(epfd);
+      return -1;
+    }
+  }
+  return epfd;
+}
+
+// 阻塞到有帧可读；返回 false 表示收到停止请求。分块模式下当前块有数据时最多等待
+// chunk_timeout_ms，超时说明突发已结束，把未写满的块交给回调。
+// 预备模式下调用本函数即说明套接字已读空，窗口正在关闭时到达收尾时刻即完成关闭
+static bool wait_for_frames(net_listener_t *l, int epfd) {
+  struct epoll_event ev[3];
+  int timeout = l->chunk_mode && l->stats.packet_count > 0 ? (int)l->listener_cfg.chunk_timeout_ms : -1;
+  if (__atomic_load_n(&l->shot_state, __ATOMIC_ACQUIRE) == SHOT_CLOSING) {
+    uint64_t now = monotonic_ns();
+    if (now >= l->shot_close_ns || __atomic_load_n(&l->shot_force_close, __ATOMIC_ACQUIRE))
+      finish_shot_window(l);
+    else
+      timeout = (int)((l->shot_close_ns - now + 999999) / 1000000);
+  }
+  int n = epoll_wait(epfd, ev, 3, timeout);
+  if (n == 0 && l->chunk_mode) {
+    if (l->stats.packet_count > 0) {
+      seq_write_begin(&l->stats.seq);
+      rotate_chunk(l);
+      seq_write_end(&l->stats.seq);
+    }
+    return true;
+  }
+  if (n < 0) {
+    if (errno != EINTR) {
+      perror("epoll_wait");
+      usleep(1000);
+    }
+    return l->running;
+  }
+  for (int i = 0; i < n; i++) {
+    if (ev[i].data.fd == l->stop_efd)
+      return false;
+    if (ev[i].data.fd == l->shot_efd) {
+      eventfd_t pending;
+      eventfd_read(l->shot_efd, &pending);
+    }
+  }
+  return true;
+}
+
+// 单帧处理：实时回调 + 写入缓存，ts 为接收时间（纳秒）
+static inline void handle_frame(net_listener_t *l, const uint8_t *data, int length, uint64_t ts) {
+  if (outside_shot_window(l, 1))
+    return;
+  if (l->pcap)
+    net_pcap_add(l->pcap, data, (uint32_t)length, ts);
+  if (l->shm)
+    net_shm_add(l->shm, data, (uint32_t)length, ts);
+  if (l->user_cb)
+    deliver_packet(l, &l->dispatch_rings[0], data, length);
+
+  if (l->stream)
+    add_packet_to_stream(l, data, length, ts);
+  else if (l->packet_cache)
+    add_packet_to_cache(l, data, length, ts);
+}
+
+// 读取内核统计并累加丢包数
+static void update_kernel_drops(net_listener_t *l, int sock) {
+  if (l->xdp_sock) {
+    // AF_XDP 统计为累计值
+    uint64_t drops = net_xdp_dropped(l->xdp_sock);
+    __atomic_store_n(&l->kernel_dropped_packets, (uint32_t)drops, __ATOMIC_RELAXED);
+    return;
+  }
+
+  // PACKET_STATISTICS 读取后内核计数清零
+  struct tpacket_stats_v3 st;
+  socklen_t len = sizeof(st);
+  memset(&st, 0, sizeof(st));
+  if (getsockopt(sock, SOL_PACKET, PACKET_STATISTICS, &st, &len) < 0)
+    return;
+
+  __atomic_add_fetch(&l->kernel_dropped_packets, st.tp_drops, __ATOMIC_RELAXED);
+}
+
+// 运行中每隔 stats_interval_ms 读取一次内核丢包统计，last 为该套接字上次读取的时刻。
+// 每次接收调用前检查一次（vDSO 取时间，不进内核），丢包正发生在抓包线程忙的时候
+static inline void poll_kernel_drops(net_listener_t *l, int sock, uint64_t *last) {
+  if (l->listener_cfg.stats_interval_ms == 0)
+    return;
+  uint64_t now = monotonic_ns();
+  if (now - *last < l->listener_cfg.stats_interval_ms * 1000000ULL)
+    return;
+  *last = now;
+  update_kernel_drops(l, sock);
+}
+
+/**
+ * @brief 打开 AF_XDP 抓包
+ * @details 加载只重定向 FPGA UDP 流的 XDP 程序并绑定 AF_XDP 套接字；
+ *          返回的普通套接字只用于混杂模式等网卡 ioctl。
+ */
+static int open_xdp_capture(net_listener_t *l, const char *ifname, const net_listener_config_t *cfg) {
+  int sock = socket(AF_INET, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    perror("socket");
+    return -1;
+  }
+
+  if (set_promisc_mode(ifname, sock, 1) < 0) {
+    close(sock);
+    return -1;
+  }
+
+  net_xdp_params_t params;
+  memset(&params, 0, sizeof(params));
+  params.queue_id = cfg->xdp_queue_id;
+  params.frame_count = cfg->xdp_frame_count;
+  params.frame_size = cfg->xdp_frame_size;
+  params.skb_mode = cfg->xdp_skb_mode;
+  params.busy_poll_us = cfg->busy_poll_us;
+  params.prefer_busy_poll = cfg->prefer_busy_poll;
+  params.udp_filter_enable = cfg->udp_filter_enable;
+  params.udp_filter = cfg->udp_filter;
+
+  l->xdp_sock = net_xdp_open(ifname, &params);
+  if (!l->xdp_sock) {
+    set_promisc_mode(ifname, sock, 0);
+    close(sock);
+    return -1;
+  }
+  return sock;
+}
+
+static void *listener_loop_recv(void *arg) {
+  net_listener_t *l = arg;
+  current_listener = l;
+  unsigned char buffer[NET_BUFFER_SIZE];
+  uint8_t control[NET_TS_CMSG_SPACE];
+  struct iovec iov = { .iov_base = buffer, .iov_len = sizeof(buffer) };
+  struct msghdr msg = { .msg_iov = &iov, .msg_iovlen = 1 };
+
+  uint64_t last_rx = 0;
+  int epfd = open_wait_set(l, l->sockfd);
+  if (epfd < 0)
+    return NULL;
+
+  uint64_t drops_polled = 0;
+  setup_capture_thread(l, -1);
+  while (l->running) {
+    poll_kernel_drops(l, l->sockfd, &drops_polled);
+    // recvmsg 与 recv 同为一次系统调用，额外带回 SO_TIMESTAMPNS 时间戳
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    int length = recvmsg(l->sockfd, &msg, MSG_DONTWAIT);
+    if (length > 0) {
+      uint64_t ts = cmsg_timestamp_ns(&msg);
+      record_wakeup_latency(l, ts);
+      handle_frame(l, buffer, length, ts);
+      if (l->listener_cfg.spin_us)
+        last_rx = monotonic_ns();
+    } else if (length < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      // 队列已空：spin 窗口内继续轮询，否则阻塞到新帧到达或收到停止请求
+      if (!in_spin_window(l, last_rx) && !wait_for_frames(l, epfd))
+        break;
+    } else if (length < 0 && errno != EINTR) {
+      usleep(1000);  // 只有真正出错才退避
+    }
+  }
+  close(epfd);
+  return NULL;
+}
+
+/**
+ * @brief recvmmsg 批量接收循环
+ * @details 每次系统调用最多接收 batch_size 帧。启用缓存时，各帧的 iovec 直接指向缓存中
+ *          按 NET_BUFFER_SIZE 步长预留的槽位，返回后把各帧向前紧凑排列（通常只移动几十到
+ *          几百字节的间隙），再在一次加锁内提交整批帧的长度和计数。
+ *          队列为空时阻塞在 epoll 上；batch_timeout_ms 为 0 时非阻塞取走已到达的帧，
+ *          否则被唤醒后在超时时间内尽量填满一批。
+ */
+static void *listener_loop_recvmmsg(void *arg) {
+  net_listener_t *l = arg;
+  current_listener = l;
+  uint32_t batch = l->listener_cfg.batch_size;
+  struct mmsghdr *msgs = calloc(batch, sizeof(struct mmsghdr));
+  struct iovec *iovs = calloc(batch, sizeof(struct iovec));
+  uint32_t *lens = calloc(batch, sizeof(uint32_t));
+  uint64_t *stamps = calloc(batch, sizeof(uint64_t));
+  uint8_t *controls = malloc((size_t)batch * NET_TS_CMSG_SPACE);
+  uint8_t *scratch = malloc((size_t)batch * NET_BUFFER_SIZE);
+  int epfd = open_wait_set(l, l->sockfd);
+  if (!msgs || !iovs || !lens || !stamps || !controls || !scratch || epfd < 0) {
+    LOG_ERROR("[net_listener] Failed to allocate recvmmsg batch buffers\n");
+    if (epfd >= 0)
+      close(epfd);
+    free(msgs);
+    free(iovs);
+    free(lens);
+    free(stamps);
+    free(controls);
+    free(scratch);
+    return NULL;
+  }
+
+  struct timespec timeout = {
+    .tv_sec = l->listener_cfg.batch_timeout_ms / 1000,
+    .tv_nsec = (l->listener_cfg.batch_timeout_ms % 1000) * 1000000L,
+  };
+  bool fill_batch = false;
+  uint64_t last_rx = 0;
+  uint64_t drops_polled = 0;
+
+  setup_capture_thread(l, -1);
+  while (l->running) {
+    poll_kernel_drops(l, l->sockfd, &drops_polled);
+    // 在缓存中为本批预留槽位，空间不足时接收到临时缓冲区并计为丢弃
+    uint8_t *base = scratch;
+    uint32_t slots = batch;
+    uint32_t base_used = 0;
+    bool to_cache = false;
+    bool index_full = false;  // 本批放不进缓存的原因：索引满（否则为数据区满）
+
+    if (l->packet_cache) {
+      apply_pending_clear(l);
+      uint32_t room = (l->cache_size - l->stats.cache_used) / NET_BUFFER_SIZE;
+      uint32_t index_room = l->max_packets - l->stats.packet_count;
+      if (l->chunk_mode && (room == 0 || index_room == 0)) {
+        seq_write_begin(&l->stats.seq);
+        rotate_chunk(l);
+        seq_write_end(&l->stats.seq);
+        room = (l->cache_size - l->stats.cache_used) / NET_BUFFER_SIZE;
+        index_room = l->max_packets - l->stats.packet_count;
+      }
+      base_used = l->stats.cache_used;
+
+      index_full = room > 0 && index_room == 0;
+      if (room > index_room)
+        room = index_room;
+      if (room > 0) {
+        to_cache = true;
+        base = l->packet_cache + base_used;
+        if (slots > room)
+          slots = room;
+      }
+    }
+
+    for (uint32_t i = 0; i < slots; i++) {
+      iovs[i].iov_base = base + (size_t)i * NET_BUFFER_SIZE;
+      iovs[i].iov_len = NET_BUFFER_SIZE;
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = controls + (size_t)i * NET_TS_CMSG_SPACE;
+      msgs[i].msg_hdr.msg_controllen = NET_TS_CMSG_SPACE;
+    }
+
+    // 通常非阻塞取走已到达的帧；刚被唤醒且配置了 batch_timeout_ms 时阻塞凑批
+    int n;
+    if (fill_batch)
+      n = recvmmsg(l->sockfd, msgs, slots, 0, &timeout);
+    else
+      n = recvmmsg(l->sockfd, msgs, slots, MSG_WAITFORONE | MSG_DONTWAIT, NULL);
+    fill_batch = false;
+    if (n <= 0) {
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && !in_spin_window(l, last_rx)) {
+        if (!wait_for_frames(l, epfd))
+          break;
+        fill_batch = l->listener_cfg.batch_timeout_ms > 0;
+      }
+      continue;  // 凑批超时、spin 窗口内无帧或被中断
+    }
+    if (outside_shot_window(l, n))
+      continue;
+
+    record_wakeup_latency(l, cmsg_timestamp_ns(&msgs[0].msg_hdr));
+    if (l->listener_cfg.spin_us)
+      last_rx = monotonic_ns();
+
+    // 回调并紧凑排列；payload_only 模式下只保留校验通过的帧的负载
+    uint32_t packed = 0;
+    uint32_t stored = 0;
+    uint32_t mismatched = 0;
+    for (int i = 0; i < n; i++) {
+      const uint8_t *src = iovs[i].iov_base;
+      uint32_t len = msgs[i].msg_len;
+      uint64_t ts = cmsg_timestamp_ns(&msgs[i].msg_hdr);
+      if (l->pcap)
+        net_pcap_add(l->pcap, src, len, ts);
+      if (l->shm)
+        net_shm_add(l->shm, src, len, ts);
+      if (l->user_cb)
+        deliver_packet(l, &l->dispatch_rings[0], src, len);
+
+      if (l->payload_only) {
+        if (!match_fpga_header(l, src, len)) {
+          mismatched++;
+          continue;
+        }
+        src += FPGA_UDP_HEADER_LEN;
+        len -= FPGA_UDP_HEADER_LEN;
+      }
+      uint8_t *dst = base + packed;
+      if (dst != src)
+        memmove(dst, src, len);
+      stamps[stored] = ts;
+      lens[stored++] = len;
+      packed += len;
+    }
+
+    // 整批只进入一次计数写区间
+    apply_pending_clear(l);
+    seq_write_begin(&l->stats.seq);
+    l->stats.batch_count++;
+    l->stats.batch_frames += n;
+    l->stats.header_mismatch_packets += mismatched;
+    if (l->packet_cache) {
+      for (uint32_t i = 0; i < stored; i++)
+        record_timestamp(l, stamps[i]);
+      if (to_cache && l->stats.cache_used < base_used) {
+        // 预留槽位后缓存被清空（shot_begin 或 clear_cache 请求）：把本批移到新的写入位置
+        memmove(l->packet_cache + l->stats.cache_used, base, packed);
+        base_used = l->stats.cache_used;
+      }
+      if (to_cache && l->stats.cache_used == base_used) {
+        uint64_t offset = l->stats.cache_used;
+        for (uint32_t i = 0; i < stored; i++) {
+          l->packet_lengths[l->stats.packet_count + i] = lens[i];
+          l->packet_offsets[l->stats.packet_count + i] = offset;
+          l->packet_timestamps[l->stats.packet_count + i] = stamps[i];
+          offset += lens[i];
+          if (l->stats.packet_count + i == 0)
+            l->uniform_length = lens[i];
+          else if (lens[i] != l->uniform_length)
+            l->uniform_length = 0;
+        }
+        l->stats.packet_count += stored;
+        l->stats.cache_used += packed;
+        l->stats.total_bytes += packed;
+        if (l->chunk_mode && stored > 0)
+          chunk_after_add(l, stored, stamps[0], stamps[stored - 1]);
+      } else {
+        l->stats.dropped_packets += stored;
+        if (index_full)
+          l->stats.index_full_drops += stored;
+        else
+          l->stats.cache_full_drops += stored;
+      }
+    } else if (l->stream) {
+      for (uint32_t i = 0; i < stored; i++)
+        record_timestamp(l, stamps[i]);
+    }
+    seq_write_end(&l->stats.seq);
+
+    // 流式写盘：本批已紧凑排列在临时缓冲区中
+    if (l->stream) {
+      uint64_t offset = 0;
+      for (uint32_t i = 0; i < stored; i++) {
+        net_stream_add(l->stream, base + offset, lens[i], stamps[i]);
+        offset += lens[i];
+      }
+    }
+  }
+
+  close(epfd);
+  free(msgs);
+  free(iovs);
+  free(lens);
+  free(stamps);
+  free(controls);
+  free(scratch);
+  return NULL;
+}
+
+// 处理一个内核已提交的块并归还内核；块尚未提交返回 false
+static bool process_ring_block(net_listener_t *l, uint32_t *block_idx) {
+  struct tpacket_block_desc *pbd =
+    (struct tpacket_block_desc *)(l->ring_map + (size_t)*block_idx * l->listener_cfg.ring_block_size);
+  uint32_t status = __atomic_load_n(&pbd->hdr.bh1.block_status, __ATOMIC_ACQUIRE);
+  if (!(status & TP_STATUS_USER))
+    return false;
+
+  if (status & TP_STATUS_LOSING)
+    update_kernel_drops(l, l->sockfd);
+
+  uint32_t num_pkts = pbd->hdr.bh1.num_pkts;
+  struct tpacket3_hdr *ppd =
+    (struct tpacket3_hdr *)((uint8_t *)pbd + pbd->hdr.bh1.offset_to_first_pkt);
+
+  // 块内首帧要等块写满或超时才交给用户态，按帧采样会把块的填充时间和超时算进去。
+  // 只对写满提交的块采样：块在最后一帧到达时提交，从该帧时间戳量起才是唤醒延迟；
+  // 超时提交的块不知道何时提交，不采样
+  if (num_pkts > 0 && !(status & TP_STATUS_BLK_TMO))
+    record_wakeup_latency(l, (uint64_t)pbd->hdr.bh1.ts_last_pkt.ts_sec * 1000000000ULL +
+                             pbd->hdr.bh1.ts_last_pkt.ts_nsec);
+  for (uint32_t i = 0; i < num_pkts; i++) {
+    handle_frame(l, (uint8_t *)ppd + ppd->tp_mac, ppd->tp_snaplen,
+                 (uint64_t)ppd->tp_sec * 1000000000ULL + ppd->tp_nsec);
+    ppd = (struct tpacket3_hdr *)((uint8_t *)ppd + ppd->tp_next_offset);
+  }
+
+  __atomic_store_n(&pbd->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+  *block_idx = (*block_idx + 1) % l->listener_cfg.ring_block_count;
+  return true;
+}
+
+/**
+ * @brief TPACKET_V3 接收循环
+ * @details 帧直接从环形缓冲区交给回调和缓存，无需中间拷贝到栈缓冲区。
+ *          块处理完成后将 block_status 置回 TP_STATUS_KERNEL 归还内核。
+ *          停止时 stop 已等过块超时，退出前处理完内核已提交的块，采集末尾未写满的块不丢。
+ */
+static void *listener_loop_mmap(void *arg) {
+  net_listener_t *l = arg;
+  current_listener = l;
+  uint32_t block_idx = 0;
+  uint64_t last_rx = 0;
+  uint64_t drops_polled = 0;
+  int epfd = open_wait_set(l, l->sockfd);
+  if (epfd < 0)
+    return NULL;
+
+  setup_capture_thread(l, -1);
+  while (l->running) {
+    poll_kernel_drops(l, l->sockfd, &drops_polled);
+    if (!process_ring_block(l, &block_idx)) {
+      // spin 窗口内直接轮询块状态（共享内存，无系统调用），否则阻塞到块提交或停止
+      if (in_spin_window(l, last_rx))
+        cpu_relax();
+      else if (!wait_for_frames(l, epfd))
+        break;
+      continue;
+    }
+    if (l->listener_cfg.spin_us)
+      last_rx = monotonic_ns();
+  }
+
+  // 最多处理一圈，停止后仍在到达的帧不再等待
+  for (uint32_t i = 0; i < l->listener_cfg.ring_block_count; i++) {
+    if (!process_ring_block(l, &block_idx))
+      break;
+  }
+  close(epfd);
+  return NULL;
+}
+
+// AF_XDP 没有内核接收时间戳，在用户态按帧读取 CLOCK_REALTIME（vDSO，无系统调用）
+static void handle_xdp_frame(const uint8_t *data, int length, void *ctx) {
+  net_listener_t *l = ctx;
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  handle_frame(l, data, length, timespec_to_ns(&now));
+}
+
+/**
+ * @brief AF_XDP 接收循环
+ * @details 帧直接从 UMEM 交给回调和缓存，处理后 UMEM 帧立即归还 FILL 环。
+ *          用户态时间戳不反映内核收包时刻，因此不计入唤醒延迟直方图。
+ */
+static void *listener_loop_xdp(void *arg) {
+  net_listener_t *l = arg;
+  current_listener = l;
+  uint64_t last_rx = 0;
+  uint64_t drops_polled = 0;
+  int epfd = open_wait_set(l, net_xdp_fd(l->xdp_sock));
+  if (epfd < 0)
+    return NULL;
+
+  setup_capture_thread(l, -1);
+  while (l->running) {
+    poll_kernel_drops(l, -1, &drops_polled);
+    int n = net_xdp_receive(l->xdp_sock, handle_xdp_frame, l, 0);
+    if (n < 0) {
+      perror("net_xdp_receive");
+      usleep(1000);
+    } else if (n > 0) {
+      if (l->listener_cfg.spin_us)
+        last_rx = monotonic_ns();
+    } else if (!in_spin_window(l, last_rx) && !wait_for_frames(l, epfd)) {
+      break;
+    }
+  }
+  close(epfd);
+  return NULL;
+}
+
+// 回放按原始间隔等待，长间隔分段睡眠以便及时响应停止
+static void replay_wait_until(net_listener_t *l, uint64_t deadline_ns) {
+  for (;;) {
+    uint64_t now = monotonic_ns();
+    if (now >= deadline_ns || !l->running)
+      return;
+    uint64_t wait = deadline_ns - now;
+    if (wait > 10000000ULL)
+      wait = 10000000ULL;
+    struct timespec ts = { .tv_sec = 0, .tv_nsec = (long)wait };
+    nanosleep(&ts, NULL);
+  }
+}
+
+/**
+ * @brief pcap/pcapng 回放循环
+ * @details 帧按文件顺序经 handle_frame 进入与网卡采集相同的实时回调、缓存和写盘路径，
+ *          缓存时间戳为文件中的原始时间。帧长按网卡接收缓冲区截断为 NET_BUFFER_SIZE。
+ *          文件读完后线程退出，缓存仍在 stop 时交付。
+ */
+static void *listener_loop_replay(void *arg) {
+  net_listener_t *l = arg;
+  current_listener = l;
+  uint64_t start_ns = monotonic_ns();
+  uint64_t first_ts = 0;
+  uint64_t frames = 0;
+
+  setup_capture_thread(l, -1);
+  while (l->running) {
+    const uint8_t *data;
+    uint32_t length;
+    uint64_t ts;
+    int ret = net_pcap_reader_next(l->replay, &data, &length, &ts);
+    if (ret < 0)
+      LOG_WARN("[net_listener] Replay file is truncated or corrupt, stopping replay\n");
+    if (ret <= 0) {
+      LOG_INFO("[net_listener] Replay finished: %llu frames\n", (unsigned long long)frames);
+      // 与 shot_end 在同一把锁下交接：此后不再有帧写入，正在关闭的窗口由本线程关闭
+      pthread_mutex_lock(&l->cache_mutex);
+      __atomic_store_n(&l->replay_done, true, __ATOMIC_RELEASE);
+      pthread_mutex_unlock(&l->cache_mutex);
+      finish_shot_window(l);
+      break;
+    }
+
+    if (l->listener_cfg.udp_filter_enable && !match_udp_filter(&l->listener_cfg.udp_filter, data, length))
+      continue;
+    if (length > NET_BUFFER_SIZE)
+      length = NET_BUFFER_SIZE;
+    if (l->listener_cfg.replay_timing && ts) {
+      if (first_ts == 0)
+        first_ts = ts;
+      if (ts > first_ts)
+        replay_wait_until(l, start_ns + (ts - first_ts));
+    }
+    handle_frame(l, data, (int)length, ts);
+    frames++;
+  }
+  return NULL;
+}
+
+/*
+ * PACKET_FANOUT 多核接收
+ *
+ * fanout_workers 个套接字加入同一个 fanout 组，每个套接字由一个绑核 worker 用 recvmmsg
+ * 批量接收。持久缓存区域（数据和索引）按 worker 均分为互不重叠的分片，worker 只写自己的
+ * 分片，接收路径上不加锁。停止时按接收时间戳把各分片的索引归并为一个有序索引。
+ */
+
+// 写入 worker 自己的缓存分片（无锁，调用者处于 worker 的计数写区间）
+static inline void shard_add(net_listener_t *l, fanout_worker_t *w, const uint8_t *data, uint32_t length, uint64_t ts) {
+  if (l->payload_only) {
+    if (!match_fpga_header(l, data, length)) {
+      w->mismatched++;
+      return;
+    }
+    data += FPGA_UDP_HEADER_LEN;
+    length -= FPGA_UDP_HEADER_LEN;
+  }
+  if (w->data_used + length > w->data_cap) {
+    w->cache_full++;
+    return;
+  }
+  if (w->count >= w->index_cap) {
+    w->index_full++;
+    return;
+  }
+
+  uint32_t idx = w->index_base + w->count;
+  uint64_t offset = w->data_base + w->data_used;
+  memcpy(l->packet_cache + offset, data, length);
+  l->packet_lengths[idx] = length;
+  l->packet_offsets[idx] = offset;
+  l->packet_timestamps[idx] = ts;
+  if (w->count == 0)
+    w->first_ts = ts;
+  w->last_ts = ts;
+  w->data_used += length;
+  w->count++;
+}
+
+// 清空 worker 自己的分片（调用者处于 worker 的计数写区间，或 worker 已退出）
+static void reset_shard(fanout_worker_t *w, uint32_t gen) {
+  w->data_used = 0;
+  w->count = 0;
+  w->cache_full = 0;
+  w->index_full = 0;
+  w->mismatched = 0;
+  w->batches = 0;
+  w->frames = 0;
+  w->first_ts = 0;
+  w->last_ts = 0;
+  w->clear_gen = gen;
+}
+
+static void *fanout_worker_loop(void *arg) {
+  fanout_worker_t *w = arg;
+  net_listener_t *l = w->l;
+  current_listener = l;
+  uint32_t batch = l->listener_cfg.batch_size;
+  struct mmsghdr *msgs = calloc(batch, sizeof(struct mmsghdr));
+  struct iovec *iovs = calloc(batch, sizeof(struct iovec));
+  uint8_t *controls = malloc((size_t)batch * NET_TS_CMSG_SPACE);
+  uint8_t *scratch = malloc((size_t)batch * NET_BUFFER_SIZE);
+  int epfd = open_wait_set(l, w->sock);
+  if (!msgs || !iovs || !controls || !scratch || epfd < 0) {
+    LOG_ERROR("[net_listener] Failed to allocate fanout worker buffers\n");
+    if (epfd >= 0)
+      close(epfd);
+    free(msgs);
+    free(iovs);
+    free(controls);
+    free(scratch);
+    return NULL;
+  }
+
+  setup_capture_thread(l, (int)w->index);
+  uint64_t last_rx = 0;
+  uint64_t drops_polled = 0;
+
+  while (l->running) {
+    poll_kernel_drops(l, w->sock, &drops_polled);
+    for (uint32_t i = 0; i < batch; i++) {
+      iovs[i].iov_base = scratch + (size_t)i * NET_BUFFER_SIZE;
+      iovs[i].iov_len = NET_BUFFER_SIZE;
+      memset(&msgs[i].msg_hdr, 0, sizeof(msgs[i].msg_hdr));
+      msgs[i].msg_hdr.msg_iov = &iovs[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+      msgs[i].msg_hdr.msg_control = controls + (size_t)i * NET_TS_CMSG_SPACE;
+      msgs[i].msg_hdr.msg_controllen = NET_TS_CMSG_SPACE;
+    }
+
+    int n = recvmmsg(w->sock, msgs, batch, MSG_WAITFORONE | MSG_DONTWAIT, NULL);
+    if (n <= 0) {
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) &&
+          !in_spin_window(l, last_rx) && !wait_for_frames(l, epfd))
+        break;
+      continue;  // spin 窗口内无帧或被中断
+    }
+
+    record_wakeup_latency(l, cmsg_timestamp_ns(&msgs[0].msg_hdr));
+    if (l->listener_cfg.spin_us)
+      last_rx = monotonic_ns();
+    for (int i = 0; i < n; i++) {
+      if (l->user_cb)
+        deliver_packet(l, w->ring, iovs[i].iov_base, msgs[i].msg_len);
+    }
+    // 运行中 clear_cache：l->stats 只由 worker 0 写，各分片由各自的 worker 清空
+    if (w->index == 0)
+      apply_pending_clear(l);
+    uint32_t gen = __atomic_load_n(&l->clear_gen, __ATOMIC_ACQUIRE);
+    seq_write_begin(&w->seq);
+    if (gen != w->clear_gen)
+      reset_shard(w, gen);
+    w->batches++;
+    w->frames += n;
+    if (l->packet_cache) {
+      for (int i = 0; i < n; i++)
+        shard_add(l, w, iovs[i].iov_base, msgs[i].msg_len, cmsg_timestamp_ns(&msgs[i].msg_hdr));
+    }
+    seq_write_end(&w->seq);
+  }
+
+  close(epfd);
+  free(msgs);
+  free(iovs);
+  free(controls);
+  free(scratch);
+  return NULL;
+}
+
+// 组号已被其他网卡或其他类型的组占用时，最多换这么多个组号重试
+#define NET_FANOUT_GROUP_RETRIES 16
+
+// 进程内各实例依次取不同的组号，与 pid 混合以减少与其他进程的组冲突
+static uint32_t next_fanout_group(void) {
+  static uint32_t seq;
+  uint32_t n = __atomic_fetch_add(&seq, 1, __ATOMIC_RELAXED);
+  return ((uint32_t)getpid() + n * 0x9E37u) & 0xffff;
+}
+
+// 把已绑定的套接字加入 fanout 组，并丢弃加入前收到的帧（这些帧组内其他套接字也会收到）。
+// 失败时保留 setsockopt 的 errno
+static int join_fanout(int sock, uint32_t group, net_fanout_type_t type) {
+  static const int types[] = { PACKET_FANOUT_LB, PACKET_FANOUT_CPU, PACKET_FANOUT_HASH };
+  int arg = (int)(group & 0xffff) | (types[type] << 16);
+
+  if (setsockopt(sock, SOL_PACKET, PACKET_FANOUT, &arg, sizeof(arg)) < 0)
+    return -1;
+
+  uint8_t buf[NET_BUFFER_SIZE];
+  while (recv(sock, buf, sizeof(buf), MSG_DONTWAIT) > 0)
+    ;
+  return 0;
+}
+
+/**
+ * @brief 打开 fanout 套接字并划分缓存分片
+ * @details worker 0 使用已创建的 sockfd，其余 worker 各自新建套接字，全部加入同一个组。
+ *          组号按实例分配；worker 0 加入时组号已被占用（EINVAL/EBUSY）则换组号重试。
+ */
+static int open_fanout(net_listener_t *l, const char *ifname, uint32_t workers) {
+  uint32_t group = next_fanout_group();
+
+  memset(l->fanout_workers, 0, sizeof(l->fanout_workers));
+  for (uint32_t k = 0; k < workers; k++) {
+    fanout_worker_t *w = &l->fanout_workers[k];
+    w->l = l;
+    w->index = k;
+    w->clear_gen = l->clear_gen;
+    w->sock = k == 0 ? l->sockfd : create_raw_socket(l, ifname, &l->listener_cfg);
+    w->ring = &l->dispatch_rings[k];
+    int ret = w->sock < 0 ? -1 : join_fanout(w->sock, group, l->listener_cfg.fanout_type);
+    for (int retry = 0; ret < 0 && k == 0 && (errno == EINVAL || errno == EBUSY) &&
+                        retry < NET_FANOUT_GROUP_RETRIES; retry++) {
+      group = next_fanout_group();
+      ret = join_fanout(w->sock, group, l->listener_cfg.fanout_type);
+    }
+    if (ret < 0) {
+      if (w->sock >= 0)
+        perror("setsockopt PACKET_FANOUT");
+      for (uint32_t j = 1; j <= k; j++)
+        if (l->fanout_workers[j].sock >= 0)
+          close(l->fanout_workers[j].sock);
+      return -1;
+    }
+
+    if (l->packet_cache) {
+      uint32_t data_cap = (l->cache_size / workers) & ~63u;
+      w->data_base = (uint64_t)data_cap * k;
+      w->data_cap = data_cap;
+      w->index_cap = l->max_packets / workers;
+      w->index_base = w->index_cap * k;
+    }
+  }
+  l->fanout_count = workers;
+  return 0;
+}
+
+// 启动 worker 1..K-1（worker 0 运行在 listener_thread 中）
+static int start_fanout_threads(net_listener_t *l) {
+  l->fanout_started = 0;
+  for (uint32_t k = 1; k < l->fanout_count; k++) {
+    if (pthread_create(&l->fanout_workers[k].thread, NULL, fanout_worker_loop,
+                       &l->fanout_workers[k]) != 0)
+      return -1;
+    l->fanout_started++;
+  }
+  return 0;
+}
+
+// listener_thread 退出后调用：等待其余 worker 退出，汇总内核丢包并关闭额外套接字
+static void stop_fanout_threads(net_listener_t *l) {
+  for (uint32_t k = 1; k <= l->fanout_started; k++)
+    pthread_join(l->fanout_workers[k].thread, NULL);
+  l->fanout_started = 0;
+  for (uint32_t k = 1; k < l->fanout_count; k++) {
+    update_kernel_drops(l, l->fanout_workers[k].sock);
+    close(l->fanout_workers[k].sock);
+  }
+}
+
+/**
+ * @brief 按接收时间戳归并各分片的索引
+ * @details 各分片内部已按到达顺序排列，每次取各分片队首中时间戳最小者（K 路归并）。
+ *          数据留在原分片中不移动，归并结果写回索引数组开头；分片之间有空隙，
+ *          因此不提供固定步长。
+ */
+static void merge_fanout_shards(net_listener_t *l) {
+  uint32_t total = 0;
+  uint32_t cursor[NET_FANOUT_MAX_WORKERS] = { 0 };
+
+  // worker 退出前没再收到帧、未来得及执行的清空请求
+  for (uint32_t k = 0; k < l->fanout_count; k++) {
+    if (l->fanout_workers[k].clear_gen != l->clear_gen)
+      reset_shard(&l->fanout_workers[k], l->clear_gen);
+  }
+
+  seq_write_begin(&l->stats.seq);
+  for (uint32_t k = 0; k < l->fanout_count; k++) {
+    fanout_worker_t *w = &l->fanout_workers[k];
+    total += w->count;
+    l->stats.cache_used += w->data_used;
+    l->stats.dropped_packets += w->cache_full + w->index_full;
+    l->stats.cache_full_drops += w->cache_full;
+    l->stats.index_full_drops += w->index_full;
+    l->stats.header_mismatch_packets += w->mismatched;
+    l->stats.batch_count += w->batches;
+    l->stats.batch_frames += w->frames;
+  }
+
+  uint32_t *lens = malloc((size_t)total * sizeof(uint32_t) + 1);
+  uint64_t *offs = malloc((size_t)total * sizeof(uint64_t) + 1);
+  uint64_t *stamps = malloc((size_t)total * sizeof(uint64_t) + 1);
+  if (!lens || !offs || !stamps) {
+    // 内存不足时退化为按分片顺序拼接（目标下标不大于源下标，可原地前移）
+    LOG_ERROR("[net_listener] Failed to allocate fanout merge index, shards left unordered\n");
+    uint32_t out = 0;
+    for (uint32_t k = 0; k < l->fanout_count; k++) {
+      fanout_worker_t *w = &l->fanout_workers[k];
+      memmove(l->packet_lengths + out, l->packet_lengths + w->index_base, w->count * sizeof(uint32_t));
+      memmove(l->packet_offsets + out, l->packet_offsets + w->index_base, w->count * sizeof(uint64_t));
+      memmove(l->packet_timestamps + out, l->packet_timestamps + w->index_base, w->count * sizeof(uint64_t));
+      out += w->count;
+    }
+  } else {
+    for (uint32_t out = 0; out < total; out++) {
+      uint32_t best = 0;
+      uint64_t best_ts = UINT64_MAX;
+      for (uint32_t k = 0; k < l->fanout_count; k++) {
+        fanout_worker_t *w = &l->fanout_workers[k];
+        if (cursor[k] < w->count && l->packet_timestamps[w->index_base + cursor[k]] < best_ts) {
+          best = k;
+          best_ts = l->packet_timestamps[w->index_base + cursor[k]];
+        }
+      }
+      uint32_t idx = l->fanout_workers[best].index_base + cursor[best]++;
+      lens[out] = l->packet_lengths[idx];
+      offs[out] = l->packet_offsets[idx];
+      stamps[out] = l->packet_timestamps[idx];
+    }
+    memcpy(l->packet_lengths, lens, (size_t)total * sizeof(uint32_t));
+    memcpy(l->packet_offsets, offs, (size_t)total * sizeof(uint64_t));
+    memcpy(l->packet_timestamps, stamps, (size_t)total * sizeof(uint64_t));
+  }
+  free(lens);
+  free(offs);
+  free(stamps);
+
+  for (uint32_t i = 0; i < total; i++) {
+    record_timestamp(l, l->packet_timestamps[i]);
+    l->stats.total_bytes += l->packet_lengths[i];
+  }
+  l->stats.packet_count = total;
+  l->uniform_length = 0;
+  seq_write_end(&l->stats.seq);
+}
+
+// NetCacheCallback 要求数据按包顺序连续存放，fanout 分片按归并顺序拷贝到持久区域中预留的拼接区
+static void deliver_gathered_cache(net_listener_t *l) {
+  uint8_t *buf = l->gather_cache;
+  if (!buf) {
+    LOG_ERROR("[net_listener] No gather area reserved for fanout cache callback\n");
+    return;
+  }
+
+  uint64_t off = 0;
+  for (uint32_t i = 0; i < l->stats.packet_count; i++) {
+    memcpy(buf + off, l->packet_cache + l->packet_offsets[i], l->packet_lengths[i]);
+    off += l->packet_lengths[i];
+  }
+  l->user_cache_cb(buf, l->stats.packet_count, l->stats.total_bytes, l->packet_lengths);
+}
+
+// 关闭采集源：恢复混杂模式，释放接收环、AF_XDP 套接字、原始套接字和回放文件
+static void close_capture_source(net_listener_t *l) {
+  if (l->sockfd >= 0)
+    set_promisc_mode(l->ifname, l->sockfd, 0);
+  teardown_packet_ring(l);
+  net_xdp_close(l->xdp_sock);
+  l->xdp_sock = NULL;
+  if (l->sockfd >= 0)
+    close(l->sockfd);
+  l->sockfd = -1;
+  net_pcap_reader_close(l->replay);
+  l->replay = NULL;
+}
+
+// 把缓存交给缓存回调，回调在调用 stop 或 shot_end 的线程中执行
+static void deliver_cache(net_listener_t *l) {
+  if (!l->packet_cache || l->stats.packet_count == 0)
+    return;
+
+  net_listener_t *prev = current_listener;
+  current_listener = l;
+  LOG_INFO("[net_listener] Delivering cached data: %u packets, %lu bytes\n", 
+       l->stats.packet_count, l->stats.total_bytes);
+  if (l->user_cache_view_cb) {
+    net_cache_view_t view = {
+      .data = l->packet_cache,
+      .packet_count = l->stats.packet_count,
+      .total_bytes = l->stats.total_bytes,
+      .packet_lengths = l->packet_lengths,
+      .packet_offsets = l->packet_offsets,
+      .packet_timestamps = l->packet_timestamps,
+      .stride = l->uniform_length,
+    };
+    l->user_cache_view_cb(&view);
+  }
+  if (l->user_cache_cb && l->fanout_count > 0)
+    deliver_gathered_cache(l);
+  else if (l->user_cache_cb)
+    l->user_cache_cb(l->packet_cache, l->stats.packet_count, l->stats.total_bytes, l->packet_lengths);
+  current_listener = prev;
+}
+
+void net_listener_config_init(net_listener_config_t *cfg) {
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->mode = NET_CAPTURE_RECV;
+  cfg->ring_block_size = NET_RING_DEFAULT_BLOCK_SIZE;
+  cfg->ring_block_count = NET_RING_DEFAULT_BLOCK_COUNT;
+  cfg->ring_frame_size = NET_RING_DEFAULT_FRAME_SIZE;
+  cfg->ring_block_timeout_ms = NET_RING_DEFAULT_TIMEOUT_MS;
+  cfg->dispatch_ring_slots = NET_DISPATCH_DEFAULT_SLOTS;
+  cfg->batch_size = NET_BATCH_DEFAULT_SIZE;
+  cfg->batch_timeout_ms = NET_BATCH_DEFAULT_TIMEOUT_MS;
+  cfg->xdp_queue_id = 0;
+  cfg->xdp_frame_count = NET_XDP_DEFAULT_FRAME_COUNT;
+  cfg->xdp_frame_size = NET_XDP_DEFAULT_FRAME_SIZE;
+  cfg->chunk_size = NET_CHUNK_DEFAULT_SIZE;
+  cfg->chunk_count = NET_CHUNK_DEFAULT_COUNT;
+  cfg->chunk_timeout_ms = NET_CHUNK_DEFAULT_TIMEOUT_MS;
+  cfg->stream_block_size = NET_STREAM_DEFAULT_BLOCK_SIZE;
+  cfg->stream_queue_depth = NET_STREAM_DEFAULT_QUEUE_DEPTH;
+  cfg->stats_interval_ms = NET_STATS_DEFAULT_INTERVAL_MS;
+}
+
+net_listener_t *net_listener_ctx_create(void) {
+  // 计数和 fanout worker 按缓存行对齐，malloc 不保证 64 字节对齐
+  net_listener_t *l = aligned_alloc(64, sizeof(*l));
+  if (!l) {
+    LOG_ERROR("[net_listener] Failed to allocate listener\n");
+    return NULL;
+  }
+  *l = (net_listener_t)NET_LISTENER_INITIALIZER;
+  return l;
+}
+
+int net_listener_ctx_start(net_listener_t *l, const char *ifname, NetPacketCallback cb,
+                           NetCacheCallback cache_cb, uint32_t cache_size,
+                           const net_listener_config_t *cfg) {
+  LOG_INFO("[net_listener] Starting on %s...\n", ifname);
+  if (l->running)
+    return 0;
+
+  if (cfg)
+    l->listener_cfg = *cfg;
+  else
+    net_listener_config_init(&l->listener_cfg);
+  snprintf(l->ifname, sizeof(l->ifname), "%s", ifname);
+  l->user_data = l->listener_cfg.user_data;
+
+  // 停止 eventfd 跨多次启动复用，启动前读出上次停止留下的计数
+  if (l->stop_efd < 0) {
+    l->stop_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (l->stop_efd < 0) {
+      perror("eventfd");
+      return -1;
+    }
+  }
+  eventfd_t pending;
+  eventfd_read(l->stop_efd, &pending);
+
+  // 预备模式按窗口交付内存缓存，与 fanout、分块和流式写盘互斥
+  if (l->listener_cfg.armed) {
+    if (l->listener_cfg.fanout_workers > 1 || l->listener_cfg.chunk_cb || l->listener_cfg.stream_path) {
+      LOG_WARN("[net_listener] Armed mode does not support fanout, chunk or stream capture, disabling them\n");
+      l->listener_cfg.fanout_workers = 0;
+      l->listener_cfg.chunk_cb = NULL;
+      l->listener_cfg.stream_path = NULL;
+    }
+    if (l->shot_efd < 0) {
+      l->shot_efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+      if (l->shot_efd < 0) {
+        perror("eventfd");
+        return -1;
+      }
+    }
+    eventfd_read(l->shot_efd, &pending);
+  }
+  l->shot_state = SHOT_IDLE;
+  l->shot_force_close = false;
+  l->shot_seq = 0;
+  l->outside_window_packets = 0;
+
+  // fanout 模式下各 worker 固定使用 recvmmsg；AF_XDP 按队列绑定，不支持 fanout
+  l->fanout_count = 0;
+  if (l->listener_cfg.fanout_workers > 1) {
+    if (l->listener_cfg.stream_path || l->listener_cfg.pcap_path || l->listener_cfg.shm_name ||
+        l->listener_cfg.chunk_cb) {
+      LOG_WARN("[net_listener] PACKET_FANOUT is not available with streaming, pcapng, shared memory or chunk mode, "
+               "using one socket\n");
+      l->listener_cfg.fanout_workers = 0;
+    } else if (l->listener_cfg.mode == NET_CAPTURE_REPLAY) {
+      l->listener_cfg.fanout_workers = 0;
+    } else if (l->listener_cfg.mode == NET_CAPTURE_XDP) {
+      LOG_WARN("[net_listener] PACKET_FANOUT is not available with AF_XDP, using one queue\n");
+      l->listener_cfg.fanout_workers = 0;
+    } else {
+      l->listener_cfg.mode = NET_CAPTURE_RECVMMSG;
+      if (l->listener_cfg.fanout_workers > NET_FANOUT_MAX_WORKERS)
+        l->listener_cfg.fanout_workers = NET_FANOUT_MAX_WORKERS;
+      // 多个抓包线程并发时实时回调必须经分发线程串行调用
+      if (cb && l->listener_cfg.dispatch_ring_slots == 0)
+        l->listener_cfg.dispatch_ring_slots = NET_DISPATCH_DEFAULT_SLOTS;
+    }
+  }
+
+  l->payload_only = l->listener_cfg.payload_only;
+  if (l->payload_only)
+    fpga_build_udp_header(&l->listener_cfg.udp_filter, l->payload_template);
+
+  // 初始化缓存（如果启用了缓存功能）
+  l->user_cache_cb = cache_cb;
+  l->user_cache_view_cb = l->listener_cfg.cache_view_cb;
+  l->user_chunk_cb = l->listener_cfg.stream_path ? NULL : l->listener_cfg.chunk_cb;
+  if (l->user_chunk_cb) {
+    if (init_chunks(l) < 0) {
+      LOG_ERROR("[net_listener] Chunk initialization failed\n");
+      cleanup_cache(l);
+      return -1;
+    }
+  } else if ((cache_cb || l->user_cache_view_cb) && cache_size > 0 && !l->listener_cfg.stream_path) {
+    if (init_cache(l, cache_size, cache_cb && l->listener_cfg.fanout_workers > 1) < 0) {
+      LOG_ERROR("[net_listener] Cache initialization failed\n");
+      return -1;
+    }
+  }
+
+  // 流式写盘：帧写入文件，不进入内存缓存，缓存回调不会被调用
+  memset(&l->stream_final_stats, 0, sizeof(l->stream_final_stats));
+  if (l->listener_cfg.stream_path) {
+    reset_counters(l);
+    l->stream = net_stream_open(l->listener_cfg.stream_path, l->listener_cfg.stream_block_size,
+                             l->listener_cfg.stream_queue_depth);
+    if (!l->stream) {
+      LOG_ERROR("[net_listener] Stream initialization failed\n");
+      return -1;
+    }
+  }
+
+  // pcapng 写盘：与缓存、流式写盘并行，帧由后台线程写出
+  memset(&l->pcap_final_stats, 0, sizeof(l->pcap_final_stats));
+  if (l->listener_cfg.pcap_path) {
+    uint32_t size = l->listener_cfg.pcap_buffer_size ? l->listener_cfg.pcap_buffer_size : NET_PCAP_DEFAULT_BUFFER_SIZE;
+    l->pcap = net_pcap_open(l->listener_cfg.pcap_path, ifname, size);
+    if (!l->pcap) {
+      LOG_ERROR("[net_listener] pcapng writer initialization failed\n");
+      cleanup_cache(l);
+      close_writers(l);
+      return -1;
+    }
+  }
+
+  // 共享内存帧环：单生产者，抓包线程直接写槽
+  memset(&l->shm_final_stats, 0, sizeof(l->shm_final_stats));
+  if (l->listener_cfg.shm_name) {
+    uint32_t slots = l->listener_cfg.shm_slot_count ? l->listener_cfg.shm_slot_count : NET_SHM_DEFAULT_SLOT_COUNT;
+    l->shm = net_shm_open(l->listener_cfg.shm_name, slots, NET_BUFFER_SIZE);
+    if (!l->shm) {
+      LOG_ERROR("[net_listener] Shared memory ring initialization failed\n");
+      cleanup_cache(l);
+      close_writers(l);
+      return -1;
+    }
+  }
+
+  // 创建采集源：原始套接字、AF_XDP 套接字或回放文件
+  l->replay_done = false;
+  if (l->listener_cfg.mode == NET_CAPTURE_REPLAY) {
+    l->sockfd = -1;
+    l->replay = l->listener_cfg.replay_path ? net_pcap_reader_open(l->listener_cfg.replay_path) : NULL;
+    if (!l->replay)
+      LOG_ERROR("[net_listener] Cannot open replay file %s\n",
+                l->listener_cfg.replay_path ? l->listener_cfg.replay_path : "(null)");
+  } else if (l->listener_cfg.mode == NET_CAPTURE_XDP) {
+    l->sockfd = open_xdp_capture(l, ifname, &l->listener_cfg);
+  } else {
+    l->sockfd = create_raw_socket(l, ifname, &l->listener_cfg);
+  }
+  if (l->sockfd < 0 && !l->replay) {
+    cleanup_cache(l);
+    close_writers(l);
+    return -1;
+  }
+
+  uint32_t producers = l->listener_cfg.fanout_workers > 1 ? l->listener_cfg.fanout_workers : 1;
+  if (producers > 1 && open_fanout(l, ifname, producers) < 0) {
+    close_capture_source(l);
+    cleanup_cache(l);
+    close_writers(l);
+    return -1;
+  }
+
+  l->user_cb = cb;
+  memset(l->dispatch_rings, 0, sizeof(l->dispatch_rings));
+  l->dispatch_ring_count = 0;
+  if (cb && l->listener_cfg.dispatch_ring_slots > 0 &&
+      start_dispatcher(l, l->listener_cfg.dispatch_ring_slots, producers) < 0) {
+    for (uint32_t k = 1; k < l->fanout_count; k++)
+      close(l->fanout_workers[k].sock);
+    l->fanout_count = 0;
+    close_capture_source(l);
+    cleanup_cache(l);
+    close_writers(l);
+    return -1;
+  }
+  l->running = 1;
+
+  // 创建监听线程
+  void *(*loop)(void *) = listener_loop_recv;
+  if (l->listener_cfg.mode == NET_CAPTURE_MMAP)
+    loop = listener_loop_mmap;
+  else if (l->listener_cfg.mode == NET_CAPTURE_XDP)
+    loop = listener_loop_xdp;
+  else if (l->listener_cfg.mode == NET_CAPTURE_RECVMMSG)
+    loop = listener_loop_recvmmsg;
+  else if (l->listener_cfg.mode == NET_CAPTURE_REPLAY)
+    loop = listener_loop_replay;
+  if (l->fanout_count > 0)
+    loop = fanout_worker_loop;
+  if (start_fanout_threads(l) < 0 ||
+      pthread_create(&l->listener_thread, NULL, loop, l->fanout_count > 0 ? (void *)&l->fanout_workers[0] : (void *)l) != 0) {
+    perror("pthread_create");
+    l->running = 0;
+    eventfd_write(l->stop_efd, 1);
+    stop_fanout_threads(l);
+    l->fanout_count = 0;
+    stop_dispatcher(l);
+    close_capture_source(l);
+    cleanup_cache(l);
+    close_writers(l);
+    return -1;
+  }
+
+  static const char *mode_names[] = { "recv", "TPACKET_V3", "AF_XDP", "recvmmsg", "pcap replay" };
+  if (l->fanout_count > 0)
+    LOG_INFO("[net_listener] Started on %s (PACKET_FANOUT, %u workers)\n", ifname, l->fanout_count);
+  else
+    LOG_INFO("[net_listener] Started on %s (%s)\n", ifname, mode_names[l->listener_cfg.mode]);
+  return 0;
+}
+
+void net_listener_ctx_stop(net_listener_t *l) {
+  if (!l->running)
+    return;
+  
+  // TPACKET_V3 未写满的块要等块超时才提交给用户态：先等过超时，抓包线程退出前处理已提交的块。
+  // 预备模式下窗口已关闭时末尾的帧本来就不要
+  if (l->listener_cfg.mode == NET_CAPTURE_MMAP && l->fanout_count == 0 &&
+      (!l->listener_cfg.armed || __atomic_load_n(&l->shot_state, __ATOMIC_ACQUIRE) != SHOT_IDLE))
+    usleep(l->listener_cfg.ring_block_timeout_ms * 1000);
+
+  // 唤醒阻塞在 epoll_wait 中的所有抓包线程
+  l->running = 0;
+  eventfd_write(l->stop_efd, 1);
+  pthread_join(l->listener_thread, NULL);
+  stop_fanout_threads(l);
+  apply_pending_clear(l);
+  stop_dispatcher(l);
+  stop_chunk_worker(l);
+  close_writers(l);
+  if (l->sockfd >= 0)
+    update_kernel_drops(l, l->sockfd);
+  close_capture_source(l);
+  
+  if (l->fanout_count > 0 && l->packet_cache)
+    merge_fanout_shards(l);
+
+  // 如果有缓存回调，传递缓存数据
+  if (l->kernel_dropped_packets > 0)
+    LOG_WARN("[net_listener] Kernel dropped %u packets\n", l->kernel_dropped_packets);
+
+  // 预备模式下已关闭的窗口在 shot_end 中交付过
+  if (!l->listener_cfg.armed || l->shot_state != SHOT_IDLE)
+    deliver_cache(l);
+  l->shot_state = SHOT_IDLE;
+  
+  l->fanout_count = 0;
+  cleanup_cache(l);
+  l->user_cache_cb = NULL;
+  l->user_cache_view_cb = NULL;
+  LOG_INFO("[net_listener] Stopped\n");
+}
+
+int net_listener_ctx_is_running(net_listener_t *l) {
+  return l->running;
+}
+
+// 读取采集计数的一致快照；clear_cache 的请求尚未被抓包线程执行时按已清零返回
+static void snapshot_stats(net_listener_t *l, capture_stats_t *snap) {
+  if (__atomic_load_n(&l->clear_pending, __ATOMIC_ACQUIRE)) {
+    memset(snap, 0, sizeof(*snap));
+    return;
+  }
+  seq_read(&l->stats.seq, snap, &l->stats, sizeof(*snap));
+}
+
+cache_stats_t net_listener_ctx_get_cache_stats(net_listener_t *l) {
   cache_stats_t stats;
-  pthread_mutex_lock(&cache_mutex);
-  stats.total_packets = packet_count;
-  stats.total_bytes = total_bytes;
-  stats.cache_size = cache_size;
-  stats.cache_used = cache_used;
-  stats.dropped_packets = dropped_packets;
-  pthread_mutex_unlock(&cache_mutex);
+  capture_stats_t snap;
+  // 运行中即时读取一次内核丢包，不必等抓包线程的下一个统计周期
+  if (l->running) {
+    if (l->fanout_count > 0) {
+      for (uint32_t k = 0; k < l->fanout_count; k++)
+        update_kernel_drops(l, l->fanout_workers[k].sock);
+    } else if (l->xdp_sock || l->sockfd >= 0) {
+      update_kernel_drops(l, l->sockfd);
+    }
+  }
+  snapshot_stats(l, &snap);
+  stats.total_packets = snap.packet_count;
+  stats.total_bytes = snap.total_bytes;
+  stats.cache_size = l->cache_size;
+  stats.cache_used = snap.cache_used;
+  stats.dropped_packets = snap.dropped_packets;
+  stats.cache_full_drops = snap.cache_full_drops;
+  stats.index_full_drops = snap.index_full_drops;
+  stats.header_mismatch_packets = snap.header_mismatch_packets;
+  stats.kernel_dropped_packets = __atomic_load_n(&l->kernel_dropped_packets, __ATOMIC_RELAXED);
+  stats.rcvbuf_bytes = l->rcvbuf_bytes;
+  stats.dispatch_high_water = 0;
+  stats.dispatch_overflow = 0;
+  for (uint32_t i = 0; i < l->dispatch_ring_count; i++) {
+    stats.dispatch_overflow += l->dispatch_rings[i].overflow;
+    if (l->dispatch_rings[i].high_water > stats.dispatch_high_water)
+      stats.dispatch_high_water = l->dispatch_rings[i].high_water;
+  }
+  stats.shot_seq = l->shot_seq;
+  stats.outside_window_packets = __atomic_load_n(&l->outside_window_packets, __ATOMIC_RELAXED);
+  stats.chunks_delivered = __atomic_load_n(&l->chunks_delivered, __ATOMIC_RELAXED);
+  stats.chunks_pending = 0;
+  if (l->chunk_mode) {
+    stats.total_packets += snap.chunk_done_packets;
+    stats.total_bytes += snap.chunk_done_bytes;
+    // 已交出而回调尚未返回的块
+    stats.chunks_pending = snap.chunk_seq > stats.chunks_delivered ? snap.chunk_seq - stats.chunks_delivered : 0;
+  }
+  stats.batch_count = snap.batch_count;
+  stats.avg_batch_fill = snap.batch_count > 0 ? (float)snap.batch_frames / snap.batch_count : 0;
+  for (int i = 0; i < NET_LATENCY_BUCKETS; i++)
+    stats.wakeup_latency_hist[i] = __atomic_load_n(&l->latency_hist[i], __ATOMIC_RELAXED);
+  if (l->running && l->fanout_count > 0) {
+    // 运行中各 worker 的分片计数尚未归并，这里汇总各分片的快照
+    uint64_t frames = 0;
+    for (uint32_t k = 0; k < l->fanout_count; k++) {
+      fanout_worker_t w;
+      seq_read(&l->fanout_workers[k].seq, &w, &l->fanout_workers[k], sizeof(w));
+      if (w.clear_gen != __atomic_load_n(&l->clear_gen, __ATOMIC_ACQUIRE))
+        continue;  // 已清空、worker 尚未执行
+      stats.total_packets += w.count;
+      stats.total_bytes += w.data_used;
+      stats.cache_used += w.data_used;
+      stats.dropped_packets += w.cache_full + w.index_full;
+      stats.cache_full_drops += w.cache_full;
+      stats.index_full_drops += w.index_full;
+      stats.header_mismatch_packets += w.mismatched;
+      stats.batch_count += w.batches;
+      frames += w.frames;
+    }
+    stats.avg_batch_fill = stats.batch_count > 0 ? (float)frames / stats.batch_count : 0;
+  }
   return stats;
 }
 
-void net_listener_clear_cache(void) {
-  pthread_mutex_lock(&cache_mutex);
-  cache_used = 0;
-  packet_count = 0;
-  total_bytes = 0;
-  dropped_packets = 0;
-  pthread_mutex_unlock(&cache_mutex);
+net_timestamp_stats_t net_listener_ctx_get_timestamp_stats(net_listener_t *l) {
+  net_timestamp_stats_t stats;
+  capture_stats_t snap;
+  memset(&stats, 0, sizeof(stats));
+
+  snapshot_stats(l, &snap);
+  stats.count = snap.ts_count;
+  stats.first_ns = snap.ts_first;
+  stats.last_ns = snap.ts_last;
+  if (snap.ts_count > 1) {
+    double n = snap.ts_count - 1;
+    stats.min_gap_ns = snap.ts_min_gap;
+    stats.max_gap_ns = snap.ts_max_gap;
+    stats.mean_gap_ns = snap.ts_last > snap.ts_first ? (double)(snap.ts_last - snap.ts_first) / n : 0;
+    double var = snap.ts_gap_sq_sum / n - stats.mean_gap_ns * stats.mean_gap_ns;
+    stats.jitter_ns = var > 0 ? sqrt(var) : 0;
+  }
+  if (l->running && l->fanout_count > 0) {
+    // 各分片尚未归并，只能给出总数、首末时间和平均间隔；间隔分布在停止归并后计算
+    for (uint32_t k = 0; k < l->fanout_count; k++) {
+      fanout_worker_t w;
+      seq_read(&l->fanout_workers[k].seq, &w, &l->fanout_workers[k], sizeof(w));
+      if (w.count == 0 || w.clear_gen != __atomic_load_n(&l->clear_gen, __ATOMIC_ACQUIRE))
+        continue;
+      if (stats.count == 0 || w.first_ts < stats.first_ns)
+        stats.first_ns = w.first_ts;
+      if (w.last_ts > stats.last_ns)
+        stats.last_ns = w.last_ts;
+      stats.count += w.count;
+    }
+    if (stats.count > 1)
+      stats.mean_gap_ns = (double)(stats.last_ns - stats.first_ns) / (stats.count - 1);
+  }
+  return stats;
+}
+
+net_stream_stats_t net_listener_ctx_get_stream_stats(net_listener_t *l) {
+  net_stream_stats_t stats;
+  pthread_mutex_lock(&l->cache_mutex);
+  if (l->stream)
+    net_stream_get_stats(l->stream, &stats);
+  else
+    stats = l->stream_final_stats;
+  pthread_mutex_unlock(&l->cache_mutex);
+  return stats;
+}
+
+net_pcap_stats_t net_listener_ctx_get_pcap_stats(net_listener_t *l) {
+  net_pcap_stats_t stats;
+  pthread_mutex_lock(&l->cache_mutex);
+  if (l->pcap)
+    net_pcap_get_stats(l->pcap, &stats);
+  else
+    stats = l->pcap_final_stats;
+  pthread_mutex_unlock(&l->cache_mutex);
+  return stats;
+}
+
+net_shm_stats_t net_listener_ctx_get_shm_stats(net_listener_t *l) {
+  net_shm_stats_t stats;
+  pthread_mutex_lock(&l->cache_mutex);
+  if (l->shm)
+    net_shm_get_stats(l->shm, &stats);
+  else
+    stats = l->shm_final_stats;
+  pthread_mutex_unlock(&l->cache_mutex);
+  return stats;
+}
+
+bool net_listener_ctx_replay_finished(net_listener_t *l) {
+  return __atomic_load_n(&l->replay_done, __ATOMIC_ACQUIRE);
+}
+
+void net_listener_ctx_release_cache(net_listener_t *l) {
+  if (l->running) {
+    LOG_WARN("[net_listener] Cannot release cache while listener is running\n");
+    return;
+  }
+  pthread_mutex_lock(&l->cache_mutex);
+  unmap_cache_region(l);
+  pthread_mutex_unlock(&l->cache_mutex);
+}
+
+void net_listener_ctx_clear_cache(net_listener_t *l) {
+  // 运行中计数只由抓包线程写，清零交给它在下一次写入前执行；fanout 时各 worker 另行清空自己的分片
+  if (l->running) {
+    __atomic_add_fetch(&l->clear_gen, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&l->clear_pending, true, __ATOMIC_RELEASE);
+  } else
+    reset_counters(l);
   LOG_INFO("[net_listener] Cache cleared\n");
-}
\ No newline at end of file
+}
+
+void net_listener_ctx_destroy(net_listener_t *l) {
+  if (!l)
+    return;
+  net_listener_ctx_stop(l);
+  net_listener_ctx_release_cache(l);
+  if (l->stop_efd >= 0)
+    close(l->stop_efd);
+  if (l->shot_efd >= 0)
+    close(l->shot_efd);
+  pthread_mutex_destroy(&l->cache_mutex);
+  pthread_cond_destroy(&l->chunk_cond);
+  pthread_cond_destroy(&l->shot_cond);
+  free(l);
+}
+
+int net_listener_ctx_shot_begin(net_listener_t *l) {
+  if (!l->running || !l->listener_cfg.armed)
+    return -1;
+
+  // 窗口外的内核丢包不计入本次采集
+  if (l->sockfd >= 0)
+    update_kernel_drops(l, l->sockfd);
+  pthread_mutex_lock(&l->cache_mutex);
+  reset_counters(l);
+  l->shot_seq++;
+  __atomic_store_n(&l->shot_state, SHOT_OPEN, __ATOMIC_RELEASE);
+  pthread_mutex_unlock(&l->cache_mutex);
+  return 0;
+}
+
+int net_listener_ctx_shot_end(net_listener_t *l) {
+  if (!l->running || !l->listener_cfg.armed)
+    return -1;
+
+  pthread_mutex_lock(&l->cache_mutex);
+  if (l->shot_state != SHOT_OPEN) {
+    pthread_mutex_unlock(&l->cache_mutex);
+    return -1;
+  }
+  // TPACKET_V3 未写满的块要等块超时才提交给用户态
+  uint64_t linger_ns = l->listener_cfg.mode == NET_CAPTURE_MMAP ?
+                       l->listener_cfg.ring_block_timeout_ms * 1000000ULL : 0;
+  l->shot_close_ns = monotonic_ns() + linger_ns;
+  if (l->replay && l->replay_done) {
+    // 回放已结束，没有抓包线程再写缓存，由本线程直接关闭窗口
+    __atomic_store_n(&l->shot_state, SHOT_IDLE, __ATOMIC_RELEASE);
+  } else {
+    // 回放源不经过 wait_for_frames，直接要求回放线程在下一帧前关闭
+    __atomic_store_n(&l->shot_force_close, l->replay != NULL, __ATOMIC_RELAXED);
+    __atomic_store_n(&l->shot_state, SHOT_CLOSING, __ATOMIC_RELEASE);
+    eventfd_write(l->shot_efd, 1);
+  }
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_REALTIME, &deadline);
+  uint64_t wait_ns = timespec_to_ns(&deadline) + linger_ns + NET_SHOT_CLOSE_TIMEOUT_MS * 1000000ULL;
+  deadline.tv_sec = wait_ns / 1000000000ULL;
+  deadline.tv_nsec = wait_ns % 1000000000ULL;
+  while (l->shot_state == SHOT_CLOSING) {
+    if (l->shot_force_close) {
+      pthread_cond_wait(&l->shot_cond, &l->cache_mutex);
+    } else if (pthread_cond_timedwait(&l->shot_cond, &l->cache_mutex, &deadline) == ETIMEDOUT) {
+      // 仍由抓包线程关闭窗口：它在处理下一帧之前确认，保证交付时没有写到一半的帧，
+      // 之后的 shot_begin 也不会与它同时写计数
+      LOG_WARN("[net_listener] Frames still arriving, closing shot window without draining\n");
+      __atomic_store_n(&l->shot_force_close, true, __ATOMIC_RELEASE);
+      eventfd_write(l->shot_efd, 1);
+    }
+  }
+  pthread_mutex_unlock(&l->cache_mutex);
+
+  // 本次窗口的实时回调全部结束后再交付，下一次 shot_begin 换回调时环中不会留有本次的帧
+  wait_dispatch_drained(l);
+  if (l->sockfd >= 0)
+    update_kernel_drops(l, l->sockfd);
+  int packets = (int)l->stats.packet_count;
+  deliver_cache(l);
+  return packets;
+}
+
+net_listener_t *net_listener_ctx_current(void) {
+  return current_listener;
+}
+
+void *net_listener_ctx_user_data(net_listener_t *l) {
+  return l->user_data;
+}
+
+int net_listener_start(const char *ifname, NetPacketCallback cb) {
+  return net_listener_start_with_cache(ifname, cb, NULL, 0);
+}
+
+int net_listener_start_with_cache(const char *ifname, NetPacketCallback cb, 
+                 NetCacheCallback cache_cb, uint32_t cache_size) {
+  return net_listener_start_with_config(ifname, cb, cache_cb, cache_size, NULL);
+}
+
+int net_listener_start_with_config(const char *ifname, NetPacketCallback cb,
+                 NetCacheCallback cache_cb, uint32_t cache_size,
+                 const net_listener_config_t *cfg) {
+  return net_listener_ctx_start(&default_listener, ifname, cb, cache_cb, cache_size, cfg);
+}
+
+void net_listener_stop(const char *ifname) {
+  net_listener_stop_with_cache(ifname);
+}
+
+// 默认实例停止在启动时的网卡上，ifname 仅为兼容旧接口保留
+void net_listener_stop_with_cache(const char *ifname) {
+  (void)ifname;
+  net_listener_ctx_stop(&default_listener);
+}
+
+int net_listener_is_running(void) {
+  return net_listener_ctx_is_running(&default_listener);
+}
+
+cache_stats_t net_listener_get_cache_stats(void) {
+  return net_listener_ctx_get_cache_stats(&default_listener);
+}
+
+net_timestamp_stats_t net_listener_get_timestamp_stats(void) {
+  return net_listener_ctx_get_timestamp_stats(&default_listener);
+}
+
+net_stream_stats_t net_listener_get_stream_stats(void) {
+  return net_listener_ctx_get_stream_stats(&default_listener);
+}
+
+net_pcap_stats_t net_listener_get_pcap_stats(void) {
+  return net_listener_ctx_get_pcap_stats(&default_listener);
+}
+
+net_shm_stats_t net_listener_get_shm_stats(void) {
+  return net_listener_ctx_get_shm_stats(&default_listener);
+}
+
+bool net_listener_replay_finished(void) {
+  return net_listener_ctx_replay_finished(&default_listener);
+}
+
+void net_listener_release_cache(void) {
+  net_listener_ctx_release_cache(&default_listener);
+}
+
+void net_listener_clear_cache(void) {
+  net_listener_ctx_clear_cache(&default_listener);
+}
+
+int net_listener_shot_begin(void) {
+  return net_listener_ctx_shot_begin(&default_listener);
+}
+
+int net_listener_shot_end(void) {
+  return net_listener_ctx_shot_end(&default_listener);
+}
@@ -2,6 +2,11 @@
 #define DEV_NET_LISTENER_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include "fpga.h"
+#include "net_stream.h"
+#include "net_pcap.h"
+#include "net_shm.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,22 +15,171 @@ extern "C" {
 #define NET_BUFFER_SIZE 2048
 #define DEFAULT_CACHE_SIZE (500 * 1024 * 1024) // 500MB 默认缓存大小
 
-// 数据包回调类型
+// TPACKET_V3 环形缓冲区默认参数
+#define NET_RING_DEFAULT_BLOCK_SIZE   (1 << 20)  // 每块 1MB（必须是页大小的 2 的幂倍）
+#define NET_RING_DEFAULT_BLOCK_COUNT  64         // 64 块，共 64MB
+#define NET_RING_DEFAULT_FRAME_SIZE   NET_BUFFER_SIZE
+#define NET_RING_DEFAULT_TIMEOUT_MS   10         // 块未填满时的超时提交时间
+
+// 回调分发环默认槽数（每槽 NET_BUFFER_SIZE 字节）
+#define NET_DISPATCH_DEFAULT_SLOTS    1024
+
+// 运行中读取内核丢包统计（PACKET_STATISTICS）的默认间隔
+#define NET_STATS_DEFAULT_INTERVAL_MS 100
+
+// 唤醒延迟直方图桶数：桶 0 为 <1us，桶 i 为 [2^(i-1), 2^i) us，最后一桶含更大值
+#define NET_LATENCY_BUCKETS           16
+
+// 分块回调默认参数
+#define NET_CHUNK_DEFAULT_SIZE        (8 << 20)  // 每块 8MB
+#define NET_CHUNK_DEFAULT_COUNT       4          // 块数（一块在写、其余可在回调中或空闲）
+#define NET_CHUNK_DEFAULT_TIMEOUT_MS  100        // 块未写满时最长等待时间
+#define NET_CHUNK_MAX_COUNT           64
+
+// PACKET_FANOUT 最大 worker 数
+#define NET_FANOUT_MAX_WORKERS        8
+
+// recvmmsg 批量接收默认参数
+#define NET_BATCH_DEFAULT_SIZE        64         // 每次系统调用最多接收的帧数
+#define NET_BATCH_DEFAULT_TIMEOUT_MS  0          // 0 = 收到第一帧即返回
+
+// 监听实例句柄：每个实例有独立的套接字、缓存和线程，可在同一进程中为多个网卡并行采集
+typedef struct net_listener net_listener_t;
+
+// 数据包回调类型（默认在独立的分发线程中调用，见 dispatch_ring_slots）
 typedef void (*NetPacketCallback)(const uint8_t *data, int length);
 
 // 缓存完成回调类型 - 用户获取缓存数据的接口
+// payload_only 模式下 cache_data 为紧凑排列的 UDP 负载，packet_lengths 为各帧负载长度
 typedef void (*NetCacheCallback)(const uint8_t *cache_data, uint32_t total_packets, 
                                 uint64_t total_bytes, const uint32_t *packet_lengths);
 
+// 缓存视图：在长度数组之外给出每包 64 位偏移，所有包等长时给出固定步长，
+// 消费者可直接定位第 i 包或把缓存切分给多个线程，无需从头累加偏移
+typedef struct {
+  const uint8_t *data;             // 缓存起始地址
+  uint32_t packet_count;           // 包数
+  uint64_t total_bytes;            // 总字节数
+  const uint32_t *packet_lengths;  // 各包长度
+  const uint64_t *packet_offsets;  // 各包相对 data 的起始偏移
+  const uint64_t *packet_timestamps; // 各包接收时间（CLOCK_REALTIME 纳秒，0 = 无时间戳）
+  uint32_t stride;                 // 所有包长度相同时为该长度（包 i 位于 data + i * stride），否则为 0
+} net_cache_view_t;
+
+// 缓存视图回调类型，view 仅在回调期间有效
+typedef void (*NetCacheViewCallback)(const net_cache_view_t *view);
+
+// 取缓存中第 i 个包的起始地址
+static inline const uint8_t *net_cache_packet(const net_cache_view_t *view, uint32_t i) {
+  if (view->stride)
+    return view->data + (uint64_t)i * view->stride;
+  return view->data + view->packet_offsets[i];
+}
+
+// 分块回调类型：在独立的工作线程中按块顺序调用，chunk_seq 从 0 递增；
+// 回调返回即释放该块，块被回收复用，view 仅在回调期间有效
+typedef void (*NetChunkCallback)(const net_cache_view_t *view, uint32_t chunk_seq);
+
+// 抓包后端
+typedef enum {
+  NET_CAPTURE_RECV = 0,   // 每帧一次 recv() 系统调用（默认）
+  NET_CAPTURE_MMAP,       // PACKET_MMAP TPACKET_V3 内存映射块环形缓冲区
+  NET_CAPTURE_XDP,        // AF_XDP 套接字，XDP 程序只重定向 FPGA UDP 流
+  NET_CAPTURE_RECVMMSG,   // recvmmsg() 批量接收，每帧直接写入缓存槽位
+  NET_CAPTURE_REPLAY,     // 从 replay_path 指定的 pcap/pcapng 文件回放，不打开网卡
+} net_capture_mode_t;
+
+// PACKET_FANOUT 分流方式
+typedef enum {
+  NET_FANOUT_LB = 0,      // 轮询分配（FPGA 只有一条 UDP 流，默认使用此方式才能分散到各 worker）
+  NET_FANOUT_CPU,         // 按接收中断所在 CPU 分配
+  NET_FANOUT_HASH,        // 按流哈希分配（同一条流总落在同一个 worker）
+} net_fanout_type_t;
+
+// 监听配置
+typedef struct {
+  net_capture_mode_t mode;         // 抓包后端
+  uint32_t ring_block_size;        // TPACKET_V3 块大小（字节）
+  uint32_t ring_block_count;       // TPACKET_V3 块数量
+  uint32_t ring_frame_size;        // TPACKET_V3 帧大小（字节）
+  uint32_t ring_block_timeout_ms;  // 块超时提交时间（毫秒）
+  uint32_t dispatch_ring_slots;    // 实时回调分发环槽数（0 = 在抓包线程内直接调用回调）
+  uint32_t batch_size;             // recvmmsg 每批最大帧数
+  uint32_t batch_timeout_ms;       // recvmmsg 填满一批的等待时间（0 = 有帧即返回）
+  uint32_t xdp_queue_id;           // AF_XDP 绑定的接收队列
+  uint32_t xdp_frame_count;        // AF_XDP UMEM 帧数（2 的幂）
+  uint32_t xdp_frame_size;         // AF_XDP UMEM 帧大小（2048 或 4096）
+  bool xdp_skb_mode;               // 强制通用 (SKB) XDP 模式，默认先尝试驱动模式
+  uint32_t fanout_workers;         // >1 时启用 PACKET_FANOUT：多个套接字各由一个绑核线程接收到独立缓存分片
+  net_fanout_type_t fanout_type;   // PACKET_FANOUT 分流方式
+  uint32_t busy_poll_us;           // SO_BUSY_POLL 忙轮询时长（微秒，0 = 关闭，超过 net.core.busy_read 需 CAP_NET_ADMIN）
+  bool prefer_busy_poll;           // SO_PREFER_BUSY_POLL：忙轮询期间抑制网卡中断
+  int sched_priority;              // >0 时抓包线程以 SCHED_FIFO 该优先级运行（需要 CAP_SYS_NICE）
+  uint32_t cpu_affinity;           // 抓包线程 CPU 掩码（bit n = CPU n，0 = 不限制）；fanout 时 worker k 绑定掩码中第 k 个 CPU
+  uint32_t spin_us;                // spin-then-block：收到帧后先非阻塞轮询的时长（微秒，0 = 直接阻塞）
+  uint32_t rcvbuf_size;            // 套接字接收缓冲区（字节，0 = 系统默认），先用 SO_RCVBUFFORCE（需要 CAP_NET_ADMIN）再退回 SO_RCVBUF
+  uint32_t stats_interval_ms;      // 运行中读取内核丢包统计的间隔（0 = 只在停止时读取）
+  bool udp_filter_enable;          // 是否在内核中只放行 FPGA UDP 帧
+  S_udp_header_params udp_filter;  // 过滤条件，与 fpga_initialize_udp_header 使用的参数一致
+  bool payload_only;               // 缓存只保存 UDP 负载：按 udp_filter 生成的帧头模板校验后剥离帧头
+  NetCacheViewCallback cache_view_cb; // 缓存视图回调（可选，停止时先于 NetCacheCallback 调用）
+  NetChunkCallback chunk_cb;       // 非空时启用分块回调：块写满或超时即交给回调，停止时不再整体交付缓存
+  uint32_t chunk_size;             // 每块数据容量（字节），块池总大小 chunk_size * chunk_count 取代 cache_size
+  uint32_t chunk_count;            // 块数（2..NET_CHUNK_MAX_COUNT），回调处理不及时且无空闲块时新帧计为丢弃
+  uint32_t chunk_timeout_ms;       // 块内第一包到达后最长等待时间，超时即交付未写满的块
+  const char *stream_path;         // 非空时经 io_uring 把帧流式写入该文件（格式见 net_stream.h），不使用内存缓存
+  uint32_t stream_block_size;      // 流式写盘块大小（字节，4096 的倍数）
+  uint32_t stream_queue_depth;     // 流式写盘块缓冲个数（最多在途写请求数）
+  const char *pcap_path;           // 非空时由后台线程把进入处理路径的完整帧写入该 pcapng 文件（纳秒时间戳）
+  uint32_t pcap_buffer_size;       // pcapng 写盘缓冲区大小（字节），写盘跟不上时新帧不写入文件并计数
+  const char *replay_path;         // NET_CAPTURE_REPLAY 模式回放的文件，udp_filter_enable 时在用户态按同样条件过滤
+  bool replay_timing;              // 回放时按文件中的原始包间隔送出（false = 全速）
+  const char *shm_name;            // 非空时把进入处理路径的帧导出到该 POSIX 共享内存帧环（如 "/sbeam_frames"），
+                                   // 本机其他进程用 net_shm_reader_* 零拷贝读取；阻塞消费者跟不上时新帧不进环并计数，
+                                   // 追赶消费者（net_shm_reader_open_lapped）不约束生产者，被套圈时自行跳过
+  uint32_t shm_slot_count;         // 共享内存帧环槽数（每槽 NET_BUFFER_SIZE 字节帧数据）
+  void *user_data;                 // 用户数据，回调中经 net_listener_ctx_user_data(net_listener_ctx_current()) 取回
+  bool armed;                      // 常驻预备模式：启动后套接字与线程常驻，只有 shot_begin/shot_end 之间的帧被处理
+} net_listener_config_t;
+
 // 缓存统计信息结构体
 typedef struct {
     uint32_t total_packets;      // 总包数
     uint64_t total_bytes;        // 总字节数
     uint32_t cache_size;         // 缓存大小
     uint32_t cache_used;         // 已用缓存
-    uint32_t dropped_packets;    // 丢弃的包数
+    uint32_t dropped_packets;    // 缓存丢弃的包数（= cache_full_drops + index_full_drops）
+    uint32_t cache_full_drops;   // 缓存数据区已满（分块模式下无空闲块）而丢弃的包数
+    uint32_t index_full_drops;   // 包索引数组已满（包数达到上限）而丢弃的包数
+    uint32_t header_mismatch_packets; // payload_only 模式下帧头与模板不符而未缓存的包数
+    uint32_t kernel_dropped_packets; // 内核丢弃的包数：套接字接收缓冲区或 TPACKET 环溢出（AF_XDP 为 XDP 环溢出），运行中按 stats_interval_ms 更新
+    uint32_t rcvbuf_bytes;       // 内核实际分配的套接字接收缓冲区（getsockopt 返回值，含内核记账开销）
+    uint32_t dispatch_high_water; // 回调分发环最大积压帧数
+    uint32_t dispatch_overflow;  // 分发环满未交给实时回调的帧数
+    uint32_t batch_count;        // recvmmsg 批次数
+    float avg_batch_fill;        // recvmmsg 平均每批帧数
+    uint32_t chunks_delivered;   // 分块回调模式下已处理完并回收的块数
+    uint32_t chunks_pending;     // 等待回调或回调处理中的块数
+    uint32_t wakeup_latency_hist[NET_LATENCY_BUCKETS]; // 内核交出帧到抓包线程取到的延迟分布：recv/recvmmsg 每次调用取首帧；
+                                                       // TPACKET_V3 只取写满提交的块，从块内最后一帧量起（超时提交的块不计）
+    uint32_t shot_seq;           // 常驻预备模式下已开启的采集窗口数
+    uint32_t outside_window_packets; // 常驻预备模式下窗口外到达而丢弃的帧数（启动以来累计）
 } cache_stats_t;
 
+// 包到达时间统计（只统计写入缓存路径的帧）
+typedef struct {
+    uint32_t count;              // 带时间戳的包数
+    uint64_t first_ns;           // 第一包接收时间（CLOCK_REALTIME 纳秒）
+    uint64_t last_ns;            // 最后一包接收时间
+    uint64_t min_gap_ns;         // 最小包间隔
+    uint64_t max_gap_ns;         // 最大包间隔
+    double mean_gap_ns;          // 平均包间隔
+    double jitter_ns;            // 包间隔标准差
+} net_timestamp_stats_t;
+
+// 用默认值填充监听配置（recv 后端，默认环形缓冲区参数）
+void net_listener_config_init(net_listener_config_t *cfg);
+
 // 启动监听（非阻塞或独立线程模式）
 int net_listener_start(const char *ifname, NetPacketCallback cb);
 
@@ -33,6 +187,11 @@ int net_listener_start(const char *ifname, NetPacketCallback cb);
 int net_listener_start_with_cache(const char *ifname, NetPacketCallback cb, 
                                  NetCacheCallback cache_cb, uint32_t cache_size);
 
+// 按指定配置启动带缓存的监听，cfg 为 NULL 时使用默认配置
+int net_listener_start_with_config(const char *ifname, NetPacketCallback cb,
+                                   NetCacheCallback cache_cb, uint32_t cache_size,
+                                   const net_listener_config_t *cfg);
+
 // 停止监听并获取缓存数据
 void net_listener_stop_with_cache(const char *ifname);
 
@@ -42,12 +201,83 @@ void net_listener_stop(const char *ifname);
 // 判断是否在运行
 int net_listener_is_running(void);
 
-// 获取缓存统计信息
+// 获取缓存统计信息。计数由抓包线程无锁更新，这里读取其一致快照（seqlock），
+// 可在任意线程中频繁调用，不会阻塞抓包
 cache_stats_t net_listener_get_cache_stats(void);
 
-// 手动清空缓存
+// 获取包到达时间统计（recv/recvmmsg 为 SO_TIMESTAMPNS，TPACKET_V3 为环内时间戳，
+// AF_XDP 为用户态取帧时间）。fanout 模式运行中只有 count/first/last/mean，
+// 间隔分布在停止归并后计算，可在缓存回调中读取。
+net_timestamp_stats_t net_listener_get_timestamp_stats(void);
+
+// 获取流式写盘统计（运行中为实时值，停止后为最终值）
+net_stream_stats_t net_listener_get_stream_stats(void);
+
+// 获取 pcapng 写盘统计（运行中为实时值，停止后为最终值）
+net_pcap_stats_t net_listener_get_pcap_stats(void);
+
+// 获取共享内存帧环统计，含各消费者落后的帧数（运行中为实时值，停止后为最终值）
+net_shm_stats_t net_listener_get_shm_stats(void);
+
+// NET_CAPTURE_REPLAY 模式下文件是否已回放完毕（之后仍需 stop 才交付缓存）
+bool net_listener_replay_finished(void);
+
+// 手动清空缓存。运行中由抓包线程在写入下一帧前清零，此前读取的统计按已清零返回
 void net_listener_clear_cache(void);
 
+// 释放持久缓存区域（缓存在首次启动时映射并锁定，停止监听后仍保留供下次复用）
+void net_listener_release_cache(void);
+
+/*
+ * 常驻预备模式（cfg->armed）：套接字、混杂模式、环形缓冲区和线程在 start 时建立一次，
+ * 之后每次采集只开关一个窗口，窗口外到达的帧直接丢弃。不支持 fanout、分块和流式写盘。
+ */
+
+// 开启采集窗口：清空缓存和统计，本次采集的帧从缓存起始处写入。
+// 上一次窗口交付的缓存数据此后失效。成功返回 0，未以预备模式运行返回 -1
+int net_listener_shot_begin(void);
+
+// 关闭采集窗口：等抓包线程取完已到达的帧（TPACKET_V3 另等一个块超时）、分发线程对本窗口的帧
+// 调用完实时回调后，在调用线程中把本窗口的缓存交给缓存回调。返回本窗口缓存的包数，失败返回 -1
+int net_listener_shot_end(void);
+
+/*
+ * 实例接口：与上面的接口一一对应，上面的接口操作进程内的默认实例。
+ * 每个实例同一时间只能运行一次采集，不同实例之间互不影响。
+ */
+
+// 创建监听实例，失败返回 NULL
+net_listener_t *net_listener_ctx_create(void);
+
+// 停止采集、释放持久缓存并销毁实例
+void net_listener_ctx_destroy(net_listener_t *nl);
+
+// 在 ifname 上启动采集，参数同 net_listener_start_with_config
+int net_listener_ctx_start(net_listener_t *nl, const char *ifname, NetPacketCallback cb,
+                           NetCacheCallback cache_cb, uint32_t cache_size,
+                           const net_listener_config_t *cfg);
+
+// 停止采集并交付缓存数据
+void net_listener_ctx_stop(net_listener_t *nl);
+
+int net_listener_ctx_is_running(net_listener_t *nl);
+cache_stats_t net_listener_ctx_get_cache_stats(net_listener_t *nl);
+net_timestamp_stats_t net_listener_ctx_get_timestamp_stats(net_listener_t *nl);
+net_stream_stats_t net_listener_ctx_get_stream_stats(net_listener_t *nl);
+net_pcap_stats_t net_listener_ctx_get_pcap_stats(net_listener_t *nl);
+net_shm_stats_t net_listener_ctx_get_shm_stats(net_listener_t *nl);
+bool net_listener_ctx_replay_finished(net_listener_t *nl);
+void net_listener_ctx_clear_cache(net_listener_t *nl);
+void net_listener_ctx_release_cache(net_listener_t *nl);
+int net_listener_ctx_shot_begin(net_listener_t *nl);
+int net_listener_ctx_shot_end(net_listener_t *nl);
+
+// 在用户回调中调用：返回正在调用该回调的实例，回调之外返回 NULL
+net_listener_t *net_listener_ctx_current(void);
+
+// 启动时 cfg->user_data 的值
+void *net_listener_ctx_user_data(net_listener_t *nl);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,508 @@
+#include "net_pcap.h"
+#include "../utils/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+// pcapng 块类型与选项
+#define PCAPNG_SHB            0x0A0D0D0A
+#define PCAPNG_IDB            0x00000001
+#define PCAPNG_PB             0x00000002  // 旧式 Packet Block，只读取
+#define PCAPNG_SPB            0x00000003
+#define PCAPNG_EPB            0x00000006
+#define PCAPNG_BYTE_ORDER     0x1A2B3C4D
+#define PCAPNG_OPT_END        0
+#define PCAPNG_OPT_IF_NAME    2
+#define PCAPNG_OPT_IF_TSRESOL 9
+#define PCAPNG_MAX_IFACES     16
+
+// 经典 pcap 文件头魔数
+#define PCAP_MAGIC_US         0xA1B2C3D4
+#define PCAP_MAGIC_NS         0xA1B23C4D
+
+#define LINKTYPE_ETHERNET     1
+#define PCAPNG_EPB_OVERHEAD   32          // EPB 块头 28 字节 + 块尾长度 4 字节
+#define NET_PCAP_WRITE_BATCH  (64 << 10)  // 积攒到该字节数再写盘，不足时最多积攒 1ms
+
+#define PAD4(x) (((x) + 3u) & ~3u)
+
+struct net_pcap_writer {
+  int fd;
+
+  // 单生产者单消费者字节环：head 只由抓包线程推进，tail 只由写盘线程推进
+  uint8_t *buf;
+  uint32_t size;
+  uint64_t head;
+  uint64_t tail;
+
+  int running;              // 停止握手：close 以 release 写 0，写盘线程以 acquire 读
+  int efd;                  // 写盘线程等待数据时阻塞的 eventfd
+  uint32_t wake_bytes;      // 非 0 时写盘线程在等待，积压达到该字节数才需要唤醒
+  pthread_t thread;
+
+  // 统计（各字段只由一个线程修改，其他线程用原子读取）
+  uint64_t frames;
+  uint64_t bytes_written;
+  uint64_t dropped_frames;
+  uint64_t write_errors;
+  uint32_t buffer_high_water;
+};
+
+static inline void stat_add(uint64_t *v, uint64_t n) {
+  __atomic_store_n(v, *v + n, __ATOMIC_RELAXED);
+}
+
+// 写出整段数据，只在打开时写文件头使用
+static int write_all(int fd, const void *data, size_t len) {
+  const uint8_t *p = data;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      return -1;
+    p += n;
+    len -= (size_t)n;
+  }
+  return 0;
+}
+
+static int write_headers(int fd, const char *ifname) {
+  // SHB：本机字节序，版本 1.0，section 长度未知（-1）
+  uint32_t shb[7] = { PCAPNG_SHB, 28, PCAPNG_BYTE_ORDER, 0, 0xFFFFFFFF, 0xFFFFFFFF, 28 };
+  uint16_t version[2] = { 1, 0 };
+  memcpy(&shb[3], version, 4);
+
+  // IDB：以太网，选项 if_name、if_tsresol = 9（纳秒）
+  uint8_t idb[128];
+  uint32_t len = 16;
+  memset(idb, 0, sizeof(idb));
+  uint32_t hdr[4] = { PCAPNG_IDB, 0, 0, NET_PCAP_SNAPLEN };
+  uint16_t linktype[2] = { LINKTYPE_ETHERNET, 0 };
+  memcpy(&hdr[2], linktype, 4);
+  size_t name_len = ifname ? strnlen(ifname, 64) : 0;
+  if (name_len > 0) {
+    uint16_t opt[2] = { PCAPNG_OPT_IF_NAME, (uint16_t)name_len };
+    memcpy(idb + len, opt, 4);
+    memcpy(idb + len + 4, ifname, name_len);
+    len += 4 + PAD4(name_len);
+  }
+  uint16_t tsresol[2] = { PCAPNG_OPT_IF_TSRESOL, 1 };
+  memcpy(idb + len, tsresol, 4);
+  idb[len + 4] = 9;
+  len += 8;
+  len += 4;  // opt_endofopt
+  len += 4;  // 块尾长度
+  hdr[1] = len;
+  memcpy(idb, hdr, sizeof(hdr));
+  memcpy(idb + len - 4, &len, 4);
+
+  return write_all(fd, shb, sizeof(shb)) < 0 || write_all(fd, idb, len) < 0 ? -1 : 0;
+}
+
+// 积压不足 bytes 时阻塞，直到生产者追加到该字节数、停止或超时（timeout_ms < 0 表示不超时）。
+// 先登记 wake_bytes 再复查 head，与 net_pcap_add 中的全屏障配对，不会漏掉唤醒
+static void wait_for_data(net_pcap_writer_t *w, uint32_t bytes, int timeout_ms) {
+  __atomic_store_n(&w->wake_bytes, bytes, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  uint64_t pending = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE) - w->tail;
+  if (pending < bytes && __atomic_load_n(&w->running, __ATOMIC_ACQUIRE)) {
+    struct pollfd pfd = { .fd = w->efd, .events = POLLIN };
+    poll(&pfd, 1, timeout_ms);
+  }
+  __atomic_store_n(&w->wake_bytes, 0, __ATOMIC_RELAXED);
+  eventfd_t wakeups;
+  eventfd_read(w->efd, &wakeups);  // 非阻塞，清掉可能留下的唤醒
+}
+
+static void *pcap_writer_loop(void *arg) {
+  net_pcap_writer_t *w = arg;
+  bool waited = false;
+
+  for (;;) {
+    // 先读停止标志再读 head（acquire），停止前追加的帧都会被写出
+    int stopping = !__atomic_load_n(&w->running, __ATOMIC_ACQUIRE);
+    uint64_t head = __atomic_load_n(&w->head, __ATOMIC_ACQUIRE);
+    uint64_t pending = head - w->tail;
+
+    if (pending == 0 && stopping)
+      break;
+    if (pending == 0) {
+      wait_for_data(w, 1, -1);
+      continue;
+    }
+    // 不足一批时最多再积攒 1ms
+    if (pending < NET_PCAP_WRITE_BATCH && !stopping && !waited) {
+      waited = true;
+      wait_for_data(w, NET_PCAP_WRITE_BATCH, 1);
+      continue;
+    }
+    waited = false;
+
+    // 一次写出连续区间，跨越缓冲区末尾的部分下一轮再写
+    uint32_t off = (uint32_t)(w->tail & (w->size - 1));
+    size_t len = pending;
+    if (off + len > w->size)
+      len = w->size - off;
+    ssize_t n = write(w->fd, w->buf + off, len);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0) {
+      // 写失败时丢弃这段数据，避免缓冲区永远写不空
+      perror("[net_pcap] write");
+      stat_add(&w->write_errors, 1);
+      n = (ssize_t)len;
+    } else {
+      stat_add(&w->bytes_written, (uint64_t)n);
+    }
+    __atomic_store_n(&w->tail, w->tail + (uint64_t)n, __ATOMIC_RELEASE);
+  }
+  return NULL;
+}
+
+net_pcap_writer_t *net_pcap_open(const char *path, const char *ifname, uint32_t buffer_size) {
+  net_pcap_writer_t *w = calloc(1, sizeof(*w));
+  if (!w)
+    return NULL;
+
+  w->size = 64 << 10;
+  while (w->size < buffer_size && w->size < (1u << 31))
+    w->size <<= 1;
+  w->buf = malloc(w->size);
+  w->efd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+  w->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (!w->buf || w->efd < 0 || w->fd < 0) {
+    if (w->fd < 0)
+      perror("[net_pcap] open");
+    if (w->fd >= 0)
+      close(w->fd);
+    if (w->efd >= 0)
+      close(w->efd);
+    free(w->buf);
+    free(w);
+    return NULL;
+  }
+
+  if (write_headers(w->fd, ifname) < 0) {
+    perror("[net_pcap] write header");
+    close(w->fd);
+    close(w->efd);
+    free(w->buf);
+    free(w);
+    return NULL;
+  }
+
+  __atomic_store_n(&w->running, 1, __ATOMIC_RELEASE);
+  if (pthread_create(&w->thread, NULL, pcap_writer_loop, w) != 0) {
+    perror("pthread_create");
+    close(w->fd);
+    close(w->efd);
+    free(w->buf);
+    free(w);
+    return NULL;
+  }
+  LOG_INFO("[net_pcap] Writing %s (buffer %u KB)\n", path, w->size >> 10);
+  return w;
+}
+
+// 从环中位置 pos 起拷入数据，跨越末尾时分两段
+static inline void ring_put(net_pcap_writer_t *w, uint64_t pos, const void *src, uint32_t len) {
+  uint32_t off = (uint32_t)(pos & (w->size - 1));
+  uint32_t first = w->size - off;
+  if (first >= len) {
+    memcpy(w->buf + off, src, len);
+  } else {
+    memcpy(w->buf + off, src, first);
+    memcpy(w->buf, (const uint8_t *)src + first, len - first);
+  }
+}
+
+int net_pcap_add(net_pcap_writer_t *w, const uint8_t *data, uint32_t length, uint64_t ts) {
+  static const uint8_t zeros[4];
+  uint32_t caplen = length > NET_PCAP_SNAPLEN ? NET_PCAP_SNAPLEN : length;
+  uint32_t total = PCAPNG_EPB_OVERHEAD + PAD4(caplen);
+
+  uint64_t used = w->head - __atomic_load_n(&w->tail, __ATOMIC_ACQUIRE);
+  if (used + total > w->size) {
+    stat_add(&w->dropped_frames, 1);
+    return -1;
+  }
+
+  // EPB：接口 0，时间戳高/低 32 位（单位由 if_tsresol 定为纳秒）
+  uint32_t hdr[7] = { PCAPNG_EPB, total, 0, (uint32_t)(ts >> 32), (uint32_t)ts, caplen, length };
+  uint64_t pos = w->head;
+  ring_put(w, pos, hdr, sizeof(hdr));
+  pos += sizeof(hdr);
+  ring_put(w, pos, data, caplen);
+  pos += caplen;
+  ring_put(w, pos, zeros, PAD4(caplen) - caplen);
+  pos += PAD4(caplen) - caplen;
+  ring_put(w, pos, &total, 4);
+  __atomic_store_n(&w->head, pos + 4, __ATOMIC_RELEASE);
+
+  // 与 wait_for_data 配对：写盘线程在等待且积压已够时才唤醒，忙时不做系统调用
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  uint32_t wake = __atomic_load_n(&w->wake_bytes, __ATOMIC_RELAXED);
+  if (wake && used + total >= wake && __atomic_exchange_n(&w->wake_bytes, 0, __ATOMIC_ACQ_REL))
+    eventfd_write(w->efd, 1);
+
+  stat_add(&w->frames, 1);
+  if (used + total > w->buffer_high_water)
+    __atomic_store_n(&w->buffer_high_water, (uint32_t)(used + total), __ATOMIC_RELAXED);
+  return 0;
+}
+
+void net_pcap_get_stats(net_pcap_writer_t *w, net_pcap_stats_t *stats) {
+  stats->frames = __atomic_load_n(&w->frames, __ATOMIC_RELAXED);
+  stats->bytes_written = __atomic_load_n(&w->bytes_written, __ATOMIC_RELAXED);
+  stats->dropped_frames = __atomic_load_n(&w->dropped_frames, __ATOMIC_RELAXED);
+  stats->write_errors = __atomic_load_n(&w->write_errors, __ATOMIC_RELAXED);
+  stats->buffer_high_water = __atomic_load_n(&w->buffer_high_water, __ATOMIC_RELAXED);
+}
+
+int net_pcap_close(net_pcap_writer_t *w, net_pcap_stats_t *stats) {
+  if (!w)
+    return 0;
+
+  __atomic_store_n(&w->running, 0, __ATOMIC_RELEASE);
+  eventfd_write(w->efd, 1);
+  pthread_join(w->thread, NULL);
+  close(w->efd);
+  int ret = w->write_errors > 0 ? -1 : 0;
+  if (close(w->fd) < 0) {
+    perror("[net_pcap] close");
+    ret = -1;
+  }
+  if (stats)
+    net_pcap_get_stats(w, stats);
+  LOG_INFO("[net_pcap] Closed: %llu frames, %llu bytes, %llu dropped\n",
+           (unsigned long long)w->frames, (unsigned long long)w->bytes_written,
+           (unsigned long long)w->dropped_frames);
+  free(w->buf);
+  free(w);
+  return ret;
+}
+
+/*
+ * 读取：经典 pcap 和 pcapng 两种格式，支持与本机字节序相反的文件。
+ */
+struct net_pcap_reader {
+  FILE *fp;
+  bool ng;
+  bool swap;
+  bool nsec;                          // 经典 pcap：时间戳小数部分为纳秒
+  uint8_t if_tsresol[PCAPNG_MAX_IFACES]; // pcapng：各接口时间戳精度（if_tsresol 原值）
+  uint32_t if_count;
+  uint8_t *buf;
+  uint32_t buf_size;
+};
+
+static inline uint32_t rd32(const net_pcap_reader_t *r, const uint8_t *p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return r->swap ? __builtin_bswap32(v) : v;
+}
+
+static inline uint16_t rd16(const net_pcap_reader_t *r, const uint8_t *p) {
+  uint16_t v;
+  memcpy(&v, p, 2);
+  return r->swap ? __builtin_bswap16(v) : v;
+}
+
+static int reserve(net_pcap_reader_t *r, uint32_t size) {
+  if (size <= r->buf_size)
+    return 0;
+  uint8_t *p = realloc(r->buf, size);
+  if (!p)
+    return -1;
+  r->buf = p;
+  r->buf_size = size;
+  return 0;
+}
+
+// if_tsresol：最高位为 0 时单位为 10^-v 秒，为 1 时为 2^-(v & 0x7f) 秒
+static uint64_t tsresol_to_ns(uint8_t resol, uint64_t ts) {
+  if (resol & 0x80)
+    return (uint64_t)(((unsigned __int128)ts * 1000000000ULL) >> (resol & 0x7f));
+  uint64_t scale = 1;
+  if (resol <= 9) {
+    for (int i = resol; i < 9; i++)
+      scale *= 10;
+    return ts * scale;
+  }
+  for (int i = 9; i < resol && i < 28; i++)
+    scale *= 10;
+  return ts / scale;
+}
+
+net_pcap_reader_t *net_pcap_reader_open(const char *path) {
+  FILE *fp = fopen(path, "rb");
+  if (!fp) {
+    perror("[net_pcap] fopen");
+    return NULL;
+  }
+  net_pcap_reader_t *r = calloc(1, sizeof(*r));
+  if (!r) {
+    fclose(fp);
+    return NULL;
+  }
+  r->fp = fp;
+
+  uint8_t hdr[24];
+  uint32_t magic;
+  if (fread(hdr, 1, 4, fp) != 4)
+    goto bad;
+  memcpy(&magic, hdr, 4);
+  if (magic == PCAPNG_SHB) {
+    // 块类型回文，字节序由 SHB 内的 byte-order magic 决定，rewind 后按普通块解析
+    r->ng = true;
+    rewind(fp);
+    return r;
+  }
+
+  if (fread(hdr + 4, 1, 20, fp) != 20)
+    goto bad;
+  if (magic == PCAP_MAGIC_US || magic == PCAP_MAGIC_NS) {
+    r->nsec = magic == PCAP_MAGIC_NS;
+  } else if (__builtin_bswap32(magic) == PCAP_MAGIC_US || __builtin_bswap32(magic) == PCAP_MAGIC_NS) {
+    r->swap = true;
+    r->nsec = __builtin_bswap32(magic) == PCAP_MAGIC_NS;
+  } else {
+    goto bad;
+  }
+  if (rd32(r, hdr + 20) != LINKTYPE_ETHERNET)
+    LOG_WARN("[net_pcap] %s: link type %u is not Ethernet\n", path, rd32(r, hdr + 20));
+  return r;
+
+bad:
+  LOG_ERROR("[net_pcap] %s is not a pcap or pcapng file\n", path);
+  fclose(fp);
+  free(r);
+  return NULL;
+}
+
+static int next_classic(net_pcap_reader_t *r, const uint8_t **data, uint32_t *length, uint64_t *ts) {
+  uint8_t rec[16];
+  size_t n = fread(rec, 1, sizeof(rec), r->fp);
+  if (n == 0)
+    return 0;
+  if (n != sizeof(rec))
+    return -1;
+
+  uint32_t caplen = rd32(r, rec + 8);
+  if (caplen > (1u << 26) || reserve(r, caplen) < 0 || fread(r->buf, 1, caplen, r->fp) != caplen)
+    return -1;
+  uint64_t frac = rd32(r, rec + 4);
+  *ts = (uint64_t)rd32(r, rec) * 1000000000ULL + (r->nsec ? frac : frac * 1000);
+  *data = r->buf;
+  *length = caplen;
+  return 1;
+}
+
+// 解析 IDB 选项中的 if_tsresol，opts 指向选项区，len 为选项区长度
+static uint8_t idb_tsresol(const net_pcap_reader_t *r, const uint8_t *opts, uint32_t len) {
+  uint32_t pos = 0;
+  while (pos + 4 <= len) {
+    uint16_t code = rd16(r, opts + pos);
+    uint16_t olen = rd16(r, opts + pos + 2);
+    if (code == PCAPNG_OPT_END)
+      break;
+    if (code == PCAPNG_OPT_IF_TSRESOL && olen >= 1 && pos + 5 <= len)
+      return opts[pos + 4];
+    pos += 4 + PAD4(olen);
+  }
+  return 6;  // 默认微秒
+}
+
+static int next_ng(net_pcap_reader_t *r, const uint8_t **data, uint32_t *length, uint64_t *ts) {
+  for (;;) {
+    uint8_t bh[8];
+    size_t n = fread(bh, 1, sizeof(bh), r->fp);
+    if (n == 0)
+      return 0;
+    if (n != sizeof(bh))
+      return -1;
+
+    uint32_t type;
+    memcpy(&type, bh, 4);
+    if (type == PCAPNG_SHB) {
+      // 新的 section：重新确定字节序，接口编号从 0 开始
+      uint8_t bom[4];
+      if (fread(bom, 1, 4, r->fp) != 4)
+        return -1;
+      uint32_t order;
+      memcpy(&order, bom, 4);
+      if (order == PCAPNG_BYTE_ORDER)
+        r->swap = false;
+      else if (__builtin_bswap32(order) == PCAPNG_BYTE_ORDER)
+        r->swap = true;
+      else
+        return -1;
+      r->if_count = 0;
+      uint32_t total = rd32(r, bh + 4);
+      if (total < 28 || total % 4 || fseek(r->fp, total - 12, SEEK_CUR) < 0)
+        return -1;
+      continue;
+    }
+
+    type = rd32(r, bh);
+    uint32_t total = rd32(r, bh + 4);
+    if (total < 12 || total % 4 || total > (1u << 26))
+      return -1;
+    uint32_t body = total - 12;
+    if (reserve(r, body + 4) < 0 || fread(r->buf, 1, body + 4, r->fp) != body + 4)
+      return -1;
+    const uint8_t *b = r->buf;
+
+    if (type == PCAPNG_IDB && body >= 8) {
+      if (r->if_count < PCAPNG_MAX_IFACES)
+        r->if_tsresol[r->if_count] = idb_tsresol(r, b + 8, body - 8);
+      r->if_count++;
+    } else if (type == PCAPNG_EPB && body >= 20) {
+      uint32_t ifid = rd32(r, b);
+      uint32_t caplen = rd32(r, b + 12);
+      if (caplen > body - 20)
+        return -1;
+      uint8_t resol = ifid < r->if_count && ifid < PCAPNG_MAX_IFACES ? r->if_tsresol[ifid] : 6;
+      *ts = tsresol_to_ns(resol, ((uint64_t)rd32(r, b + 4) << 32) | rd32(r, b + 8));
+      *data = b + 20;
+      *length = caplen;
+      return 1;
+    } else if (type == PCAPNG_PB && body >= 20) {
+      uint16_t ifid = rd16(r, b);
+      uint32_t caplen = rd32(r, b + 12);
+      if (caplen > body - 20)
+        return -1;
+      uint8_t resol = ifid < r->if_count && ifid < PCAPNG_MAX_IFACES ? r->if_tsresol[ifid] : 6;
+      *ts = tsresol_to_ns(resol, ((uint64_t)rd32(r, b + 4) << 32) | rd32(r, b + 8));
+      *data = b + 20;
+      *length = caplen;
+      return 1;
+    } else if (type == PCAPNG_SPB && body >= 4) {
+      uint32_t len = rd32(r, b);
+      *ts = 0;
+      *data = b + 4;
+      *length = len < body - 4 ? len : body - 4;
+      return 1;
+    }
+    // 其余块（NRB、ISB、DSB 等）跳过
+  }
+}
+
+int net_pcap_reader_next(net_pcap_reader_t *r, const uint8_t **data, uint32_t *length, uint64_t *ts) {
+  return r->ng ? next_ng(r, data, length, ts) : next_classic(r, data, length, ts);
+}
+
+void net_pcap_reader_close(net_pcap_reader_t *r) {
+  if (!r)
+    return;
+  fclose(r->fp);
+  free(r->buf);
+  free(r);
+}
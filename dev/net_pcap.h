@@ -0,0 +1,80 @@
+#ifndef DEV_NET_PCAP_H
+#define DEV_NET_PCAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// pcapng 写盘默认参数
+#define NET_PCAP_DEFAULT_BUFFER_SIZE (16 << 20)  // 抓包线程与写盘线程之间的缓冲区（字节，2 的幂）
+#define NET_PCAP_SNAPLEN             65535
+
+// pcapng 写盘统计（64 位计数，长时间采集不回绕）
+typedef struct {
+  uint64_t frames;             // 写入缓冲区的帧数
+  uint64_t bytes_written;      // 已写入文件的字节数（含块头）
+  uint64_t dropped_frames;     // 缓冲区满（磁盘跟不上）而丢弃的帧数
+  uint64_t write_errors;       // 失败的 write 调用次数
+  uint32_t buffer_high_water;  // 缓冲区最大占用（字节）
+} net_pcap_stats_t;
+
+// pcapng 写盘句柄：抓包线程把帧按 EPB 格式拷入环形缓冲区，后台线程顺序写出
+typedef struct net_pcap_writer net_pcap_writer_t;
+
+/**
+ * @brief 创建（截断）pcapng 文件，写入 SHB/IDB 并启动写盘线程
+ * @details 时间戳精度为纳秒（if_tsresol = 9），链路类型为以太网。
+ * @param ifname      记录在 IDB 中的网卡名，可为 NULL
+ * @param buffer_size 缓冲区大小，向上取整到 2 的幂
+ * @return 成功返回句柄，失败返回 NULL
+ */
+net_pcap_writer_t *net_pcap_open(const char *path, const char *ifname, uint32_t buffer_size);
+
+/**
+ * @brief 追加一帧
+ * @details 只拷贝到缓冲区，不做系统调用；缓冲区满时丢弃该帧并计数。只能由一个线程调用。
+ * @param ts 接收时间（CLOCK_REALTIME 纳秒）
+ * @return 0 成功，-1 丢弃
+ */
+int net_pcap_add(net_pcap_writer_t *w, const uint8_t *data, uint32_t length, uint64_t ts);
+
+/**
+ * @brief 读取统计，可在其他线程中调用
+ */
+void net_pcap_get_stats(net_pcap_writer_t *w, net_pcap_stats_t *stats);
+
+/**
+ * @brief 等待缓冲区写空，停止写盘线程并关闭文件
+ * @param stats 非 NULL 时写入最终统计
+ * @return 0 成功，有写错误时返回 -1
+ */
+int net_pcap_close(net_pcap_writer_t *w, net_pcap_stats_t *stats);
+
+// pcap / pcapng 读取句柄
+typedef struct net_pcap_reader net_pcap_reader_t;
+
+/**
+ * @brief 打开 pcap（微秒或纳秒）或 pcapng 文件
+ * @details pcapng 支持 EPB/SPB/旧式 PB 和各接口的 if_tsresol，其余块跳过。
+ * @return 成功返回句柄，格式无法识别或打开失败返回 NULL
+ */
+net_pcap_reader_t *net_pcap_reader_open(const char *path);
+
+/**
+ * @brief 读取下一帧
+ * @param data   帧数据，在下次调用或关闭前有效
+ * @param ts     接收时间（纳秒，SPB 没有时间戳时为 0）
+ * @return 1 读到一帧，0 文件结束，-1 文件损坏
+ */
+int net_pcap_reader_next(net_pcap_reader_t *r, const uint8_t **data, uint32_t *length, uint64_t *ts);
+
+void net_pcap_reader_close(net_pcap_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEV_NET_PCAP_H
@@ -0,0 +1,334 @@
+#include "net_shm.h"
+#include "../utils/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define ALIGN64(x) (((x) + 63) & ~(size_t)63)
+
+// 环满时每丢弃这么多帧检查一次落后消费者的进程是否还在（kill 是系统调用，不每帧做）
+#define NET_SHM_RECLAIM_INTERVAL 1024
+
+struct net_shm_writer {
+  char name[NAME_MAX];
+  net_shm_header_t *hdr;
+  uint8_t *slots;
+  size_t map_len;
+  uint32_t snaplen;
+  uint64_t min_tail;     // 上次算出的最慢消费者位置，未落后一整环前不重新计算
+  uint32_t reclaimed;
+};
+
+static inline net_shm_slot_t *slot_at(const net_shm_header_t *h, uint8_t *slots, uint64_t seq) {
+  return (net_shm_slot_t *)(slots + (size_t)(seq & (h->slot_count - 1)) * h->slot_size);
+}
+
+net_shm_writer_t *net_shm_open(const char *name, uint32_t slot_count, uint32_t snaplen) {
+  net_shm_writer_t *w = calloc(1, sizeof(*w));
+  if (!w)
+    return NULL;
+  snprintf(w->name, sizeof(w->name), "%s", name);
+
+  uint32_t count = 64;
+  while (count < slot_count && count < (1u << 24))
+    count <<= 1;
+  size_t data_offset = ALIGN64(sizeof(net_shm_header_t));
+  size_t slot_size = ALIGN64(sizeof(net_shm_slot_t) + snaplen);
+  w->map_len = data_offset + (size_t)count * slot_size;
+  w->snaplen = snaplen;
+
+  // 上次异常退出留下的同名环直接删除重建，仍映射着旧环的消费者不受影响
+  shm_unlink(name);
+  int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0660);
+  if (fd < 0) {
+    perror("[net_shm] shm_open");
+    free(w);
+    return NULL;
+  }
+  if (ftruncate(fd, (off_t)w->map_len) < 0) {
+    perror("[net_shm] ftruncate");
+    close(fd);
+    shm_unlink(name);
+    free(w);
+    return NULL;
+  }
+  // 预先建立映射，抓包路径上写槽不缺页
+  void *p = mmap(NULL, w->map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    perror("[net_shm] mmap");
+    shm_unlink(name);
+    free(w);
+    return NULL;
+  }
+
+  w->hdr = p;
+  w->slots = (uint8_t *)p + data_offset;
+  w->hdr->slot_count = count;
+  w->hdr->slot_size = (uint32_t)slot_size;
+  w->hdr->data_offset = data_offset;
+  w->hdr->producer_pid = getpid();
+  w->hdr->version = NET_SHM_VERSION;
+  for (int i = 0; i < NET_SHM_MAX_CONSUMERS; i++)
+    w->hdr->consumers[i].tail = NET_SHM_TAIL_NONE;
+  // 槽的 seq 初值不能与任何将要写入的帧序号相同
+  for (uint32_t i = 0; i < count; i++)
+    slot_at(w->hdr, w->slots, i)->seq = NET_SHM_SEQ_WRITING;
+  // magic 最后写入，消费者看到 magic 即说明头部已初始化
+  __atomic_store_n(&w->hdr->magic, NET_SHM_MAGIC, __ATOMIC_RELEASE);
+
+  LOG_INFO("[net_shm] Exporting frames to %s (%u slots x %zu B, %zu KB)\n",
+           name, count, slot_size, w->map_len >> 10);
+  return w;
+}
+
+// 最慢的已登记阻塞消费者位置，没有时为 head；追赶消费者和尚未登记位置（NET_SHM_TAIL_NONE）的不计。
+// 与 net_shm_reader_open 配对的全屏障保证：要么这里看到新登记的位置，
+// 要么该消费者读到的 head 不早于本次计算时的 head，随后一整环内不会覆盖它的起点
+static uint64_t slowest_tail(net_shm_writer_t *w, uint64_t head) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  uint64_t min = head;
+  for (int i = 0; i < NET_SHM_MAX_CONSUMERS; i++) {
+    net_shm_consumer_t *c = &w->hdr->consumers[i];
+    if (__atomic_load_n(&c->pid, __ATOMIC_ACQUIRE) == 0)
+      continue;
+    uint64_t tail = __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+    if (tail < min && !(__atomic_load_n(&c->flags, __ATOMIC_RELAXED) & NET_SHM_CONSUMER_LAPPED))
+      min = tail;
+  }
+  return min;
+}
+
+// 回收进程已退出、仍占着位置的消费者，返回回收数
+static int reclaim_dead_consumers(net_shm_writer_t *w) {
+  int n = 0;
+  for (int i = 0; i < NET_SHM_MAX_CONSUMERS; i++) {
+    net_shm_consumer_t *c = &w->hdr->consumers[i];
+    int32_t pid = __atomic_load_n(&c->pid, __ATOMIC_ACQUIRE);
+    if (pid == 0 || kill(pid, 0) == 0 || errno != ESRCH)
+      continue;
+    // 进程已退出不会再写 tail；先撤销位置再释放，下一个占用者不会继承旧位置
+    __atomic_store_n(&c->tail, NET_SHM_TAIL_NONE, __ATOMIC_RELEASE);
+    if (__atomic_compare_exchange_n(&c->pid, &pid, 0, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      LOG_WARN("[net_shm] Consumer %d exited without detaching, slot reclaimed\n", pid);
+      n++;
+    }
+  }
+  __atomic_store_n(&w->reclaimed, w->reclaimed + n, __ATOMIC_RELAXED);
+  return n;
+}
+
+int net_shm_add(net_shm_writer_t *w, const uint8_t *data, uint32_t length, uint64_t ts) {
+  net_shm_header_t *h = w->hdr;
+  uint64_t head = h->head;
+
+  if (head - w->min_tail >= h->slot_count) {
+    w->min_tail = slowest_tail(w, head);
+    if (head - w->min_tail >= h->slot_count && h->dropped_frames % NET_SHM_RECLAIM_INTERVAL == 0 &&
+        reclaim_dead_consumers(w) > 0)
+      w->min_tail = slowest_tail(w, head);
+    if (head - w->min_tail >= h->slot_count) {
+      __atomic_store_n(&h->dropped_frames, h->dropped_frames + 1, __ATOMIC_RELAXED);
+      return -1;
+    }
+  }
+
+  // 槽 seq 按 seqlock 方式更新，追赶消费者据此发现正在或已经被覆盖的槽
+  net_shm_slot_t *s = slot_at(h, w->slots, head);
+  uint32_t caplen = length > w->snaplen ? w->snaplen : length;
+  __atomic_store_n(&s->seq, NET_SHM_SEQ_WRITING, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  s->length = length;
+  s->captured = caplen;
+  s->ts = ts;
+  memcpy(s + 1, data, caplen);
+  __atomic_store_n(&s->seq, head, __ATOMIC_RELEASE);
+  __atomic_store_n(&h->head, head + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+void net_shm_get_stats(net_shm_writer_t *w, net_shm_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+  uint64_t head = __atomic_load_n(&w->hdr->head, __ATOMIC_ACQUIRE);
+  stats->frames = head;
+  stats->dropped_frames = __atomic_load_n(&w->hdr->dropped_frames, __ATOMIC_RELAXED);
+  stats->reclaimed_consumers = __atomic_load_n(&w->reclaimed, __ATOMIC_RELAXED);
+  for (int i = 0; i < NET_SHM_MAX_CONSUMERS; i++) {
+    net_shm_consumer_t *c = &w->hdr->consumers[i];
+    int32_t pid = __atomic_load_n(&c->pid, __ATOMIC_ACQUIRE);
+    if (pid == 0)
+      continue;
+    uint64_t tail = __atomic_load_n(&c->tail, __ATOMIC_ACQUIRE);
+    stats->pid[i] = pid;
+    stats->lag[i] = tail < head ? (uint32_t)(head - tail > UINT32_MAX ? UINT32_MAX : head - tail) : 0;
+    if (stats->lag[i] > stats->max_lag)
+      stats->max_lag = stats->lag[i];
+    stats->consumers++;
+  }
+}
+
+void net_shm_close(net_shm_writer_t *w, net_shm_stats_t *stats) {
+  if (!w)
+    return;
+
+  net_shm_stats_t final;
+  net_shm_get_stats(w, &final);
+  if (stats)
+    *stats = final;
+  __atomic_store_n(&w->hdr->closed, 1, __ATOMIC_RELEASE);
+  shm_unlink(w->name);
+  munmap(w->hdr, w->map_len);
+  LOG_INFO("[net_shm] Closed %s: %llu frames, %llu dropped, %u consumers attached\n", w->name,
+           (unsigned long long)final.frames, (unsigned long long)final.dropped_frames, final.consumers);
+  free(w);
+}
+
+/*
+ * 消费者
+ */
+struct net_shm_reader {
+  net_shm_header_t *hdr;
+  uint8_t *slots;
+  size_t map_len;
+  net_shm_consumer_t *c;
+  uint64_t tail;
+  bool holding;          // 上次交出的帧仍在使用，下次调用时才推进 tail
+  bool lapped;           // 追赶消费者
+  uint64_t lost;         // 追赶消费者跳过或持有期间被覆盖的帧数
+};
+
+static net_shm_reader_t *reader_open(const char *name, uint32_t flags) {
+  int fd = shm_open(name, O_RDWR, 0);
+  if (fd < 0) {
+    perror("[net_shm] shm_open");
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(net_shm_header_t)) {
+    close(fd);
+    return NULL;
+  }
+  void *p = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (p == MAP_FAILED) {
+    perror("[net_shm] mmap");
+    return NULL;
+  }
+
+  net_shm_header_t *h = p;
+  if (__atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) != NET_SHM_MAGIC || h->version != NET_SHM_VERSION ||
+      h->data_offset + (uint64_t)h->slot_count * h->slot_size > (uint64_t)st.st_size) {
+    LOG_ERROR("[net_shm] %s is not a compatible frame ring\n", name);
+    munmap(p, (size_t)st.st_size);
+    return NULL;
+  }
+
+  net_shm_reader_t *r = calloc(1, sizeof(*r));
+  if (!r) {
+    munmap(p, (size_t)st.st_size);
+    return NULL;
+  }
+  r->hdr = h;
+  r->slots = (uint8_t *)p + h->data_offset;
+  r->map_len = (size_t)st.st_size;
+  r->lapped = flags & NET_SHM_CONSUMER_LAPPED;
+
+  int32_t pid = getpid();
+  for (int i = 0; i < NET_SHM_MAX_CONSUMERS && !r->c; i++) {
+    int32_t expected = 0;
+    if (__atomic_compare_exchange_n(&h->consumers[i].pid, &expected, pid, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+      r->c = &h->consumers[i];
+  }
+  if (!r->c) {
+    LOG_ERROR("[net_shm] %s already has %d consumers\n", name, NET_SHM_MAX_CONSUMERS);
+    munmap(p, r->map_len);
+    free(r);
+    return NULL;
+  }
+
+  // 先写类型再登记位置（release），生产者看到位置时也看到类型。
+  // 以当前 head 登记位置，全屏障后再读一次 head 作为起点（见 slowest_tail）
+  __atomic_store_n(&r->c->flags, flags, __ATOMIC_RELAXED);
+  __atomic_store_n(&r->c->tail, __atomic_load_n(&h->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  r->tail = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&r->c->tail, r->tail, __ATOMIC_RELEASE);
+  return r;
+}
+
+net_shm_reader_t *net_shm_reader_open(const char *name) {
+  return reader_open(name, 0);
+}
+
+net_shm_reader_t *net_shm_reader_open_lapped(const char *name) {
+  return reader_open(name, NET_SHM_CONSUMER_LAPPED);
+}
+
+int net_shm_reader_next(net_shm_reader_t *r, const uint8_t **data, uint32_t *length, uint64_t *ts) {
+  net_shm_header_t *h = r->hdr;
+  if (r->holding) {
+    // 追赶消费者：上一帧在使用期间被覆盖（seqlock 读端，屏障使之前对帧数据的读先完成）
+    if (r->lapped) {
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      if (__atomic_load_n(&slot_at(h, r->slots, r->tail)->seq, __ATOMIC_RELAXED) != r->tail)
+        r->lost++;
+    }
+    r->tail++;
+    __atomic_store_n(&r->c->tail, r->tail, __ATOMIC_RELEASE);
+    r->holding = false;
+  }
+
+  for (;;) {
+    uint64_t head = __atomic_load_n(&h->head, __ATOMIC_ACQUIRE);
+    if (r->tail == head) {
+      // closed 在最后一次发布 head 之后置位，看到 closed 后再确认一次 head
+      if (!__atomic_load_n(&h->closed, __ATOMIC_ACQUIRE))
+        return 0;
+      return r->tail == __atomic_load_n(&h->head, __ATOMIC_ACQUIRE) ? -1 : 0;
+    }
+
+    const net_shm_slot_t *s = slot_at(h, r->slots, r->tail);
+    if (r->lapped) {
+      // 第 head 帧正写入第 head - slot_count 帧的槽，能读到的最旧帧是 head - slot_count + 1
+      if (head - r->tail >= h->slot_count) {
+        uint64_t oldest = head - h->slot_count + 1;
+        r->lost += oldest - r->tail;
+        r->tail = oldest;
+        __atomic_store_n(&r->c->tail, r->tail, __ATOMIC_RELEASE);
+        continue;
+      }
+      // 读取 head 之后生产者又追上了本槽，重新取 head
+      if (__atomic_load_n(&s->seq, __ATOMIC_ACQUIRE) != r->tail)
+        continue;
+    }
+
+    *data = (const uint8_t *)(s + 1);
+    *length = s->captured;
+    if (ts)
+      *ts = s->ts;
+    r->holding = true;
+    return 1;
+  }
+}
+
+uint64_t net_shm_reader_lost(const net_shm_reader_t *r) {
+  return r->lost;
+}
+
+void net_shm_reader_close(net_shm_reader_t *r) {
+  if (!r)
+    return;
+  // 先撤销位置再释放，下一个占用该位置的消费者登记前生产者不会看到旧位置
+  __atomic_store_n(&r->c->tail, NET_SHM_TAIL_NONE, __ATOMIC_RELEASE);
+  __atomic_store_n(&r->c->pid, 0, __ATOMIC_RELEASE);
+  munmap(r->hdr, r->map_len);
+  free(r);
+}
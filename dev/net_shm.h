@@ -0,0 +1,140 @@
+#ifndef DEV_NET_SHM_H
+#define DEV_NET_SHM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 共享内存帧环默认参数
+#define NET_SHM_DEFAULT_SLOT_COUNT 8192  // 槽数（向上取整到 2 的幂）
+#define NET_SHM_MAX_CONSUMERS      8
+
+/*
+ * 共享内存布局（进程间 ABI，修改时递增 NET_SHM_VERSION）：
+ *   [net_shm_header_t | 槽 0 | 槽 1 | ...]，每槽 slot_size 字节，以 net_shm_slot_t 开头，后接帧数据。
+ * 第 n 帧（从 0 计）在槽 n & (slot_count - 1) 中，写完后槽的 seq 置为 n。生产者只推进 head，
+ * 每个消费者只推进自己的 tail。消费者分两种：
+ *   - 阻塞消费者（net_shm_reader_open）：生产者不覆盖它未读的槽。最慢的阻塞消费者落后一整环时，
+ *     新帧对所有消费者都丢弃并计数，因此暂停读取的阻塞消费者会让其他消费者（包括归档进程）一起丢帧。
+ *   - 追赶消费者（net_shm_reader_open_lapped，如界面预览）：不约束生产者，落后一整环时被覆盖的帧
+ *     由消费者按槽 seq 发现、跳过并计数，不影响其他消费者。
+ */
+#define NET_SHM_MAGIC   0x4D485342  // "SBHM"
+#define NET_SHM_VERSION 2
+
+#define NET_SHM_SEQ_WRITING UINT64_MAX  // 槽正在被改写
+#define NET_SHM_TAIL_NONE   UINT64_MAX  // 消费者位置尚未登记，生产者忽略
+
+typedef struct {
+  uint64_t seq;           // 槽内帧的序号，改写期间为 NET_SHM_SEQ_WRITING
+  uint32_t length;        // 帧原始长度
+  uint32_t captured;      // 槽内保存的长度（超过槽容量时截断）
+  uint64_t ts;            // 接收时间（CLOCK_REALTIME 纳秒）
+} net_shm_slot_t;
+
+#define NET_SHM_CONSUMER_LAPPED 0x1  // 追赶消费者，生产者计算最慢位置时不计入
+
+typedef struct {
+  uint64_t tail;          // 下一个待读的帧序号，NET_SHM_TAIL_NONE = 未登记
+  int32_t pid;            // 登记该位置的进程，0 = 空闲
+  uint32_t flags;         // NET_SHM_CONSUMER_*
+} __attribute__((aligned(64))) net_shm_consumer_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t slot_count;
+  uint32_t slot_size;
+  uint64_t data_offset;   // 槽 0 相对映射起始的偏移
+  int32_t producer_pid;
+  uint32_t closed;        // 生产者已关闭，读完剩余帧后不会再有新帧
+  uint64_t dropped_frames;
+  uint64_t head __attribute__((aligned(64)));  // 已写入的帧数
+  net_shm_consumer_t consumers[NET_SHM_MAX_CONSUMERS];
+} net_shm_header_t;
+
+// 共享内存帧环统计
+typedef struct {
+  uint64_t frames;                    // 写入环中的帧数
+  uint64_t dropped_frames;            // 消费者跟不上（环满）而丢弃的帧数
+  uint32_t consumers;                 // 当前登记的消费者数
+  uint32_t max_lag;                   // 最慢消费者落后的帧数（追赶消费者可能超过一整环）
+  uint32_t lag[NET_SHM_MAX_CONSUMERS];  // 各消费者位置落后的帧数，空闲位置为 0
+  int32_t pid[NET_SHM_MAX_CONSUMERS];   // 各消费者位置的进程号，空闲位置为 0
+  uint32_t reclaimed_consumers;       // 进程已退出而被回收的消费者位置数
+} net_shm_stats_t;
+
+// 生产者句柄
+typedef struct net_shm_writer net_shm_writer_t;
+
+/**
+ * @brief 创建 POSIX 共享内存帧环（shm_open，name 以 '/' 开头），已存在时重建
+ * @param slot_count 槽数，向上取整到 2 的幂
+ * @param snaplen    每槽保存的最大帧长
+ * @return 成功返回句柄，失败返回 NULL
+ */
+net_shm_writer_t *net_shm_open(const char *name, uint32_t slot_count, uint32_t snaplen);
+
+/**
+ * @brief 追加一帧
+ * @details 拷贝到下一个槽后发布 head，不做系统调用。只能由一个线程调用。
+ * @param ts 接收时间（CLOCK_REALTIME 纳秒）
+ * @return 0 成功，-1 环满丢弃
+ */
+int net_shm_add(net_shm_writer_t *w, const uint8_t *data, uint32_t length, uint64_t ts);
+
+/**
+ * @brief 读取统计（含各消费者落后帧数），可在其他线程中调用
+ */
+void net_shm_get_stats(net_shm_writer_t *w, net_shm_stats_t *stats);
+
+/**
+ * @brief 标记关闭并删除共享内存名字；已映射的消费者仍可读完剩余帧
+ * @param stats 非 NULL 时写入最终统计
+ */
+void net_shm_close(net_shm_writer_t *w, net_shm_stats_t *stats);
+
+// 消费者句柄（可在任意本机进程中使用）
+typedef struct net_shm_reader net_shm_reader_t;
+
+/**
+ * @brief 映射帧环并登记为阻塞消费者，从登记时的最新位置开始读取
+ * @details 生产者不覆盖它未读的帧；它落后一整环时新帧对所有消费者丢弃（见文件头说明）。
+ * @return 成功返回句柄；名字不存在、版本不符或消费者位置已满时返回 NULL
+ */
+net_shm_reader_t *net_shm_reader_open(const char *name);
+
+/**
+ * @brief 映射帧环并登记为追赶消费者
+ * @details 生产者不等待它，落后一整环时跳到环中最旧的帧继续读，被覆盖的帧计入
+ *          net_shm_reader_lost。适合暂停后只关心最新数据的预览进程。
+ */
+net_shm_reader_t *net_shm_reader_open_lapped(const char *name);
+
+/**
+ * @brief 取下一帧（零拷贝）
+ * @details data 直接指向共享内存中的槽，在下次调用或关闭前有效。调用本函数即表示上一帧已处理完。
+ *          阻塞消费者持有的帧生产者不会覆盖；追赶消费者持有期间可能被覆盖，
+ *          下次调用时发现并计入 net_shm_reader_lost。
+ * @return 1 读到一帧，0 暂无新帧，-1 生产者已关闭且已读完
+ */
+int net_shm_reader_next(net_shm_reader_t *r, const uint8_t **data, uint32_t *length, uint64_t *ts);
+
+/**
+ * @brief 追赶消费者因落后一整环而跳过的帧数，加上持有期间被覆盖的帧数；阻塞消费者恒为 0
+ */
+uint64_t net_shm_reader_lost(const net_shm_reader_t *r);
+
+/**
+ * @brief 注销消费者并解除映射
+ */
+void net_shm_reader_close(net_shm_reader_t *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEV_NET_SHM_H
@@ -0,0 +1,351 @@
+#define _GNU_SOURCE // O_DIRECT
+#include "net_stream.h"
+#include "../utils/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#define NET_STREAM_DIRECT_ALIGN 4096  // O_DIRECT 要求的缓冲区地址、长度和文件偏移对齐
+
+#define ALIGN_UP(x, a) (((x) + (a) - 1) & ~((uint64_t)(a) - 1))
+
+struct net_stream {
+  int fd;
+  bool direct;
+
+  // io_uring（直接使用系统调用，不依赖 liburing）
+  int ring_fd;
+  uint32_t *sq_tail;
+  uint32_t *sq_mask;
+  uint32_t *sq_array;
+  struct io_uring_sqe *sqes;
+  uint32_t *cq_head;
+  uint32_t *cq_tail;
+  uint32_t *cq_mask;
+  struct io_uring_cqe *cqes;
+  void *sq_map;
+  size_t sq_map_len;
+  void *cq_map;
+  size_t cq_map_len;
+  size_t sqes_len;
+  uint32_t unsubmitted;   // 已放入 SQ 但 io_uring_enter 尚未提交的请求数
+
+  // 块缓冲池
+  uint8_t *pool;
+  size_t pool_len;
+  uint32_t block_size;
+  uint32_t depth;
+  uint32_t *free_list;
+  uint32_t free_count;
+  int cur;                // 正在填充的块，-1 = 无
+  uint32_t fill;
+  uint64_t file_offset;   // 下一块的文件偏移
+
+  // 统计（只由写入线程修改，其他线程用原子读取）
+  uint64_t frames;
+  uint64_t frame_bytes;
+  uint64_t bytes_written;
+  uint64_t blocks_written;
+  uint64_t dropped_frames;
+  uint64_t write_errors;
+  uint32_t inflight;
+  uint32_t inflight_high_water;
+  struct timespec opened;
+};
+
+static inline void stat_add(uint64_t *v, uint64_t n) {
+  __atomic_store_n(v, *v + n, __ATOMIC_RELAXED);
+}
+
+static int uring_setup(net_stream_t *st, uint32_t entries) {
+  struct io_uring_params p;
+  memset(&p, 0, sizeof(p));
+
+  st->ring_fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+  if (st->ring_fd < 0) {
+    perror("io_uring_setup");
+    return -1;
+  }
+
+  st->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+  st->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+  bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+  if (single && st->cq_map_len > st->sq_map_len)
+    st->sq_map_len = st->cq_map_len;
+
+  st->sq_map = mmap(NULL, st->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    st->ring_fd, IORING_OFF_SQ_RING);
+  if (st->sq_map == MAP_FAILED) {
+    st->sq_map = NULL;
+    perror("mmap io_uring SQ");
+    return -1;
+  }
+  if (single) {
+    st->cq_map = st->sq_map;
+  } else {
+    st->cq_map = mmap(NULL, st->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      st->ring_fd, IORING_OFF_CQ_RING);
+    if (st->cq_map == MAP_FAILED) {
+      st->cq_map = NULL;
+      perror("mmap io_uring CQ");
+      return -1;
+    }
+  }
+  st->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+  st->sqes = mmap(NULL, st->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                  st->ring_fd, IORING_OFF_SQES);
+  if (st->sqes == MAP_FAILED) {
+    st->sqes = NULL;
+    perror("mmap io_uring SQEs");
+    return -1;
+  }
+
+  uint8_t *sq = st->sq_map;
+  uint8_t *cq = st->cq_map;
+  st->sq_tail = (uint32_t *)(sq + p.sq_off.tail);
+  st->sq_mask = (uint32_t *)(sq + p.sq_off.ring_mask);
+  st->sq_array = (uint32_t *)(sq + p.sq_off.array);
+  st->cq_head = (uint32_t *)(cq + p.cq_off.head);
+  st->cq_tail = (uint32_t *)(cq + p.cq_off.tail);
+  st->cq_mask = (uint32_t *)(cq + p.cq_off.ring_mask);
+  st->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+  return 0;
+}
+
+static void uring_teardown(net_stream_t *st) {
+  if (st->sqes)
+    munmap(st->sqes, st->sqes_len);
+  if (st->cq_map && st->cq_map != st->sq_map)
+    munmap(st->cq_map, st->cq_map_len);
+  if (st->sq_map)
+    munmap(st->sq_map, st->sq_map_len);
+  if (st->ring_fd >= 0)
+    close(st->ring_fd);
+}
+
+// 提交 SQ 中的请求；wait 为真时阻塞到至少一个请求完成。不可恢复的错误返回 -1
+static int uring_enter(net_stream_t *st, bool wait) {
+  unsigned flags = wait ? IORING_ENTER_GETEVENTS : 0;
+  int ret = (int)syscall(__NR_io_uring_enter, st->ring_fd, st->unsubmitted, wait ? 1 : 0,
+                         flags, NULL, 0);
+  if (ret < 0) {
+    // EAGAIN/EBUSY 时请求留在 SQ 中，下次进入时再提交
+    if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+      return 0;
+    perror("io_uring_enter");
+    return -1;
+  }
+  st->unsubmitted -= (uint32_t)ret < st->unsubmitted ? (uint32_t)ret : st->unsubmitted;
+  return 0;
+}
+
+// 回收已完成的写请求（只读 CQ 环，无系统调用）
+static void uring_reap(net_stream_t *st) {
+  uint32_t head = *st->cq_head;
+  uint32_t tail = __atomic_load_n(st->cq_tail, __ATOMIC_ACQUIRE);
+
+  for (; head != tail; head++) {
+    const struct io_uring_cqe *cqe = &st->cqes[head & *st->cq_mask];
+    uint32_t idx = (uint32_t)cqe->user_data;
+    uint32_t len = (uint32_t)(cqe->user_data >> 32);
+    if (cqe->res < 0 || (uint32_t)cqe->res != len) {
+      if (st->write_errors == 0)
+        LOG_ERROR("[net_stream] Write failed: %s\n",
+              cqe->res < 0 ? strerror(-cqe->res) : "short write");
+      stat_add(&st->write_errors, 1);
+    } else {
+      stat_add(&st->bytes_written, len);
+      stat_add(&st->blocks_written, 1);
+    }
+    st->free_list[st->free_count++] = idx;
+    __atomic_store_n(&st->inflight, st->inflight - 1, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(st->cq_head, head, __ATOMIC_RELEASE);
+}
+
+// 把当前块的前 len 字节写到下一块的文件偏移处
+static void submit_block(net_stream_t *st, uint32_t len) {
+  uint32_t tail = *st->sq_tail;
+  uint32_t slot = tail & *st->sq_mask;
+  struct io_uring_sqe *sqe = &st->sqes[slot];
+
+  memset(sqe, 0, sizeof(*sqe));
+  sqe->opcode = IORING_OP_WRITE;
+  sqe->fd = st->fd;
+  sqe->addr = (uint64_t)(uintptr_t)(st->pool + (size_t)st->cur * st->block_size);
+  sqe->len = len;
+  sqe->off = st->file_offset;
+  sqe->user_data = (uint64_t)(uint32_t)st->cur | ((uint64_t)len << 32);
+  st->sq_array[slot] = slot;
+  __atomic_store_n(st->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  st->unsubmitted++;
+
+  st->file_offset += st->block_size;
+  uint32_t inflight = st->inflight + 1;
+  __atomic_store_n(&st->inflight, inflight, __ATOMIC_RELAXED);
+  if (inflight > st->inflight_high_water)
+    __atomic_store_n(&st->inflight_high_water, inflight, __ATOMIC_RELAXED);
+  st->cur = -1;
+  st->fill = 0;
+
+  uring_enter(st, false);
+}
+
+static void stream_destroy(net_stream_t *st) {
+  uring_teardown(st);
+  if (st->pool)
+    munmap(st->pool, st->pool_len);
+  if (st->fd >= 0)
+    close(st->fd);
+  free(st->free_list);
+  free(st);
+}
+
+net_stream_t *net_stream_open(const char *path, uint32_t block_size, uint32_t queue_depth) {
+  net_stream_t *st = calloc(1, sizeof(*st));
+  if (!st)
+    return NULL;
+  st->fd = -1;
+  st->ring_fd = -1;
+  st->cur = -1;
+  st->block_size = (uint32_t)ALIGN_UP(block_size ? block_size : NET_STREAM_DEFAULT_BLOCK_SIZE,
+                                      NET_STREAM_DIRECT_ALIGN);
+  st->depth = queue_depth ? queue_depth : NET_STREAM_DEFAULT_QUEUE_DEPTH;
+
+  st->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+  st->direct = st->fd >= 0;
+  if (st->fd < 0 && errno == EINVAL) {
+    LOG_WARN("[net_stream] O_DIRECT not supported for %s, using buffered writes\n", path);
+    st->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  }
+  if (st->fd < 0) {
+    LOG_ERROR("[net_stream] Cannot open %s: %s\n", path, strerror(errno));
+    stream_destroy(st);
+    return NULL;
+  }
+
+  if (uring_setup(st, st->depth) < 0) {
+    stream_destroy(st);
+    return NULL;
+  }
+
+  // 块缓冲按页对齐并预先缺页，满足 O_DIRECT 对齐且写满块时不再触发缺页
+  st->pool_len = (size_t)st->block_size * st->depth;
+  st->pool = mmap(NULL, st->pool_len, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  st->free_list = malloc(st->depth * sizeof(uint32_t));
+  if (st->pool == MAP_FAILED || !st->free_list) {
+    if (st->pool == MAP_FAILED)
+      st->pool = NULL;
+    LOG_ERROR("[net_stream] Failed to allocate %u x %u byte block buffers\n",
+          st->depth, st->block_size);
+    stream_destroy(st);
+    return NULL;
+  }
+  for (uint32_t i = 0; i < st->depth; i++)
+    st->free_list[i] = st->depth - 1 - i;
+  st->free_count = st->depth;
+
+  clock_gettime(CLOCK_MONOTONIC, &st->opened);
+  LOG_INFO("[net_stream] Streaming to %s (%u x %u KB blocks, %s)\n", path, st->depth,
+       st->block_size / 1024, st->direct ? "O_DIRECT" : "buffered");
+  return st;
+}
+
+int net_stream_add(net_stream_t *st, const uint8_t *data, uint32_t length, uint64_t ts) {
+  uint32_t need = (uint32_t)ALIGN_UP(sizeof(net_stream_record_t) + length, NET_STREAM_RECORD_ALIGN);
+  if (need > st->block_size) {
+    stat_add(&st->dropped_frames, 1);
+    return -1;
+  }
+
+  // 当前块放不下：块尾写填充记录后整块提交
+  if (st->cur >= 0 && st->fill + need > st->block_size) {
+    if (st->fill < st->block_size) {
+      net_stream_record_t pad = {
+        .length = st->block_size - st->fill - (uint32_t)sizeof(pad),
+        .flags = NET_STREAM_PAD,
+      };
+      memcpy(st->pool + (size_t)st->cur * st->block_size + st->fill, &pad, sizeof(pad));
+    }
+    submit_block(st, st->block_size);
+  }
+
+  if (st->cur < 0) {
+    uring_reap(st);
+    if (st->free_count == 0) {
+      stat_add(&st->dropped_frames, 1);
+      return -1;
+    }
+    st->cur = (int)st->free_list[--st->free_count];
+    st->fill = 0;
+  }
+
+  uint8_t *p = st->pool + (size_t)st->cur * st->block_size + st->fill;
+  net_stream_record_t rec = { .timestamp_ns = ts, .length = length, .flags = 0 };
+  memcpy(p, &rec, sizeof(rec));
+  memcpy(p + sizeof(rec), data, length);
+  st->fill += need;
+  stat_add(&st->frames, 1);
+  stat_add(&st->frame_bytes, length);
+  return 0;
+}
+
+void net_stream_get_stats(net_stream_t *st, net_stream_stats_t *stats) {
+  memset(stats, 0, sizeof(*stats));
+  if (!st)
+    return;
+
+  stats->frames = __atomic_load_n(&st->frames, __ATOMIC_RELAXED);
+  stats->frame_bytes = __atomic_load_n(&st->frame_bytes, __ATOMIC_RELAXED);
+  stats->bytes_written = __atomic_load_n(&st->bytes_written, __ATOMIC_RELAXED);
+  stats->blocks_written = __atomic_load_n(&st->blocks_written, __ATOMIC_RELAXED);
+  stats->dropped_frames = __atomic_load_n(&st->dropped_frames, __ATOMIC_RELAXED);
+  stats->write_errors = __atomic_load_n(&st->write_errors, __ATOMIC_RELAXED);
+  stats->inflight_blocks = __atomic_load_n(&st->inflight, __ATOMIC_RELAXED);
+  stats->inflight_high_water = __atomic_load_n(&st->inflight_high_water, __ATOMIC_RELAXED);
+  stats->direct_io = st->direct;
+
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  double elapsed = (now.tv_sec - st->opened.tv_sec) + (now.tv_nsec - st->opened.tv_nsec) / 1e9;
+  if (elapsed > 0)
+    stats->throughput_mb_s = stats->bytes_written / elapsed / (1024.0 * 1024.0);
+}
+
+int net_stream_close(net_stream_t *st, net_stream_stats_t *stats) {
+  if (!st)
+    return 0;
+
+  // 最后一块按 O_DIRECT 对齐写出，之后把文件截断到有效数据末尾
+  uint64_t end = st->file_offset;
+  if (st->cur >= 0 && st->fill > 0) {
+    end += st->fill;
+    submit_block(st, (uint32_t)ALIGN_UP(st->fill, NET_STREAM_DIRECT_ALIGN));
+  }
+  while (st->inflight > 0) {
+    if (uring_enter(st, true) < 0) {
+      stat_add(&st->write_errors, st->inflight);
+      break;
+    }
+    uring_reap(st);
+  }
+  if (ftruncate(st->fd, (off_t)end) < 0)
+    perror("ftruncate");
+
+  if (stats)
+    net_stream_get_stats(st, stats);
+  int ret = st->write_errors ? -1 : 0;
+  LOG_INFO("[net_stream] Closed: %llu frames, %llu bytes written, %llu dropped\n",
+       (unsigned long long)st->frames, (unsigned long long)end,
+       (unsigned long long)st->dropped_frames);
+  stream_destroy(st);
+  return ret;
+}
@@ -0,0 +1,79 @@
+#ifndef DEV_NET_STREAM_H
+#define DEV_NET_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 流式写盘默认参数
+#define NET_STREAM_DEFAULT_BLOCK_SIZE  (4 << 20)  // 每块 4MB（4096 的整数倍，O_DIRECT 对齐要求）
+#define NET_STREAM_DEFAULT_QUEUE_DEPTH 8          // 块缓冲个数，即最多在途写请求数
+
+/*
+ * 文件格式：连续的记录，每条记录为 net_stream_record_t 记录头 + 帧数据，
+ * 整条记录按 NET_STREAM_RECORD_ALIGN 对齐。记录不跨块，块尾放不下下一条记录时写一条
+ * NET_STREAM_PAD 记录，读取时跳过 length 字节即可，无需知道块大小。
+ */
+#define NET_STREAM_RECORD_ALIGN 16
+#define NET_STREAM_PAD          0x1   // 填充记录，length 为其后需跳过的字节数
+
+typedef struct {
+  uint64_t timestamp_ns;   // 接收时间（CLOCK_REALTIME 纳秒，0 = 无时间戳）
+  uint32_t length;         // 帧长度
+  uint32_t flags;          // NET_STREAM_PAD 等
+} net_stream_record_t;
+
+// 流式写盘统计（64 位计数，长时间采集不回绕）
+typedef struct {
+  uint64_t frames;             // 写入流的帧数
+  uint64_t frame_bytes;        // 帧数据字节数（不含记录头和填充）
+  uint64_t bytes_written;      // 已完成写盘的字节数
+  uint64_t blocks_written;     // 已完成写盘的块数
+  uint64_t dropped_frames;     // 块缓冲全部在途（磁盘跟不上）而丢弃的帧数
+  uint64_t write_errors;       // 失败或不完整的写请求数
+  uint32_t inflight_blocks;    // 当前在途写请求数（写盘积压）
+  uint32_t inflight_high_water; // 在途写请求数最大值
+  double throughput_mb_s;      // 打开以来的平均写盘吞吐（MB/s）
+  bool direct_io;              // 是否以 O_DIRECT 打开
+} net_stream_stats_t;
+
+// 流式写盘句柄（io_uring + 块缓冲池）
+typedef struct net_stream net_stream_t;
+
+/**
+ * @brief 创建（截断）文件并建立 io_uring 与块缓冲池
+ * @details 先尝试 O_DIRECT 打开，文件系统不支持时退回普通缓冲写。
+ * @param block_size  块大小，向上取整到 4096 的倍数
+ * @param queue_depth 块缓冲个数
+ * @return 成功返回句柄，失败返回 NULL
+ */
+net_stream_t *net_stream_open(const char *path, uint32_t block_size, uint32_t queue_depth);
+
+/**
+ * @brief 追加一帧
+ * @details 当前块写满时提交异步写并换用空闲块缓冲，不等待写盘完成；
+ *          没有空闲块缓冲时丢弃该帧并计数。只能由一个线程调用。
+ * @return 0 成功，-1 丢弃
+ */
+int net_stream_add(net_stream_t *st, const uint8_t *data, uint32_t length, uint64_t ts);
+
+/**
+ * @brief 读取统计，可在其他线程中调用
+ */
+void net_stream_get_stats(net_stream_t *st, net_stream_stats_t *stats);
+
+/**
+ * @brief 写出最后一个不满的块，等待全部写请求完成，截断尾部填充并关闭
+ * @param stats 非 NULL 时写入最终统计
+ * @return 0 成功，有写错误时返回 -1
+ */
+int net_stream_close(net_stream_t *st, net_stream_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEV_NET_STREAM_H
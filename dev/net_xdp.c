@@ -0,0 +1,505 @@
+#include "net_xdp.h"
+#include "../utils/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/bpf.h>
+#include <linux/if_link.h>
+#include <linux/if_xdp.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#ifndef AF_XDP
+#define AF_XDP 44
+#endif
+#ifndef SOL_XDP
+#define SOL_XDP 283
+#endif
+#ifndef SO_PREFER_BUSY_POLL
+#define SO_PREFER_BUSY_POLL 69
+#endif
+
+// ========== eBPF 指令编码 ==========
+#define INSN(c, d, s, o, i) \
+  ((struct bpf_insn){ .code = (c), .dst_reg = (d), .src_reg = (s), .off = (o), .imm = (i) })
+#define MOV64_REG(d, s)       INSN(BPF_ALU64 | BPF_MOV | BPF_X, d, s, 0, 0)
+#define MOV64_IMM(d, i)       INSN(BPF_ALU64 | BPF_MOV | BPF_K, d, 0, 0, i)
+#define MOV32_IMM(d, i)       INSN(BPF_ALU | BPF_MOV | BPF_K, d, 0, 0, i)
+#define ADD64_IMM(d, i)       INSN(BPF_ALU64 | BPF_ADD | BPF_K, d, 0, 0, i)
+#define LDX_MEM(sz, d, s, o)  INSN(BPF_LDX | BPF_MEM | (sz), d, s, o, 0)
+#define JMP_REG(op, d, s, o)  INSN(BPF_JMP | (op) | BPF_X, d, s, o, 0)
+#define JMP_IMM(op, d, i, o)  INSN(BPF_JMP | (op) | BPF_K, d, 0, o, i)
+#define CALL(f)               INSN(BPF_JMP | BPF_CALL, 0, 0, 0, f)
+#define EXIT()                INSN(BPF_JMP | BPF_EXIT, 0, 0, 0, 0)
+// 64 位立即数加载占两条指令，第二条为高 32 位（map fd 为 0）
+#define LD_MAP_FD(d, fd)      INSN(BPF_LD | BPF_DW | BPF_IMM, d, BPF_PSEUDO_MAP_FD, 0, fd)
+#define LD_IMM64_HI()         INSN(0, 0, 0, 0, 0)
+
+#define XDP_PROG_MAX_INSNS 64
+#define NET_XDP_RING_SIZE  2048
+
+// 生产者/消费者环（RX 与 FILL 共用同一布局）
+typedef struct {
+  uint32_t *producer;
+  uint32_t *consumer;
+  void *descs;
+  uint32_t mask;
+  void *map;
+  size_t map_len;
+} xdp_ring_t;
+
+struct net_xdp_socket {
+  int ifindex;
+  uint32_t xdp_flags;
+  int map_fd;
+  int prog_fd;
+  int fd;
+  uint8_t *umem;
+  size_t umem_len;
+  uint32_t frame_size;
+  xdp_ring_t rx;
+  xdp_ring_t fill;
+  xdp_ring_t comp;
+};
+
+static long sys_bpf(int cmd, union bpf_attr *attr) {
+  return syscall(__NR_bpf, cmd, attr, sizeof(*attr));
+}
+
+/**
+ * @brief 生成 XDP 程序：把匹配 FPGA UDP 流的帧重定向到 XSKMAP[rx_queue_index]
+ * @details 匹配字段与 fpga_initialize_udp_header 的模板一致（IPv4、源 MAC、
+ *          IP 头长 20、UDP、源/目的 IP、源/目的端口），并与经典 BPF 过滤器一样排除 IP 分片
+ *          （MF 置位或分片偏移非零）；其余帧 XDP_PASS 交给协议栈。
+ *          比较值在用户态按网络字节序算好，XDP 侧直接与内存中的原始字段比较。
+ * @return 指令条数
+ */
+static int build_xdp_prog(const net_xdp_params_t *params, int map_fd, struct bpf_insn *prog) {
+  int n = 0;
+  int pass_jumps[16];
+  int njumps = 0;
+
+  // r6 = ctx, r2 = data, r3 = data_end
+  prog[n++] = MOV64_REG(BPF_REG_6, BPF_REG_1);
+  prog[n++] = LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_1, offsetof(struct xdp_md, data));
+  prog[n++] = LDX_MEM(BPF_W, BPF_REG_3, BPF_REG_1, offsetof(struct xdp_md, data_end));
+
+  if (params->udp_filter_enable) {
+    const S_udp_header_params *p = &params->udp_filter;
+    uint8_t mac[6] = {
+      (uint8_t)(p->src_mac_high >> 8), (uint8_t)p->src_mac_high,
+      (uint8_t)(p->src_mac_low >> 24), (uint8_t)(p->src_mac_low >> 16),
+      (uint8_t)(p->src_mac_low >> 8),  (uint8_t)p->src_mac_low,
+    };
+    uint32_t mac_h32, src_ip = htonl(p->src_ip), dst_ip = htonl(p->dst_ip);
+    uint16_t mac_l16;
+    memcpy(&mac_h32, mac, 4);
+    memcpy(&mac_l16, mac + 4, 2);
+
+    // 边界检查：以太网 14 + IP 20 + UDP 8
+    prog[n++] = MOV64_REG(BPF_REG_4, BPF_REG_2);
+    prog[n++] = ADD64_IMM(BPF_REG_4, 42);
+    pass_jumps[njumps++] = n;
+    prog[n++] = JMP_REG(BPF_JGT, BPF_REG_4, BPF_REG_3, 0);
+
+    struct { int size; int off; uint32_t val; } checks[] = {
+      { BPF_H, 12, htons(0x0800) },           // 以太网类型
+      { BPF_W, 6,  mac_h32 },                 // 源 MAC 前 4 字节
+      { BPF_H, 10, mac_l16 },                 // 源 MAC 后 2 字节
+      { BPF_B, 14, 0x45 },                    // IPv4，头长 20
+      { BPF_B, 23, 17 },                      // UDP
+      { BPF_W, 26, src_ip },                  // 源 IP
+      { BPF_W, 30, dst_ip },                  // 目的 IP
+      { BPF_H, 34, htons(p->src_port) },      // 源端口
+      { BPF_H, 36, htons(p->dst_port) },      // 目的端口
+    };
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+      prog[n++] = LDX_MEM(checks[i].size, BPF_REG_5, BPF_REG_2, checks[i].off);
+      // mov32 零扩展，避免 32 位立即数符号扩展后与加载值不相等
+      prog[n++] = MOV32_IMM(BPF_REG_7, (int32_t)checks[i].val);
+      pass_jumps[njumps++] = n;
+      prog[n++] = JMP_REG(BPF_JNE, BPF_REG_5, BPF_REG_7, 0);
+    }
+
+    // IP 分片（MF | 分片偏移）交给协议栈重组，不当作 FPGA 帧
+    prog[n++] = LDX_MEM(BPF_H, BPF_REG_5, BPF_REG_2, 20);
+    pass_jumps[njumps++] = n;
+    prog[n++] = JMP_IMM(BPF_JSET, BPF_REG_5, htons(0x3FFF), 0);
+  }
+
+  // return bpf_redirect_map(&xsks_map, ctx->rx_queue_index, XDP_PASS)
+  prog[n++] = LDX_MEM(BPF_W, BPF_REG_2, BPF_REG_6, offsetof(struct xdp_md, rx_queue_index));
+  prog[n++] = LD_MAP_FD(BPF_REG_1, map_fd);
+  prog[n++] = LD_IMM64_HI();
+  prog[n++] = MOV64_IMM(BPF_REG_3, XDP_PASS);
+  prog[n++] = CALL(BPF_FUNC_redirect_map);
+  prog[n++] = EXIT();
+
+  // pass:
+  int pass = n;
+  prog[n++] = MOV64_IMM(BPF_REG_0, XDP_PASS);
+  prog[n++] = EXIT();
+
+  for (int i = 0; i < njumps; i++)
+    prog[pass_jumps[i]].off = pass - pass_jumps[i] - 1;
+
+  return n;
+}
+
+static int load_xdp_prog(const net_xdp_params_t *params, int map_fd) {
+  struct bpf_insn prog[XDP_PROG_MAX_INSNS];
+  char log_buf[4096] = {0};
+  union bpf_attr attr;
+  int cnt = build_xdp_prog(params, map_fd, prog);
+
+  memset(&attr, 0, sizeof(attr));
+  attr.prog_type = BPF_PROG_TYPE_XDP;
+  attr.insns = (uint64_t)(unsigned long)prog;
+  attr.insn_cnt = cnt;
+  attr.license = (uint64_t)(unsigned long)"GPL";
+  attr.log_buf = (uint64_t)(unsigned long)log_buf;
+  attr.log_size = sizeof(log_buf);
+  attr.log_level = 1;
+
+  int fd = sys_bpf(BPF_PROG_LOAD, &attr);
+  if (fd < 0) {
+    perror("bpf(BPF_PROG_LOAD)");
+    LOG_ERROR("[net_xdp] verifier log:\n%s\n", log_buf);
+  }
+  return fd;
+}
+
+/**
+ * @brief 通过 rtnetlink (IFLA_XDP) 在网卡上挂载/卸载 XDP 程序
+ * @param prog_fd 程序 fd，-1 表示卸载
+ */
+static int set_link_xdp_fd(int ifindex, int prog_fd, uint32_t flags) {
+  struct {
+    struct nlmsghdr nh;
+    struct ifinfomsg ifi;
+    char attrbuf[64];
+  } req;
+  char buf[4096];
+  int ret = -1;
+
+  int sock = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+  if (sock < 0) {
+    perror("socket(AF_NETLINK)");
+    return -1;
+  }
+
+  memset(&req, 0, sizeof(req));
+  req.nh.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg));
+  req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_ACK;
+  req.nh.nlmsg_type = RTM_SETLINK;
+  req.ifi.ifi_family = AF_UNSPEC;
+  req.ifi.ifi_index = ifindex;
+
+  // IFLA_XDP { IFLA_XDP_FD, IFLA_XDP_FLAGS }
+  struct rtattr *nest = (struct rtattr *)((char *)&req + NLMSG_ALIGN(req.nh.nlmsg_len));
+  nest->rta_type = NLA_F_NESTED | IFLA_XDP;
+  nest->rta_len = RTA_LENGTH(0);
+
+  struct rtattr *rta = (struct rtattr *)((char *)nest + nest->rta_len);
+  rta->rta_type = IFLA_XDP_FD;
+  rta->rta_len = RTA_LENGTH(sizeof(int));
+  memcpy(RTA_DATA(rta), &prog_fd, sizeof(int));
+  nest->rta_len += rta->rta_len;
+
+  if (flags) {
+    rta = (struct rtattr *)((char *)nest + nest->rta_len);
+    rta->rta_type = IFLA_XDP_FLAGS;
+    rta->rta_len = RTA_LENGTH(sizeof(uint32_t));
+    memcpy(RTA_DATA(rta), &flags, sizeof(uint32_t));
+    nest->rta_len += rta->rta_len;
+  }
+  req.nh.nlmsg_len = NLMSG_ALIGN(req.nh.nlmsg_len) + nest->rta_len;
+
+  if (send(sock, &req, req.nh.nlmsg_len, 0) < 0) {
+    perror("send(RTM_SETLINK)");
+    goto out;
+  }
+
+  int len = recv(sock, buf, sizeof(buf), 0);
+  if (len < 0) {
+    perror("recv(RTM_SETLINK)");
+    goto out;
+  }
+  for (struct nlmsghdr *nh = (struct nlmsghdr *)buf; NLMSG_OK(nh, (unsigned)len);
+       nh = NLMSG_NEXT(nh, len)) {
+    if (nh->nlmsg_type == NLMSG_ERROR) {
+      struct nlmsgerr *err = (struct nlmsgerr *)NLMSG_DATA(nh);
+      if (err->error == 0)
+        ret = 0;
+      else
+        errno = -err->error;
+      break;
+    }
+  }
+
+out:
+  close(sock);
+  return ret;
+}
+
+static int map_ring(int fd, xdp_ring_t *ring, const struct xdp_ring_offset *off,
+                    uint32_t entries, size_t desc_size, off_t pgoff) {
+  ring->map_len = off->desc + entries * desc_size;
+  ring->map = mmap(NULL, ring->map_len, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd, pgoff);
+  if (ring->map == MAP_FAILED) {
+    ring->map = NULL;
+    return -1;
+  }
+  ring->producer = (uint32_t *)((uint8_t *)ring->map + off->producer);
+  ring->consumer = (uint32_t *)((uint8_t *)ring->map + off->consumer);
+  ring->descs = (uint8_t *)ring->map + off->desc;
+  ring->mask = entries - 1;
+  return 0;
+}
+
+static void unmap_ring(xdp_ring_t *ring) {
+  if (ring->map) {
+    munmap(ring->map, ring->map_len);
+    ring->map = NULL;
+  }
+}
+
+// 套接字忙轮询：poll/recv 时直接轮询网卡队列，失败（权限或内核不支持）只告警
+static void set_busy_poll(int fd, uint32_t busy_poll_us, bool prefer) {
+  int val = (int)busy_poll_us;
+  int on = 1;
+
+  if (busy_poll_us == 0)
+    return;
+  if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &val, sizeof(val)) < 0)
+    LOG_WARN("[net_xdp] SO_BUSY_POLL failed: %s\n", strerror(errno));
+  if (prefer && setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on)) < 0)
+    LOG_WARN("[net_xdp] SO_PREFER_BUSY_POLL failed: %s\n", strerror(errno));
+}
+
+// 建立 UMEM 与 RX/FILL/COMPLETION 环
+static int setup_xsk(net_xdp_socket_t *xsk, const net_xdp_params_t *params) {
+  uint32_t ring_size = NET_XDP_RING_SIZE;
+
+  xsk->fd = socket(AF_XDP, SOCK_RAW, 0);
+  if (xsk->fd < 0) {
+    perror("socket(AF_XDP)");
+    return -1;
+  }
+
+  set_busy_poll(xsk->fd, params->busy_poll_us, params->prefer_busy_poll);
+
+  xsk->frame_size = params->frame_size;
+  xsk->umem_len = (size_t)params->frame_count * params->frame_size;
+  xsk->umem = mmap(NULL, xsk->umem_len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+  if (xsk->umem == MAP_FAILED) {
+    perror("mmap(UMEM)");
+    xsk->umem = NULL;
+    return -1;
+  }
+
+  struct xdp_umem_reg mr;
+  memset(&mr, 0, sizeof(mr));
+  mr.addr = (uint64_t)(unsigned long)xsk->umem;
+  mr.len = xsk->umem_len;
+  mr.chunk_size = params->frame_size;
+  mr.headroom = 0;
+  if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_REG, &mr, sizeof(mr)) < 0) {
+    perror("setsockopt(XDP_UMEM_REG)");
+    return -1;
+  }
+
+  if (ring_size > params->frame_count)
+    ring_size = params->frame_count;
+  if (setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_FILL_RING, &ring_size, sizeof(ring_size)) < 0 ||
+      setsockopt(xsk->fd, SOL_XDP, XDP_UMEM_COMPLETION_RING, &ring_size, sizeof(ring_size)) < 0 ||
+      setsockopt(xsk->fd, SOL_XDP, XDP_RX_RING, &ring_size, sizeof(ring_size)) < 0) {
+    perror("setsockopt(XDP rings)");
+    return -1;
+  }
+
+  struct xdp_mmap_offsets off;
+  socklen_t optlen = sizeof(off);
+  if (getsockopt(xsk->fd, SOL_XDP, XDP_MMAP_OFFSETS, &off, &optlen) < 0) {
+    perror("getsockopt(XDP_MMAP_OFFSETS)");
+    return -1;
+  }
+
+  if (map_ring(xsk->fd, &xsk->rx, &off.rx, ring_size, sizeof(struct xdp_desc), XDP_PGOFF_RX_RING) < 0 ||
+      map_ring(xsk->fd, &xsk->fill, &off.fr, ring_size, sizeof(uint64_t), XDP_UMEM_PGOFF_FILL_RING) < 0 ||
+      map_ring(xsk->fd, &xsk->comp, &off.cr, ring_size, sizeof(uint64_t), XDP_UMEM_PGOFF_COMPLETION_RING) < 0) {
+    perror("mmap(XDP rings)");
+    return -1;
+  }
+
+  // 先把 UMEM 帧交给内核
+  uint64_t *fill = xsk->fill.descs;
+  for (uint32_t i = 0; i < ring_size; i++)
+    fill[i] = (uint64_t)i * params->frame_size;
+  __atomic_store_n(xsk->fill.producer, ring_size, __ATOMIC_RELEASE);
+
+  // 优先零拷贝，驱动不支持时退回拷贝模式
+  struct sockaddr_xdp sxdp;
+  memset(&sxdp, 0, sizeof(sxdp));
+  sxdp.sxdp_family = AF_XDP;
+  sxdp.sxdp_ifindex = xsk->ifindex;
+  sxdp.sxdp_queue_id = params->queue_id;
+  sxdp.sxdp_flags = XDP_ZEROCOPY;
+  if (bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0) {
+    sxdp.sxdp_flags = XDP_COPY;
+    if (bind(xsk->fd, (struct sockaddr *)&sxdp, sizeof(sxdp)) < 0) {
+      perror("bind(AF_XDP)");
+      return -1;
+    }
+    LOG_INFO("[net_xdp] Bound queue %u in copy mode\n", params->queue_id);
+  } else {
+    LOG_INFO("[net_xdp] Bound queue %u in zero-copy mode\n", params->queue_id);
+  }
+  return 0;
+}
+
+net_xdp_socket_t *net_xdp_open(const char *ifname, const net_xdp_params_t *params) {
+  net_xdp_socket_t *xsk = calloc(1, sizeof(*xsk));
+  if (!xsk)
+    return NULL;
+  xsk->map_fd = -1;
+  xsk->prog_fd = -1;
+  xsk->fd = -1;
+
+  xsk->ifindex = if_nametoindex(ifname);
+  if (xsk->ifindex == 0) {
+    perror("if_nametoindex");
+    goto fail;
+  }
+
+  // XSKMAP：key 为接收队列号，value 为 AF_XDP 套接字
+  union bpf_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_type = BPF_MAP_TYPE_XSKMAP;
+  attr.key_size = sizeof(uint32_t);
+  attr.value_size = sizeof(uint32_t);
+  attr.max_entries = params->queue_id + 1;
+  xsk->map_fd = sys_bpf(BPF_MAP_CREATE, &attr);
+  if (xsk->map_fd < 0) {
+    perror("bpf(BPF_MAP_CREATE)");
+    goto fail;
+  }
+
+  xsk->prog_fd = load_xdp_prog(params, xsk->map_fd);
+  if (xsk->prog_fd < 0)
+    goto fail;
+
+  // 优先驱动模式，失败时退回通用模式
+  xsk->xdp_flags = XDP_FLAGS_UPDATE_IF_NOEXIST |
+                   (params->skb_mode ? XDP_FLAGS_SKB_MODE : XDP_FLAGS_DRV_MODE);
+  if (set_link_xdp_fd(xsk->ifindex, xsk->prog_fd, xsk->xdp_flags) < 0) {
+    if (params->skb_mode) {
+      perror("attach XDP (skb)");
+      goto fail;
+    }
+    xsk->xdp_flags = XDP_FLAGS_UPDATE_IF_NOEXIST | XDP_FLAGS_SKB_MODE;
+    if (set_link_xdp_fd(xsk->ifindex, xsk->prog_fd, xsk->xdp_flags) < 0) {
+      perror("attach XDP");
+      goto fail;
+    }
+  }
+  LOG_INFO("[net_xdp] XDP program attached to %s (%s mode)\n", ifname,
+       (xsk->xdp_flags & XDP_FLAGS_SKB_MODE) ? "skb" : "driver");
+
+  if (setup_xsk(xsk, params) < 0)
+    goto fail;
+
+  uint32_t key = params->queue_id;
+  uint32_t value = xsk->fd;
+  memset(&attr, 0, sizeof(attr));
+  attr.map_fd = xsk->map_fd;
+  attr.key = (uint64_t)(unsigned long)&key;
+  attr.value = (uint64_t)(unsigned long)&value;
+  attr.flags = BPF_ANY;
+  if (sys_bpf(BPF_MAP_UPDATE_ELEM, &attr) < 0) {
+    perror("bpf(BPF_MAP_UPDATE_ELEM)");
+    goto fail;
+  }
+
+  return xsk;
+
+fail:
+  net_xdp_close(xsk);
+  return NULL;
+}
+
+int net_xdp_receive(net_xdp_socket_t *xsk, net_xdp_frame_fn fn, void *ctx, int timeout_ms) {
+  uint32_t cons = *xsk->rx.consumer;
+  uint32_t prod = __atomic_load_n(xsk->rx.producer, __ATOMIC_ACQUIRE);
+
+  if (cons == prod) {
+    struct pollfd pfd = { .fd = xsk->fd, .events = POLLIN };
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0)
+      return errno == EINTR ? 0 : -1;
+    prod = __atomic_load_n(xsk->rx.producer, __ATOMIC_ACQUIRE);
+    if (cons == prod)
+      return 0;
+  }
+
+  struct xdp_desc *descs = xsk->rx.descs;
+  uint64_t *fill = xsk->fill.descs;
+  uint32_t fill_prod = *xsk->fill.producer;
+  uint32_t n = prod - cons;
+
+  for (uint32_t i = 0; i < n; i++) {
+    const struct xdp_desc *d = &descs[(cons + i) & xsk->rx.mask];
+    fn(xsk->umem + d->addr, d->len, ctx);
+    // 帧处理完立即归还，FILL 环与 RX 环大小相同，不会溢出
+    fill[(fill_prod + i) & xsk->fill.mask] = d->addr & ~((uint64_t)xsk->frame_size - 1);
+  }
+
+  __atomic_store_n(xsk->rx.consumer, cons + n, __ATOMIC_RELEASE);
+  __atomic_store_n(xsk->fill.producer, fill_prod + n, __ATOMIC_RELEASE);
+  return (int)n;
+}
+
+int net_xdp_fd(net_xdp_socket_t *xsk) {
+  return xsk->fd;
+}
+
+uint64_t net_xdp_dropped(net_xdp_socket_t *xsk) {
+  struct xdp_statistics st;
+  socklen_t len = sizeof(st);
+  memset(&st, 0, sizeof(st));
+  if (getsockopt(xsk->fd, SOL_XDP, XDP_STATISTICS, &st, &len) < 0)
+    return 0;
+  return st.rx_dropped + st.rx_ring_full;
+}
+
+void net_xdp_close(net_xdp_socket_t *xsk) {
+  if (!xsk)
+    return;
+
+  if (xsk->prog_fd >= 0 && xsk->ifindex > 0 && xsk->xdp_flags)
+    set_link_xdp_fd(xsk->ifindex, -1, xsk->xdp_flags & ~XDP_FLAGS_UPDATE_IF_NOEXIST);
+
+  unmap_ring(&xsk->rx);
+  unmap_ring(&xsk->fill);
+  unmap_ring(&xsk->comp);
+  if (xsk->fd >= 0)
+    close(xsk->fd);
+  if (xsk->umem)
+    munmap(xsk->umem, xsk->umem_len);
+  if (xsk->prog_fd >= 0)
+    close(xsk->prog_fd);
+  if (xsk->map_fd >= 0)
+    close(xsk->map_fd);
+  free(xsk);
+}
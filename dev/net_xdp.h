@@ -0,0 +1,68 @@
+#ifndef DEV_NET_XDP_H
+#define DEV_NET_XDP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fpga.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// AF_XDP 默认参数
+#define NET_XDP_DEFAULT_FRAME_COUNT  4096   // UMEM 帧数
+#define NET_XDP_DEFAULT_FRAME_SIZE   2048   // UMEM 帧大小（2048 或 4096）
+
+// AF_XDP 套接字句柄（UMEM + RX/FILL/COMPLETION 环 + XDP 程序）
+typedef struct net_xdp_socket net_xdp_socket_t;
+
+// AF_XDP 打开参数
+typedef struct {
+  uint32_t queue_id;               // 绑定的网卡接收队列
+  uint32_t frame_count;            // UMEM 帧数（2 的幂）
+  uint32_t frame_size;             // UMEM 帧大小（2048 或 4096）
+  bool skb_mode;                   // 强制使用通用 (SKB) XDP 模式
+  uint32_t busy_poll_us;           // SO_BUSY_POLL 忙轮询时长（微秒，0 = 关闭）
+  bool prefer_busy_poll;           // SO_PREFER_BUSY_POLL
+  bool udp_filter_enable;          // XDP 程序只重定向 FPGA UDP 流
+  S_udp_header_params udp_filter;  // 过滤条件（主机字节序）
+} net_xdp_params_t;
+
+// 帧处理回调，data 直接指向 UMEM 中的帧，ctx 为 net_xdp_receive 传入的参数
+typedef void (*net_xdp_frame_fn)(const uint8_t *data, int length, void *ctx);
+
+/**
+ * @brief 在网卡上加载 XDP 程序并创建 AF_XDP 套接字
+ * @details 先尝试零拷贝绑定，驱动不支持时退回拷贝模式；
+ *          先尝试驱动 (native) XDP，失败时退回通用 (SKB) XDP。
+ * @return 成功返回句柄，失败返回 NULL
+ */
+net_xdp_socket_t *net_xdp_open(const char *ifname, const net_xdp_params_t *params);
+
+/**
+ * @brief 接收一批帧
+ * @details RX 环为空时最多等待 timeout_ms 毫秒；每帧处理后 UMEM 帧立即归还 FILL 环。
+ * @return 本次处理的帧数，出错返回 -1
+ */
+int net_xdp_receive(net_xdp_socket_t *xsk, net_xdp_frame_fn fn, void *ctx, int timeout_ms);
+
+/**
+ * @brief AF_XDP 套接字描述符，可加入 poll/epoll 等待 RX 环有帧
+ */
+int net_xdp_fd(net_xdp_socket_t *xsk);
+
+/**
+ * @brief 读取内核侧丢包总数（RX 环满及其他丢弃，累计值）
+ */
+uint64_t net_xdp_dropped(net_xdp_socket_t *xsk);
+
+/**
+ * @brief 卸载 XDP 程序并释放 AF_XDP 资源
+ */
+void net_xdp_close(net_xdp_socket_t *xsk);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // DEV_NET_XDP_H
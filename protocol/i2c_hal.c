@@ -10,6 +10,17 @@
 #include <sys/time.h>
 
 static int i2c_fd = -1;
+static uint64_t transfer_count = 0;
+
+// 所有 I2C_RDWR 都经过这里，返回内核报告的已完成消息数，失败返回-1
+static int rdwr(struct i2c_msg *msgs, int nmsgs) {
+  struct i2c_rdwr_ioctl_data data = {
+    .msgs = msgs,
+    .nmsgs = (uint32_t)nmsgs
+  };
+  transfer_count++;
+  return ioctl(i2c_fd, I2C_RDWR, &data);
+}
 
 int i2c_hal_init(const char* i2c_bus) {
   if (i2c_fd >= 0) {
@@ -38,12 +49,7 @@ int i2c_hal_write_reg16(uint8_t dev_addr, uint8_t reg_addr, uint16_t value) {
     .buf = buf
   };
 
-  struct i2c_rdwr_ioctl_data ioctl_data = {
-    .msgs = &msg,
-    .nmsgs = 1
-  };
-
-  if (ioctl(i2c_fd, I2C_RDWR, &ioctl_data) < 0) {
+  if (rdwr(&msg, 1) < 0) {
     perror("I2C写入失败");
     return -1;
   }
@@ -67,12 +73,7 @@ int i2c_hal_read_reg16(uint8_t dev_addr, uint8_t reg_addr, uint16_t *value) {
   msgs[1].len   = 2;
   msgs[1].buf   = buf;
 
-  struct i2c_rdwr_ioctl_data ioctl_data = {
-    .msgs = msgs,
-    .nmsgs = 2
-  };
-
-  if (ioctl(i2c_fd, I2C_RDWR, &ioctl_data) < 0) {
+  if (rdwr(msgs, 2) < 0) {
     perror("I2C读取失败");
     return -1;
   }
@@ -91,7 +92,6 @@ int i2c_hal_read_reg16(uint8_t dev_addr, uint8_t reg_addr, uint16_t *value) {
  */
 int fpga_reg_write_4Bytes(uint8_t fpga_addr, int16_t reg_addr, uint8_t* val) {
   uint8_t buf[6] = {0};
-	struct i2c_rdwr_ioctl_data data;
 	struct i2c_msg msg;
   struct timeval _time_start_;
   struct timeval _time_end_; 
@@ -107,12 +107,9 @@ int fpga_reg_write_4Bytes(uint8_t fpga_addr, int16_t reg_addr, uint8_t* val) {
 	msg.addr = (uint8_t)fpga_addr;
 	msg.flags = 0; 
 	msg.len = (uint8_t)sizeof(buf);
-	msg.buf = (char *)buf;
-	
-	data.msgs = &msg;
-	data.nmsgs = 1;
+	msg.buf = buf;
 
-	if(ioctl(i2c_fd, I2C_RDWR, &data)<0){
+	if(rdwr(&msg, 1)<0){
 		perror("ioctl i2c-w:");
     printf("I2C ioctl write failed\n");
 		return -1;
@@ -138,7 +135,6 @@ int i2c_hal_fpga_write(uint8_t fpga_addr, uint16_t reg_addr, uint32_t val)
 {
   uint8_t buf[6];
   struct i2c_msg msg;
-  struct i2c_rdwr_ioctl_data data;
 
   buf[0] = (uint8_t)((reg_addr >> 8) & 0xFF);
   buf[1] = (uint8_t)(reg_addr & 0xFF);
@@ -152,10 +148,7 @@ int i2c_hal_fpga_write(uint8_t fpga_addr, uint16_t reg_addr, uint32_t val)
   msg.len   = sizeof(buf);
   msg.buf   = buf;
 
-  data.msgs  = &msg;
-  data.nmsgs = 1;
-
-  return ioctl(i2c_fd, I2C_RDWR, &data) < 0 ? -1 : 0;
+  return rdwr(&msg, 1) < 0 ? -1 : 0;
 }
 
 
@@ -170,7 +163,6 @@ int i2c_hal_fpga_read(uint8_t fpga_addr, uint16_t reg_addr, uint32_t *val)
 {
   uint8_t buf[2];
   struct i2c_msg msgs[2];
-  struct i2c_rdwr_ioctl_data data;
 
   buf[0] = (uint8_t)((reg_addr >> 8) & 0xFF) | 0x80; // 高位标记读
   buf[1] = (uint8_t)(reg_addr & 0xFF);
@@ -185,16 +177,163 @@ int i2c_hal_fpga_read(uint8_t fpga_addr, uint16_t reg_addr, uint32_t *val)
   msgs[1].len   = sizeof(uint32_t);
   msgs[1].buf   = (uint8_t*)val;
 
-  data.msgs  = msgs;
-  data.nmsgs = 2;
-
-  if(ioctl(i2c_fd, I2C_RDWR, &data) < 0)
+  if(rdwr(msgs, 2) < 0)
       return -1;
 
   *val = ntohl(*val); // 转为主机字节序
   return 0;
 }
 
+/*
+ * 批量传输
+ */
+void i2c_hal_batch_init(i2c_hal_batch_t *b) {
+  b->op_count = 0;
+  b->pending_op = 0;
+  b->msg_count = 0;
+  b->max_msgs = I2C_HAL_DEV_RDWR_MAX_MSGS;
+  b->transfers = 0;
+  b->failed = 0;
+}
+
+void i2c_hal_batch_set_max_msgs(i2c_hal_batch_t *b, int max_msgs) {
+  if (max_msgs < 2)
+    max_msgs = 2;
+  if (max_msgs > I2C_HAL_DEV_RDWR_MAX_MSGS)
+    max_msgs = I2C_HAL_DEV_RDWR_MAX_MSGS;
+  b->max_msgs = max_msgs;
+}
+
+// 发出已收集的消息；I2C_RDWR 只会全部成功或整体失败，块内操作的结果相同
+static void batch_flush(i2c_hal_batch_t *b) {
+  if (b->msg_count == 0)
+    return;
+
+  bool ok = rdwr(b->msgs, b->msg_count) >= 0;
+  if (!ok)
+    perror("I2C批量传输失败");
+  b->transfers++;
+
+  for (int i = b->pending_op; i < b->op_count; i++) {
+    i2c_hal_batch_op_t *op = &b->ops[i];
+    if (!ok) {
+      op->status = -1;
+      b->failed++;
+      continue;
+    }
+    op->status = 0;
+    if (op->read_kind == 1) {
+      *(uint16_t *)op->dst = ((uint16_t)op->rx[0] << 8) | op->rx[1];
+    } else if (op->read_kind == 2) {
+      uint32_t val;
+      memcpy(&val, op->rx, sizeof(val));
+      *(uint32_t *)op->dst = ntohl(val); // 转为主机字节序
+    }
+  }
+  b->pending_op = b->op_count;
+  b->msg_count = 0;
+}
+
+// 分配一个操作和它的消息，当前块放不下时先把已收集的发出。
+// 操作数已满时丢弃的操作计入失败数，提交返回-1，不会被当作已写入
+static i2c_hal_batch_op_t *batch_add(i2c_hal_batch_t *b, int nmsgs) {
+  if (b->op_count >= I2C_HAL_BATCH_MAX_OPS) {
+    fprintf(stderr, "I2C批量操作数超过上限 %d\n", I2C_HAL_BATCH_MAX_OPS);
+    b->failed++;
+    return NULL;
+  }
+  if (b->msg_count + nmsgs > b->max_msgs)
+    batch_flush(b);
+
+  i2c_hal_batch_op_t *op = &b->ops[b->op_count++];
+  memset(op, 0, sizeof(*op));
+  op->nmsgs = (uint8_t)nmsgs;
+  op->first_msg = (uint16_t)b->msg_count;
+  op->status = 1;
+  b->msg_count += nmsgs;
+  return op;
+}
+
+static int batch_write(i2c_hal_batch_t *b, uint8_t addr, const uint8_t *data, int len) {
+  i2c_hal_batch_op_t *op = batch_add(b, 1);
+  if (!op)
+    return -1;
+  memcpy(op->buf, data, len);
+
+  struct i2c_msg *msg = &b->msgs[op->first_msg];
+  msg->addr = addr;
+  msg->flags = 0;
+  msg->len = (uint16_t)len;
+  msg->buf = op->buf;
+  return (int)(op - b->ops);
+}
+
+static int batch_read(i2c_hal_batch_t *b, uint8_t addr, const uint8_t *reg, int reg_len,
+                      int rx_len, uint8_t kind, void *dst) {
+  i2c_hal_batch_op_t *op = batch_add(b, 2);
+  if (!op)
+    return -1;
+  memcpy(op->buf, reg, reg_len);
+  op->read_kind = kind;
+  op->dst = dst;
+
+  struct i2c_msg *msgs = &b->msgs[op->first_msg];
+  msgs[0].addr = addr;
+  msgs[0].flags = 0;
+  msgs[0].len = (uint16_t)reg_len;
+  msgs[0].buf = op->buf;
+  msgs[1].addr = addr;
+  msgs[1].flags = I2C_M_RD;
+  msgs[1].len = (uint16_t)rx_len;
+  msgs[1].buf = op->rx;
+  return (int)(op - b->ops);
+}
+
+int i2c_hal_batch_write_reg16(i2c_hal_batch_t *b, uint8_t dev_addr, uint8_t reg_addr, uint16_t value) {
+  uint8_t buf[3] = { reg_addr, (uint8_t)(value >> 8), (uint8_t)(value & 0xFF) };
+  return batch_write(b, dev_addr, buf, sizeof(buf));
+}
+
+int i2c_hal_batch_read_reg16(i2c_hal_batch_t *b, uint8_t dev_addr, uint8_t reg_addr, uint16_t *value) {
+  return batch_read(b, dev_addr, &reg_addr, 1, 2, 1, value);
+}
+
+int i2c_hal_batch_fpga_write(i2c_hal_batch_t *b, uint8_t fpga_addr, uint16_t reg_addr, uint32_t val) {
+  uint8_t buf[6] = {
+    (uint8_t)((reg_addr >> 8) & 0xFF), (uint8_t)(reg_addr & 0xFF),
+    (uint8_t)((val >> 24) & 0xFF), (uint8_t)((val >> 16) & 0xFF),
+    (uint8_t)((val >> 8) & 0xFF), (uint8_t)(val & 0xFF)
+  };
+  return batch_write(b, fpga_addr, buf, sizeof(buf));
+}
+
+int i2c_hal_batch_fpga_write_4Bytes(i2c_hal_batch_t *b, uint8_t fpga_addr, uint16_t reg_addr,
+                                    const uint8_t *val) {
+  uint8_t buf[6] = { (uint8_t)((reg_addr >> 8) & 0xFF), (uint8_t)(reg_addr & 0xFF) };
+  memcpy(buf + 2, val, 4);
+  return batch_write(b, fpga_addr, buf, sizeof(buf));
+}
+
+int i2c_hal_batch_fpga_read(i2c_hal_batch_t *b, uint8_t fpga_addr, uint16_t reg_addr, uint32_t *val) {
+  uint8_t reg[2] = { (uint8_t)(((reg_addr >> 8) & 0xFF) | 0x80), (uint8_t)(reg_addr & 0xFF) }; // 高位标记读
+  return batch_read(b, fpga_addr, reg, sizeof(reg), sizeof(uint32_t), 2, val);
+}
+
+int i2c_hal_batch_submit(i2c_hal_batch_t *b) {
+  batch_flush(b);
+  return b->failed ? -1 : 0;
+}
+
+int i2c_hal_batch_status(const i2c_hal_batch_t *b, int op) {
+  if (op < 0 || op >= b->op_count)
+    return -1;
+  return b->ops[op].status;
+}
+
+uint64_t i2c_hal_transfer_count(void) {
+  return transfer_count;
+}
+
 void i2c_hal_close(void) {
   if (i2c_fd >= 0) {
     close(i2c_fd);
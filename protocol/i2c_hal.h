@@ -3,6 +3,40 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <linux/i2c.h>
+#include <linux/i2c-dev.h>
+
+// i2c-dev 字符设备接口对一次 I2C_RDWR 消息数的限制（与适配器驱动无关）
+#define I2C_HAL_DEV_RDWR_MAX_MSGS I2C_RDWR_IOCTL_MAX_MSGS
+// 一个批次最多记录的操作数，超出块大小的操作自动分成多次 I2C_RDWR
+#define I2C_HAL_BATCH_MAX_OPS  64
+
+// 批次中的一个操作（一次写，或写地址 + 读数据两条消息）
+typedef struct {
+  uint8_t nmsgs;           // 占用的消息数
+  uint8_t read_kind;       // 0 = 写，1 = 读 16 位寄存器，2 = 读 FPGA 32 位寄存器
+  uint16_t first_msg;      // 在所属 I2C_RDWR 中的第一条消息
+  void *dst;               // 读操作的结果
+  uint8_t buf[6];          // 写出的数据（寄存器地址 + 值）
+  uint8_t rx[4];           // 读回的数据
+  int status;              // 0 成功，-1 失败，1 尚未提交
+} i2c_hal_batch_op_t;
+
+/*
+ * 批量传输构建器：收集多次寄存器读写，合并成尽量少的 I2C_RDWR 调用。
+ * 同一次调用中的消息之间是重复起始条件（repeated START），只在最后产生 STOP。
+ * 消息指向构建器内部的缓冲区，添加操作到提交之间不能复制或移动构建器。
+ */
+typedef struct {
+  i2c_hal_batch_op_t ops[I2C_HAL_BATCH_MAX_OPS];
+  int op_count;
+  int pending_op;          // 第一个尚未提交的操作
+  struct i2c_msg msgs[I2C_HAL_DEV_RDWR_MAX_MSGS];
+  int msg_count;
+  int max_msgs;            // 一次 I2C_RDWR 的消息数上限（块大小）
+  int transfers;           // 已发出的 I2C_RDWR 次数
+  int failed;              // 失败的操作数
+} i2c_hal_batch_t;
 
 /**
  * @brief 初始化I2C接口。
@@ -59,6 +93,70 @@ int i2c_hal_fpga_write(uint8_t fpga_addr, uint16_t reg_addr, uint32_t val);
 int i2c_hal_fpga_read(uint8_t fpga_addr, uint16_t reg_addr, uint32_t *val);
 
 
+/**
+ * @brief 初始化批量传输构建器。
+ */
+void i2c_hal_batch_init(i2c_hal_batch_t *b);
+
+/**
+ * @brief 设置块大小：一次 I2C_RDWR 最多发出的消息数。
+ * @details I2C_RDWR 要么全部完成，要么整体返回错误，一个块失败时块内所有操作都记为失败。
+ *          需要逐个操作结果的调用者可以减小块大小，最小为2（一次读操作占两条消息），
+ *          默认及上限为 I2C_HAL_DEV_RDWR_MAX_MSGS。须在添加操作前调用。
+ */
+void i2c_hal_batch_set_max_msgs(i2c_hal_batch_t *b, int max_msgs);
+
+/**
+ * @brief 添加一次16位寄存器写入。
+ * @details 以下添加函数在操作数已满时丢弃该操作并计为失败，之后 i2c_hal_batch_submit 返回-1。
+ * @return 操作序号，可用 i2c_hal_batch_status 查询结果；操作数已满返回-1。
+ */
+int i2c_hal_batch_write_reg16(i2c_hal_batch_t *b, uint8_t dev_addr, uint8_t reg_addr, uint16_t value);
+
+/**
+ * @brief 添加一次16位寄存器读取，提交成功后结果写入 *value。
+ * @return 操作序号；操作数已满返回-1。
+ */
+int i2c_hal_batch_read_reg16(i2c_hal_batch_t *b, uint8_t dev_addr, uint8_t reg_addr, uint16_t *value);
+
+/**
+ * @brief 添加一次FPGA 32位寄存器写入（与 i2c_hal_fpga_write 相同的格式）。
+ * @return 操作序号；操作数已满返回-1。
+ */
+int i2c_hal_batch_fpga_write(i2c_hal_batch_t *b, uint8_t fpga_addr, uint16_t reg_addr, uint32_t val);
+
+/**
+ * @brief 添加一次FPGA 4字节原样写入（与 fpga_reg_write_4Bytes 相同的格式）。
+ * @return 操作序号；操作数已满返回-1。
+ */
+int i2c_hal_batch_fpga_write_4Bytes(i2c_hal_batch_t *b, uint8_t fpga_addr, uint16_t reg_addr,
+                                    const uint8_t *val);
+
+/**
+ * @brief 添加一次FPGA 32位寄存器读取，提交成功后结果（主机字节序）写入 *val。
+ * @return 操作序号；操作数已满返回-1。
+ */
+int i2c_hal_batch_fpga_read(i2c_hal_batch_t *b, uint8_t fpga_addr, uint16_t reg_addr, uint32_t *val);
+
+/**
+ * @brief 发出尚未提交的操作。
+ * @details 一个块放不下时已在添加过程中分块发出。内核不报告部分完成，
+ *          一个块失败时块内所有操作都记为失败（其中部分消息可能已经到达器件）。
+ * @return 全部成功返回0，否则返回-1（各操作结果见 i2c_hal_batch_status）。
+ */
+int i2c_hal_batch_submit(i2c_hal_batch_t *b);
+
+/**
+ * @brief 查询操作结果。
+ * @return 0 成功，-1 失败，1 尚未提交。
+ */
+int i2c_hal_batch_status(const i2c_hal_batch_t *b, int op);
+
+/**
+ * @brief 累计发出的 I2C_RDWR 次数（包括单次读写）。
+ */
+uint64_t i2c_hal_transfer_count(void);
+
 /**
  * @brief 关闭I2C接口。
  */
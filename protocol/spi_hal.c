@@ -14,7 +14,12 @@ static int spi_fd = -1;
 int spi_hal_init(void) {
   uint8_t mode = SPI_MODE_2;
   uint8_t bits = 8;
-  uint32_t speed = 1000000;
+  uint32_t speed = SPI_HAL_DEFAULT_SPEED_HZ;
+
+  if (spi_fd >= 0) {
+    // 已初始化
+    return 0;
+  }
 
   spi_fd = open(SPI_DEVICE, O_RDWR);
   if (spi_fd < 0) {
@@ -25,18 +30,21 @@ int spi_hal_init(void) {
   if (ioctl(spi_fd, SPI_IOC_WR_MODE, &mode) < 0) {
     perror("无法设置SPI模式");
     close(spi_fd);
+    spi_fd = -1;
     return -1;
   }
 
   if (ioctl(spi_fd, SPI_IOC_WR_BITS_PER_WORD, &bits) < 0) {
     perror("无法设置SPI字长");
     close(spi_fd);
+    spi_fd = -1;
     return -1;
   }
 
   if (ioctl(spi_fd, SPI_IOC_WR_MAX_SPEED_HZ, &speed) < 0) {
     perror("无法设置SPI速度");
     close(spi_fd);
+    spi_fd = -1;
     return -1;
   }
 
@@ -51,7 +59,7 @@ int spi_hal_write(const uint8_t *tx_buf, int len) {
   tr.rx_buf = (unsigned long)rx_buf;
   tr.len = len;
   tr.delay_usecs = 0;
-  tr.speed_hz = 1000000;
+  tr.speed_hz = SPI_HAL_DEFAULT_SPEED_HZ;
   tr.bits_per_word = 8;
   tr.cs_change = 0;
 
@@ -59,10 +67,41 @@ int spi_hal_write(const uint8_t *tx_buf, int len) {
     perror("SPI传输失败");
     return -1;
   }
-  usleep(10);
+  // ioctl 返回时传输已完成，片选也已释放；器件需要的生效时间由设备驱动按时序参数等待
   return len;
 }
 
+int spi_hal_write_batch(const spi_hal_xfer_t *xfers, int count) {
+  struct spi_ioc_transfer tr[SPI_HAL_MAX_BATCH];
+  int total = 0;
+
+  if (count <= 0)
+    return 0;
+  if (count > SPI_HAL_MAX_BATCH) {
+    fprintf(stderr, "SPI批量传输段数 %d 超过上限 %d\n", count, SPI_HAL_MAX_BATCH);
+    return -1;
+  }
+
+  memset(tr, 0, sizeof(tr[0]) * count);
+  for (int i = 0; i < count; i++) {
+    tr[i].tx_buf = (unsigned long)xfers[i].tx_buf;
+    tr[i].rx_buf = 0; // 只写，不回读
+    tr[i].len = xfers[i].len;
+    tr[i].speed_hz = xfers[i].speed_hz ? xfers[i].speed_hz : SPI_HAL_DEFAULT_SPEED_HZ;
+    tr[i].bits_per_word = 8;
+    tr[i].delay_usecs = xfers[i].delay_usecs;
+    // spidev 中最后一段的 cs_change 表示传输结束后保持片选，这里不使用
+    tr[i].cs_change = (i < count - 1 && xfers[i].cs_change) ? 1 : 0;
+    total += xfers[i].len;
+  }
+
+  if (ioctl(spi_fd, SPI_IOC_MESSAGE(count), tr) < 0) {
+    perror("SPI批量传输失败");
+    return -1;
+  }
+  return total;
+}
+
 void spi_hal_close(void) {
   if (spi_fd >= 0) {
     close(spi_fd);
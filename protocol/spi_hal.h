@@ -2,9 +2,25 @@
 #define SPI_HAL_H
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#define SPI_HAL_DEFAULT_SPEED_HZ 1000000
+#define SPI_HAL_MAX_BATCH        32      // 一次批量传输的最大段数
+
+/**
+ * @brief 批量传输中的一段
+ */
+typedef struct {
+  const uint8_t *tx_buf;   // 发送数据
+  uint32_t len;            // 字节数
+  uint32_t speed_hz;       // 本段 SCLK 频率，0 表示接口默认频率
+  uint16_t delay_usecs;    // 本段结束后、改变片选前的延时
+  bool cs_change;          // 本段结束后释放片选再开始下一段（最后一段忽略，传输结束总是释放）
+} spi_hal_xfer_t;
 
 /**
  * @brief 初始化SPI接口。
+ * @details 已打开时直接返回，重复调用不会重新打开设备。
  * @return 成功返回0，失败返回-1。
  */
 int spi_hal_init(void);
@@ -17,6 +33,14 @@ int spi_hal_init(void);
  */
 int spi_hal_write(const uint8_t *tx_buf, int len);
 
+/**
+ * @brief 在一次 SPI_IOC_MESSAGE(n) 调用中发送多段数据。
+ * @param xfers 各段参数
+ * @param count 段数，不超过 SPI_HAL_MAX_BATCH
+ * @return 成功返回发送的总字节数，失败返回-1。
+ */
+int spi_hal_write_batch(const spi_hal_xfer_t *xfers, int count);
+
 /**
  * @brief 关闭SPI接口。
  */
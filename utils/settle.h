@@ -0,0 +1,60 @@
+#ifndef UTILS_SETTLE_H
+#define UTILS_SETTLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <time.h>
+
+// 剩余等待时间不超过该值时自旋，避免睡眠唤醒延迟远大于等待本身
+#define SETTLE_SPIN_NS 50000
+
+/*
+ * 建立时间跟踪：对器件的写操作只记录"最早何时生效"的截止时刻，
+ * 真正依赖前一操作完成的下一步（如触发扫频）之前才等待到截止时刻。
+ */
+typedef struct {
+  uint64_t deadline_ns;   // CLOCK_MONOTONIC 截止时刻
+  uint64_t waited_ns;     // 累计实际等待的时间
+  bool serialize;         // 每次记录后立即等待（等同逐条固定延时）
+} settle_t;
+
+static inline uint64_t settle_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief 等到截止时刻，已过期时立即返回
+ */
+static inline void settle_wait(settle_t *s) {
+  uint64_t now = settle_now_ns();
+  if (now >= s->deadline_ns)
+    return;
+
+  uint64_t start = now;
+  if (s->deadline_ns - now > SETTLE_SPIN_NS) {
+    uint64_t wake = s->deadline_ns - SETTLE_SPIN_NS;
+    struct timespec ts = { .tv_sec = (time_t)(wake / 1000000000ULL),
+                           .tv_nsec = (long)(wake % 1000000000ULL) };
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+      ;
+  }
+  while ((now = settle_now_ns()) < s->deadline_ns)
+    ;
+  s->waited_ns += now - start;
+}
+
+/**
+ * @brief 记录刚完成的操作需要 ns 纳秒生效，截止时刻只会推后不会提前
+ */
+static inline void settle_after(settle_t *s, uint64_t ns) {
+  uint64_t deadline = settle_now_ns() + ns;
+  if (deadline > s->deadline_ns)
+    s->deadline_ns = deadline;
+  if (s->serialize)
+    settle_wait(s);
+}
+
+#endif // UTILS_SETTLE_H